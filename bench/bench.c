@@ -0,0 +1,264 @@
+/*
+ * This file is part of the Gopherus project.
+ * It provides the common infrastructure of the benchmark programs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>    /* gettimeofday() */
+#include "bench.h"
+
+const long bench_sizes[] = {
+    1024l,                 /* small */
+    64l * 1024,            /* typical */
+    1024l * 1024,          /* large */
+    100l * 1024 * 1024,    /* pathological */
+    0
+};
+
+static long maxsize = 100l * 1024 * 1024;
+static double mintime = 0.5;
+
+static const char *words[] = {
+    "gopher", "the", "of", "and", "a", "protocol", "menu", "server", "is",
+    "document", "to", "in", "client", "selector", "internet", "text", "for",
+    "distributed", "search", "retrieval", "hole", "it", "that", "with",
+    "university", "Minnesota", "RFC", "1436", "was", "designed", "as", "an"
+};
+
+static const char *entities[] = {
+    "&amp;", "&lt;", "&gt;", "&quot;", "&nbsp;", "&eacute;", "&copy;",
+    "&#65;", "&#x263A;", "&mdash;", "&hellip;", "&apos;"
+};
+
+/* a tiny deterministic PRNG, so corpora are identical on every run */
+static unsigned long seed;
+
+static unsigned long rnd(unsigned long range)
+{
+    seed = (seed * 1103515245ul + 12345ul) & 0x7FFFFFFFul;
+    return (seed >> 8) % range;
+}
+
+struct out {
+    char *buf;
+    long len;
+    long size;
+};
+
+static void put(struct out *o, const char *str)
+{
+    while ((*str != 0) && (o->len < o->size))
+        o->buf[o->len++] = *(str++);
+}
+
+static const char *word(void)
+{
+    return words[rnd(sizeof words / sizeof words[0])];
+}
+
+static void gen_prose(struct out *o)
+{
+    long col = 0;
+
+    while (o->len < o->size) {
+        const char *w = word();
+        if (col + (long)strlen(w) > 60 + (long)rnd(16)) {
+            put(o, "\n");
+            col = 0;
+        } else if (col > 0) {
+            put(o, " ");
+            col++;
+        }
+        put(o, w);
+        col += strlen(w);
+    }
+}
+
+static void gen_longlines(struct out *o)
+{
+    while (o->len < o->size) {
+        put(o, word());
+        put(o, " ");
+    }
+}
+
+static void gen_nospace(struct out *o)
+{
+    while (o->len < o->size)
+        put(o, word());
+}
+
+static void gen_tabs(struct out *o)
+{
+    while (o->len < o->size) {
+        int i, cols = 1 + rnd(8);
+        for (i = 0; i < cols; i++) {
+            put(o, "\t");
+            if (rnd(3) != 0)
+                put(o, word());
+        }
+        put(o, "\n");
+    }
+}
+
+static void gen_html(struct out *o)
+{
+    put(o, "<html><head><title>Benchmark page</title>"
+           "<script type=\"text/javascript\">var x = 1 < 2;</script></head><body>\n");
+    while (o->len < o->size) {
+        int i, n = 20 + rnd(60);
+        put(o, "<p class=\"para\">");
+        for (i = 0; i < n; i++) {
+            switch (rnd(16)) {
+                case 0:
+                    put(o, "<a href=\"gopher://gopher.example.org/1/");
+                    put(o, word());
+                    put(o, "\">");
+                    put(o, word());
+                    put(o, "</a> ");
+                    break;
+                case 1:
+                    put(o, entities[rnd(sizeof entities / sizeof entities[0])]);
+                    break;
+                case 2:
+                    put(o, "<b>");
+                    put(o, word());
+                    put(o, "</b> ");
+                    break;
+                case 3:
+                    put(o, "<br>\n");
+                    break;
+                default:
+                    put(o, word());
+                    put(o, " ");
+            }
+        }
+        put(o, "</p>\n");
+    }
+}
+
+static void gen_entities(struct out *o)
+{
+    while (o->len < o->size) {
+        put(o, entities[rnd(sizeof entities / sizeof entities[0])]);
+        if (rnd(8) == 0)
+            put(o, " ");
+    }
+}
+
+static void gen_gophermap(struct out *o)
+{
+    char line[256];
+
+    while (o->len < o->size) {
+        switch (rnd(4)) {
+            case 0:
+                sprintf(line, "i%s %s %s\tfake\t(NULL)\t0\r\n", word(), word(), word());
+                break;
+            case 1:
+                sprintf(line, "0%s %s\t/%s/%s.txt\tgopher.example.org\t70\r\n", word(), word(), word(), word());
+                break;
+            case 2:
+                sprintf(line, "1%s %s %s %s %s %s %s %s %s %s %s %s %s %s %s\t/%s\tgopher%lu.example.org\t7070\r\n",
+                        word(), word(), word(), word(), word(), word(), word(), word(), word(),
+                        word(), word(), word(), word(), word(), word(), word(), rnd(50));
+                break;
+            default:
+                sprintf(line, "9%s.zip\t/pub/%s.zip\tgopher.example.org\t70\r\n", word(), word());
+        }
+        put(o, line);
+    }
+}
+
+char *bench_corpus(const char *kind, long size)
+{
+    static const struct {
+        const char *kind;
+        void (*gen)(struct out *o);
+    } kinds[] = {
+        {"prose", gen_prose},
+        {"longlines", gen_longlines},
+        {"nospace", gen_nospace},
+        {"tabs", gen_tabs},
+        {"html", gen_html},
+        {"entities", gen_entities},
+        {"gophermap", gen_gophermap},
+        {NULL, NULL}
+    };
+    struct out o;
+    int i;
+
+    for (i = 0; kinds[i].kind != NULL; i++)
+        if (strcmp(kinds[i].kind, kind) == 0)
+            break;
+    if (kinds[i].kind == NULL)
+        return NULL;
+
+    o.buf = malloc(size + 1);
+    if (o.buf == NULL)
+        return NULL;
+    o.len = 0;
+    o.size = size;
+    seed = 1;
+    kinds[i].gen(&o);
+    o.buf[size] = 0;
+
+    return o.buf;
+}
+
+int bench_init(int argc, char **argv)
+{
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if ((strcmp(argv[i], "-s") == 0) && (i + 1 < argc)) {
+            maxsize = atol(argv[++i]);
+        } else if ((strcmp(argv[i], "-t") == 0) && (i + 1 < argc)) {
+            mintime = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [-s maxsize] [-t seconds]\n", argv[0]);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int bench_wantsize(long size)
+{
+    return size <= maxsize;
+}
+
+static double now(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+void bench_run(const char *name, const char *corpus, long units, const char *unit,
+               void (*fn)(void *arg), void *arg)
+{
+    long iters = 0, batch = 1, i;
+    double start = now();
+    double elapsed;
+
+    /* calls are made in growing batches, so that reading the clock does
+     * not weigh on the measurement of very short operations */
+    do {
+        for (i = 0; i < batch; i++)
+            fn(arg);
+        iters += batch;
+        elapsed = now() - start;
+        if (batch < 65536)
+            batch *= 2;
+    } while (elapsed < mintime);
+
+    printf("bench=%s corpus=%s size=%ld unit=%s iters=%ld ns_per_unit=%.3f units_per_sec=%.0f\n",
+           name, corpus, units, unit, iters,
+           elapsed * 1e9 / ((double)iters * units),
+           ((double)iters * units) / elapsed);
+    fflush(stdout);
+}
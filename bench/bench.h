@@ -0,0 +1,40 @@
+/*
+ * This file is part of the Gopherus project.
+ * It provides the common infrastructure of the benchmark programs.
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+/* sizes of the generated corpora, terminated by 0 */
+extern const long bench_sizes[];
+
+/* generates a corpus of given kind into a malloc()ed buffer of exactly size
+ * bytes plus a NUL terminator. Kinds are:
+ *   prose      lines of words, 60-75 columns wide
+ *   longlines  words without any line break
+ *   nospace    a single word without any break
+ *   tabs       tab-indented columns of short words
+ *   html       an html page made of paragraphs, links and a few entities
+ *   entities   html made almost exclusively of entities
+ *   gophermap  a gopher menu
+ * Returns NULL on unknown kind or out of memory. The content only depends on
+ * the kind and size, so that results are comparable across runs. */
+char *bench_corpus(const char *kind, long size);
+
+/* parses the command line of a benchmark program. Supported options are
+ * -s MAXSIZE (skip corpora bigger than MAXSIZE bytes) and -t SECONDS
+ * (minimum run time of every measurement). Returns 0 on success. */
+int bench_init(int argc, char **argv);
+
+/* returns non-zero if corpora of size bytes shall be benchmarked */
+int bench_wantsize(long size);
+
+/* runs fn(arg) repeatedly for at least the configured time and prints the
+ * result as a single line of key=value pairs:
+ *   bench=NAME corpus=CORPUS size=UNITS unit=UNIT iters=N ns_per_unit=X units_per_sec=Y
+ * units is the amount of work done by a single call (bytes or operations). */
+void bench_run(const char *name, const char *corpus, long units, const char *unit,
+               void (*fn)(void *arg), void *arg);
+
+#endif
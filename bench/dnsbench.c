@@ -0,0 +1,37 @@
+/*
+ * This file is part of the Gopherus project.
+ * Benchmarks lookups in the DNS cache.
+ */
+
+#include <stdio.h>
+#include "dnscache.h"
+#include "bench.h"
+
+#define NHOSTS 16
+
+static char hosts[NHOSTS][32];
+
+static void ask(void *arg)
+{
+    const char *host = arg;
+    dnscache_ask(host);
+}
+
+int main(int argc, char **argv)
+{
+    int i;
+
+    if (bench_init(argc, argv) != 0)
+        return 1;
+
+    for (i = 0; i < NHOSTS; i++) {
+        sprintf(hosts[i], "gopher%d.example.org", i);
+        dnscache_add(hosts[i], 0x7F000001ul + i);
+    }
+
+    bench_run("dnscache_ask", "hit-first", 1, "op", ask, hosts[0]);
+    bench_run("dnscache_ask", "hit-last", 1, "op", ask, hosts[NHOSTS - 1]);
+    bench_run("dnscache_ask", "miss", 1, "op", ask, "gopher.unknown.example.org");
+
+    return 0;
+}
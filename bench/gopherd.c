@@ -0,0 +1,313 @@
+/*
+ * This file is part of the Gopherus project.
+ *
+ * A small gopher and HTTP server serving generated content, meant to test
+ * and measure the network path of Gopherus without the internet. Every
+ * connection is served by a forked process. Selectors are:
+ *
+ *   /              a menu linking to a sample of everything below
+ *   /menu/N        a gophermap of N items, terminated by a '.' line
+ *   /text/N        N bytes of text
+ *   /html/N        N bytes of html
+ *   /bin/N         N bytes of binary data
+ *
+ * A request starting with "GET " is answered over HTTP/1.0 with the same
+ * content and a Content-Length header. Options:
+ *
+ *   -p PORT        port to listen on (default 7070)
+ *   -h HOST        host name used in generated menus (default localhost)
+ *   -l MSEC        latency before the first byte of every answer
+ *   -b BYTES       bandwidth limit per connection, in bytes per second
+ *   -L MSEC        lingering: time to wait after the data before closing
+ *   -f PERCENT     flakiness: share of requests that are never answered
+ *   -t QLEN        accepts TCP Fast Open (requests in the SYN), with up to
+ *                  QLEN such connections pending
+ */
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include "bench.h"
+
+#define MAXSIZE (1024l * 1024 * 1024)
+
+static unsigned short port = 7070;
+static const char *hostname = "localhost";
+static long latency;    /* msec */
+static long bandwidth;  /* bytes per second, 0 = unlimited */
+static long linger;     /* msec */
+static int flaky;       /* percent of requests left hanging */
+
+static void msleep(long msec)
+{
+    if (msec > 0)
+        usleep(msec * 1000);
+}
+
+static double now(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/* sends len bytes, throttled to the configured bandwidth */
+static int sendall(int sk, const char *buf, long len)
+{
+    double start = now();
+    long sent = 0;
+
+    while (sent < len) {
+        long chunk = len - sent;
+        ssize_t res;
+
+        if ((bandwidth > 0) && (chunk > 1460))
+            chunk = 1460;
+        res = send(sk, buf + sent, chunk, 0);
+        if (res < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        sent += res;
+
+        if (bandwidth > 0) {
+            double ahead = (double)sent / bandwidth - (now() - start);
+            if (ahead > 0)
+                usleep(ahead * 1000000);
+        }
+    }
+
+    return 0;
+}
+
+static char *gen_menu(long items, long *len)
+{
+    static const char *types = "0019h";
+    char *buf = malloc(items * (128 + strlen(hostname)) + 4);
+    long i;
+
+    if (buf == NULL)
+        return NULL;
+
+    *len = 0;
+    for (i = 0; i < items; i++) {
+        switch (types[i % 5]) {
+            case '0':
+                *len += sprintf(buf + *len, "0Text file #%ld\t/text/%ld\t%s\t%u\r\n", i, 1024 + i * 512, hostname, port);
+                break;
+            case '1':
+                *len += sprintf(buf + *len, "1Sub-menu #%ld\t/menu/%ld\t%s\t%u\r\n", i, 10 + i, hostname, port);
+                break;
+            case '9':
+                *len += sprintf(buf + *len, "9Binary file #%ld\t/bin/%ld\t%s\t%u\r\n", i, 4096 + i * 1024, hostname, port);
+                break;
+            default:
+                *len += sprintf(buf + *len, "hHtml page #%ld\t/html/%ld\t%s\t%u\r\n", i, 2048 + i * 256, hostname, port);
+        }
+    }
+    *len += sprintf(buf + *len, ".\r\n");
+
+    return buf;
+}
+
+static char *gen_root(long *len)
+{
+    char *buf = malloc(512 + 6 * (strlen(hostname) + 8));
+
+    if (buf == NULL)
+        return NULL;
+
+    *len = sprintf(buf,
+        "iGopherus test server\tfake\t(NULL)\t0\r\n"
+        "i\tfake\t(NULL)\t0\r\n"
+        "1Menu of 10 items\t/menu/10\t%s\t%u\r\n"
+        "1Menu of 1000 items\t/menu/1000\t%s\t%u\r\n"
+        "0Text, 1 KiB\t/text/1024\t%s\t%u\r\n"
+        "0Text, 1 MiB\t/text/1048576\t%s\t%u\r\n"
+        "hHtml, 64 KiB\t/html/65536\t%s\t%u\r\n"
+        "9Binary, 10 MiB\t/bin/10485760\t%s\t%u\r\n"
+        ".\r\n",
+        hostname, port, hostname, port, hostname, port,
+        hostname, port, hostname, port, hostname, port);
+
+    return buf;
+}
+
+static char *gen_bin(long size)
+{
+    char *buf = malloc(size + 1);
+    unsigned long seed = 1;
+    long i;
+
+    if (buf == NULL)
+        return NULL;
+    for (i = 0; i < size; i++) {
+        seed = (seed * 1103515245ul + 12345ul) & 0x7FFFFFFFul;
+        buf[i] = seed >> 16;
+    }
+
+    return buf;
+}
+
+/* builds the answer for a selector, returns NULL if unknown */
+static char *answer(const char *selector, long *len)
+{
+    long arg = -1;
+    const char *slash;
+
+    if ((selector[0] == 0) || (strcmp(selector, "/") == 0))
+        return gen_root(len);
+
+    slash = strrchr(selector, '/');
+    if ((slash != NULL) && (slash[1] != 0))
+        arg = atol(slash + 1);
+    if ((arg < 0) || (arg > MAXSIZE))
+        return NULL;
+
+    if (strncmp(selector, "/menu/", 6) == 0)
+        return gen_menu(arg, len);
+
+    *len = arg;
+    if (strncmp(selector, "/text/", 6) == 0)
+        return bench_corpus("prose", arg);
+    if (strncmp(selector, "/html/", 6) == 0)
+        return bench_corpus("html", arg);
+    if (strncmp(selector, "/bin/", 5) == 0)
+        return gen_bin(arg);
+
+    return NULL;
+}
+
+static void serve(int sk)
+{
+    char req[1024];
+    long reqlen = 0, len = 0;
+    char *selector, *end, *body;
+    int http;
+
+    /* read the request line */
+    while (reqlen < (long)sizeof req - 1) {
+        ssize_t res = recv(sk, req + reqlen, sizeof req - 1 - reqlen, 0);
+        if (res <= 0)
+            return;
+        reqlen += res;
+        req[reqlen] = 0;
+        if (strchr(req, '\n') != NULL)
+            break;
+    }
+
+    /* a flaky server accepts the request, and then hangs for a minute */
+    srand(getpid());
+    if (rand() % 100 < flaky) {
+        sleep(60);
+        return;
+    }
+
+    http = (strncmp(req, "GET ", 4) == 0);
+    selector = http ? req + 4 : req;
+    end = selector + strcspn(selector, http ? " \r\n" : "\t\r\n");
+    *end = 0;
+
+    body = answer(selector, &len);
+    msleep(latency);
+
+    if (http) {
+        char hdr[256];
+        if (body != NULL) {
+            sprintf(hdr, "HTTP/1.0 200 OK\r\nContent-Type: %s\r\nContent-Length: %ld\r\n\r\n",
+                    (strncmp(selector, "/html/", 6) == 0) ? "text/html" : "application/octet-stream", len);
+        } else {
+            strcpy(hdr, "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+        }
+        sendall(sk, hdr, strlen(hdr));
+    } else if (body == NULL) {
+        static const char err[] = "3Selector not found\tfake\t(NULL)\t0\r\n.\r\n";
+        sendall(sk, err, sizeof err - 1);
+    }
+
+    if (body != NULL)
+        sendall(sk, body, len);
+
+    msleep(linger);
+    free(body);
+}
+
+int main(int argc, char **argv)
+{
+    struct sockaddr_in addr;
+    int sk, opt, on = 1, fastopen = 0;
+
+    while ((opt = getopt(argc, argv, "p:h:l:b:L:f:t:")) != -1) {
+        switch (opt) {
+            case 'p':
+                port = atoi(optarg);
+                break;
+            case 'h':
+                hostname = optarg;
+                break;
+            case 'l':
+                latency = atol(optarg);
+                break;
+            case 'b':
+                bandwidth = atol(optarg);
+                break;
+            case 'L':
+                linger = atol(optarg);
+                break;
+            case 'f':
+                flaky = atoi(optarg);
+                break;
+            case 't':
+                fastopen = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "Usage: gopherd [-p port] [-h host] [-l latency_ms] [-b bytes_per_sec] [-L linger_ms] [-f flaky_percent] [-t fastopen_qlen]\n");
+                return 1;
+        }
+    }
+
+    signal(SIGCHLD, SIG_IGN); /* no zombies */
+    signal(SIGPIPE, SIG_IGN);
+
+    sk = socket(AF_INET, SOCK_STREAM, 0);
+    if (sk < 0) {
+        perror("socket");
+        return 2;
+    }
+    setsockopt(sk, SOL_SOCKET, SO_REUSEADDR, &on, sizeof on);
+    if ((fastopen > 0) && (setsockopt(sk, IPPROTO_TCP, TCP_FASTOPEN, &fastopen, sizeof fastopen) != 0))
+        perror("TCP_FASTOPEN");
+
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if ((bind(sk, (struct sockaddr *)&addr, sizeof addr) != 0) || (listen(sk, 128) != 0)) {
+        perror("bind");
+        return 2;
+    }
+
+    fprintf(stderr, "gopherd: listening on port %u\n", port);
+
+    for (;;) {
+        int client = accept(sk, NULL, NULL);
+        if (client < 0)
+            continue;
+        if (fork() == 0) {
+            close(sk);
+            serve(client);
+            close(client);
+            _exit(0);
+        }
+        close(client);
+    }
+}
@@ -0,0 +1,195 @@
+/*
+ * This file is part of the Gopherus project.
+ *
+ * Loads a URL many times through loadfile_buff(), the very function the
+ * client uses, first sequentially and then from a number of concurrent
+ * worker processes. Reports the 50th, 95th and 99th percentiles of the DNS,
+ * connect, time-to-first-byte and total times, in microseconds:
+ *
+ *   mode=sequential requests=100 failed=0 phase=connect p50=112 p95=180 p99=240
+ *
+ * Each -r option adds a replica of the URL, as '+' items do in menus. The
+ * requests that asked more than one server, and those a replica answered,
+ * are then counted as well:
+ *
+ *   mode=sequential requests=100 failed=0 hedged=6 replica_answers=5
+ *
+ * -b sets the receive buffer of the connections, in KiB (see net_setrcvbuf()).
+ *
+ * Usage: loadtest [-n requests] [-c concurrency] [-m maxsize] [-b rcvbuf_kib] [-r replica_url]... URL
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "bufpool.h"
+#include "common.h"
+#include "loadfile.h"
+#include "net.h"
+#include "parseurl.h"
+
+#define MAXREPLICAS 8
+
+struct sample {
+    struct loadstats stats;
+    long len;
+};
+
+static const char *replicastr[MAXREPLICAS];
+static int replicacount;
+
+static int cmplong(const void *a, const void *b)
+{
+    long x = *(const long *)a, y = *(const long *)b;
+    return (x > y) - (x < y);
+}
+
+/* fetches url count times and writes the samples to fd */
+static void worker(const char *urlstr, long count, long maxsize, int fd)
+{
+    struct gopherusconfig cfg;
+    struct url url, replica[MAXREPLICAS];
+    char statusbar[128];
+    long i;
+
+    parse_url(urlstr, &url);
+    for (i = 0; i < replicacount; i++)
+        parse_url(replicastr[i], &replica[i]);
+    memset(&cfg, 0, sizeof cfg);
+
+    for (i = 0; i < count; i++) {
+        struct sample s;
+        char *buf = bufpool_alloc(BUFPOOL_MINSIZE); /* as the client does for every page */
+        if (buf == NULL)
+            break;
+        statusbar[0] = 0;
+        s.len = loadfile_buff(&url, replica, replicacount, &buf, maxsize, statusbar, NULL, &cfg, &s.stats, NULL);
+        bufpool_free(buf);
+        if (write(fd, &s, sizeof s) != sizeof s)
+            break;
+    }
+}
+
+static void report(const char *mode, struct sample *samples, long count)
+{
+    static const char *phases[] = {"dns", "connect", "ttfb", "total"};
+    long *values = malloc(count * sizeof *values);
+    long i, ok = 0;
+    int p;
+
+    if (values == NULL)
+        return;
+
+    for (p = 0; p < 4; p++) {
+        ok = 0;
+        for (i = 0; i < count; i++) {
+            const struct loadstats *st = &samples[i].stats;
+            if (samples[i].len < 0)
+                continue;
+            values[ok++] = (p == 0) ? st->dns : (p == 1) ? st->connect : (p == 2) ? st->ttfb : st->total;
+        }
+        if (ok == 0)
+            break;
+        qsort(values, ok, sizeof *values, cmplong);
+        printf("mode=%s requests=%ld failed=%ld phase=%s p50=%ld p95=%ld p99=%ld\n",
+               mode, count, count - ok, phases[p],
+               values[(ok - 1) * 50 / 100], values[(ok - 1) * 95 / 100], values[(ok - 1) * 99 / 100]);
+    }
+    if (ok == 0)
+        printf("mode=%s requests=%ld failed=%ld\n", mode, count, count);
+    if (replicacount > 0) {
+        long hedged = 0, replicas = 0;
+        for (i = 0; i < count; i++) {
+            if (samples[i].stats.servers > 1)
+                hedged++;
+            if ((samples[i].len >= 0) && (samples[i].stats.server > 0))
+                replicas++;
+        }
+        printf("mode=%s requests=%ld failed=%ld hedged=%ld replica_answers=%ld\n", mode, count, count - ok, hedged, replicas);
+    }
+
+    free(values);
+}
+
+/* runs count fetches spread over workers processes, and reports them */
+static int run(const char *mode, const char *url, long count, int workers, long maxsize)
+{
+    struct sample *samples = malloc(count * sizeof *samples);
+    long got = 0;
+    int fds[2];
+    int w;
+
+    if ((samples == NULL) || (pipe(fds) != 0))
+        return -1;
+
+    for (w = 0; w < workers; w++) {
+        long share = count / workers + (w < count % workers);
+        if (fork() == 0) {
+            close(fds[0]);
+            worker(url, share, maxsize, fds[1]);
+            _exit(0);
+        }
+    }
+    close(fds[1]);
+
+    while (got < count) {
+        ssize_t res = read(fds[0], (char *)samples + got * sizeof *samples, sizeof *samples);
+        if (res != sizeof *samples)
+            break;
+        got++;
+    }
+    close(fds[0]);
+    while (wait(NULL) > 0);
+
+    report(mode, samples, got);
+    free(samples);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    long count = 100, maxsize = 1024l * 1024, rcvbuf = 0;
+    int workers = 8;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:c:m:b:r:")) != -1) {
+        switch (opt) {
+            case 'n':
+                count = atol(optarg);
+                break;
+            case 'c':
+                workers = atoi(optarg);
+                break;
+            case 'm':
+                maxsize = atol(optarg);
+                break;
+            case 'b':
+                rcvbuf = atol(optarg);
+                break;
+            case 'r':
+                if (replicacount < MAXREPLICAS)
+                    replicastr[replicacount++] = optarg;
+                break;
+            default:
+                optind = argc;
+        }
+    }
+
+    if ((optind != argc - 1) || (count < 1) || (workers < 1) || (maxsize < 1)) {
+        fprintf(stderr, "Usage: loadtest [-n requests] [-c concurrency] [-m maxsize] [-b rcvbuf_kib] [-r replica_url]... URL\n");
+        return 1;
+    }
+
+    if (net_init() != 0) {
+        fprintf(stderr, "Network subsystem initialization failed!\n");
+        return 2;
+    }
+    net_setrcvbuf(rcvbuf * 1024);
+
+    run("sequential", argv[optind], count, 1, maxsize);
+    run("concurrent", argv[optind], count, workers, maxsize);
+
+    return 0;
+}
@@ -0,0 +1,57 @@
+/*
+ * This file is part of the Gopherus project.
+ * Benchmarks the gophermap parser of the menu viewer. The parser modifies
+ * its input, so every iteration starts with a fresh copy of the raw menu.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "menuview.h"
+#include "bench.h"
+
+struct job {
+    const char *src;
+    char *buf;
+    long len;
+};
+
+static struct menu menu;
+
+static void parse(void *arg)
+{
+    struct job *job = arg;
+
+    memcpy(job->buf, job->src, job->len + 1);
+    menu_parse(&menu, job->buf, job->len, 80);
+    menu_free(&menu);
+}
+
+int main(int argc, char **argv)
+{
+    int s;
+
+    if (bench_init(argc, argv) != 0)
+        return 1;
+
+    for (s = 0; bench_sizes[s] != 0; s++) {
+        struct job job;
+        char *corpus;
+
+        if (!bench_wantsize(bench_sizes[s]))
+            continue;
+        corpus = bench_corpus("gophermap", bench_sizes[s]);
+        job.buf = malloc(bench_sizes[s] + 1);
+        if ((corpus == NULL) || (job.buf == NULL)) {
+            fprintf(stderr, "out of memory\n");
+            return 2;
+        }
+        job.src = corpus;
+        job.len = bench_sizes[s];
+        bench_run("menu_parse", "gophermap", bench_sizes[s], "B", parse, &job);
+        free(job.buf);
+        free(corpus);
+    }
+
+    return 0;
+}
@@ -0,0 +1,84 @@
+/*
+ * This file is part of the Gopherus project.
+ * Benchmarks process_plain_text(), process_html() and the search through
+ * a whole document for a text that is not there.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "html.h"
+#include "plaintext.h"
+#include "search.h"
+#include "bench.h"
+
+struct job {
+    char *dst;
+    const char *src;
+    long len;
+};
+
+static void plain(void *arg)
+{
+    struct job *job = arg;
+    process_plain_text(job->dst, 8 * job->len + 1, job->src, job->len);
+}
+
+static void html(void *arg)
+{
+    struct job *job = arg;
+    struct htmllinks links;
+    process_html(job->dst, job->src, job->len, &links);
+    html_freelinks(&links);
+}
+
+static void search(void *arg)
+{
+    struct job *job = arg;
+    if (search_next(job->src, job->len, "Gopherus", 0) >= 0)
+        job->dst[0] = 1; /* not expected, but keeps the call from being optimized out */
+}
+
+static const struct {
+    const char *name;
+    const char *kind;
+    void (*fn)(void *arg);
+} cases[] = {
+    {"process_plain_text", "prose", plain},
+    {"process_plain_text", "tabs", plain},
+    {"process_plain_text", "longlines", plain},
+    {"process_html", "html", html},
+    {"process_html", "entities", html},
+    {"search_next", "prose", search},
+    {NULL, NULL, NULL}
+};
+
+int main(int argc, char **argv)
+{
+    int i, s;
+
+    if (bench_init(argc, argv) != 0)
+        return 1;
+
+    for (i = 0; cases[i].name != NULL; i++) {
+        for (s = 0; bench_sizes[s] != 0; s++) {
+            struct job job;
+            char *corpus;
+
+            if (!bench_wantsize(bench_sizes[s]))
+                continue;
+            corpus = bench_corpus(cases[i].kind, bench_sizes[s]);
+            job.dst = malloc(8 * bench_sizes[s] + 1); /* worst case of tab expansion */
+            if ((corpus == NULL) || (job.dst == NULL)) {
+                fprintf(stderr, "out of memory\n");
+                return 2;
+            }
+            job.src = corpus;
+            job.len = bench_sizes[s];
+            bench_run(cases[i].name, cases[i].kind, bench_sizes[s], "B", cases[i].fn, &job);
+            free(job.dst);
+            free(corpus);
+        }
+    }
+
+    return 0;
+}
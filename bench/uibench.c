@@ -0,0 +1,53 @@
+/*
+ * This file is part of the Gopherus project
+ *
+ * Measures how many screen cells per second the UI backend is able to put
+ * on screen. Every frame changes all the cells, so that nothing can be
+ * skipped by the backend. 'make bench' builds it against the backend that
+ * gopherus is built with, or by hand:
+ *
+ *   gcc -I. -o uibench bench/uibench.c ui-sdl.c utf8.c -lSDL
+ */
+
+#include <stdio.h>
+#include <stdlib.h>      /* atoi() */
+#include <sys/time.h>    /* gettimeofday() */
+#include "ui.h"
+
+int main(int argc, char **argv)
+{
+    static const int attrs[4] = {0x17, 0x70, 0x47, 0x20};
+    struct timeval start, stop;
+    long frames = 200;
+    long frame, cells;
+    unsigned int x, y;
+    double secs;
+
+    if (argc > 1)
+        frames = atoi(argv[1]);
+    if (frames < 1) {
+        puts("Usage: uibench [frames]");
+        return 0;
+    }
+
+    ui_init();
+    ui_cursor_hide();
+    ui_cls();
+
+    gettimeofday(&start, NULL);
+    for (frame = 0; frame < frames; frame++) {
+        for (y = 0; y < ui_rows; y++)
+            for (x = 0; x < ui_cols; x++)
+                ui_putchar(' ' + (x + y + frame) % 95, attrs[frame & 3], x, y);
+        ui_refresh();
+    }
+    gettimeofday(&stop, NULL);
+
+    cells = frames * ui_rows * ui_cols;
+    secs = (stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1000000.0;
+
+    ui_cls();
+    printf("frames=%ld cells=%ld seconds=%.3f cells_per_sec=%.0f\n",
+           frames, cells, secs, (secs > 0) ? cells / secs : 0.0);
+    return 0;
+}
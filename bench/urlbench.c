@@ -0,0 +1,52 @@
+/*
+ * This file is part of the Gopherus project.
+ * Benchmarks parse_url() and build_url().
+ */
+
+#include <stdio.h>
+#include "parseurl.h"
+#include "bench.h"
+
+static const char *urls[] = {
+    "gopher://gopher.floodgap.com/1/v2",
+    "gopher.example.org",
+    "gopher://gopher.example.org:7070/0/pub/documents/very/deep/path/to/a/file.txt",
+    "http://www.example.org/index.html",
+    "gopher://sdf.org/7/users/search\tquery string",
+    "gopher://#welcome"
+};
+
+#define NURLS (sizeof urls / sizeof urls[0])
+
+static struct url parsed[NURLS];
+
+static void parse(void *arg)
+{
+    size_t i;
+
+    (void)arg;
+    for (i = 0; i < NURLS; i++)
+        parse_url(urls[i], &parsed[i]);
+}
+
+static void build(void *arg)
+{
+    char buf[512];
+    size_t i;
+
+    (void)arg;
+    for (i = 0; i < NURLS; i++)
+        build_url(buf, sizeof buf, &parsed[i]);
+}
+
+int main(int argc, char **argv)
+{
+    if (bench_init(argc, argv) != 0)
+        return 1;
+
+    bench_run("parse_url", "mixed", NURLS, "op", parse, NULL);
+    parse(NULL);
+    bench_run("build_url", "mixed", NURLS, "op", build, NULL);
+
+    return 0;
+}
@@ -0,0 +1,59 @@
+/*
+ * This file is part of the Gopherus project.
+ * Benchmarks wordwrap_span() over whole documents.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "wordwrap.h"
+#include "bench.h"
+
+struct job {
+    const char *src;
+    long len;
+    int width;
+};
+
+static void wrapall(void *arg)
+{
+    struct job *job = arg;
+    long offset = 0, next;
+    int linelen;
+
+    do {
+        next = wordwrap_span(job->src + offset, job->len - offset, job->width, &linelen);
+        offset += next;
+    } while (next >= 0);
+}
+
+int main(int argc, char **argv)
+{
+    static const char *kinds[] = {"prose", "longlines", "nospace", "tabs", NULL};
+    int i, s;
+
+    if (bench_init(argc, argv) != 0)
+        return 1;
+
+    for (i = 0; kinds[i] != NULL; i++) {
+        for (s = 0; bench_sizes[s] != 0; s++) {
+            struct job job;
+            char *corpus;
+
+            if (!bench_wantsize(bench_sizes[s]))
+                continue;
+            corpus = bench_corpus(kinds[i], bench_sizes[s]);
+            if (corpus == NULL) {
+                fprintf(stderr, "out of memory\n");
+                return 2;
+            }
+            job.src = corpus;
+            job.len = strlen(corpus);
+            job.width = 80;
+            bench_run("wordwrap", kinds[i], bench_sizes[s], "B", wrapall, &job);
+            free(corpus);
+        }
+    }
+
+    return 0;
+}
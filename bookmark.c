@@ -0,0 +1,442 @@
+/*
+ * This file is part of the Gopherus project.
+ *
+ * Keeps the bookmarks of the user, in a file that is a gophermap of them,
+ * and shows them on a page of their own. When the page is opened, the
+ * servers of the bookmarks are probed in the background, a few at once,
+ * and the page tells how fast each one is to connect to as results come.
+ */
+
+#include <stdio.h>     /* FILE, sprintf() */
+#include <stdlib.h>    /* getenv(), malloc(), atoi() */
+#include <string.h>
+#include <sys/time.h>  /* gettimeofday() */
+#include "bookmark.h"
+#include "common.h"
+#include "dnscache.h"
+#include "gopher.h"
+#include "hoststat.h"
+#include "net.h"
+
+#define MAXBOOKMARKS 128
+#define MAXTITLE 255       /* chars of a title that are kept */
+#define PROBE_INFLIGHT 4   /* servers being connected to at once */
+#define PROBE_COLUMN 15    /* width of the column telling how a probe went */
+
+/* how the probe of a server goes */
+#define PROBE_QUEUED 0     /* waiting for its turn, or for its host to be resolved */
+#define PROBE_CONNECTING 1
+#define PROBE_UP 2         /* connected, after latency usec */
+#define PROBE_DOWN 3       /* the connection failed */
+#define PROBE_SILENT 4     /* the server did not answer before its deadline */
+#define PROBE_NOHOST 5     /* the host could not be resolved */
+
+struct bookmark {
+    char *title;           /* followed by the selector, in the same allocation */
+    const char *selector;
+    const char *host;      /* interned */
+    unsigned short port;
+    char itemtype;
+};
+
+struct probe {
+    const char *host;      /* interned */
+    unsigned short port;
+    int state;
+    struct net_tcpsocket *sk;
+    struct timeval start;
+    long deadline;         /* usec the connection is waited for */
+    long latency;
+};
+
+static struct bookmark bookmark_table[MAXBOOKMARKS];
+static int bookmarkcount = -1; /* -1 until the bookmarks are loaded */
+static struct probe probe_table[MAXBOOKMARKS];
+static int probecount;
+
+/* returns the path of the bookmarks file: GOPHERUSBOOKMARKS if set, or else
+ * one in the home directory if there is one, or in the current directory */
+static const char *bookmarkfile(void)
+{
+    static char path[256];
+    const char *env = getenv("GOPHERUSBOOKMARKS");
+
+    if ((env != NULL) && (env[0] != 0))
+        return env;
+    env = getenv("HOME");
+    if ((env != NULL) && (env[0] != 0) && (strlen(env) < sizeof path - 32)) {
+        sprintf(path, "%s/.gopherus-bookmarks", env);
+        return path;
+    }
+    return "GOPHERUS.BMK";
+}
+
+/* sets a bookmark, copying its title and selector. Returns 0 on success. */
+static int setbookmark(struct bookmark *b, char itemtype, const char *title, int titlelen, const char *selector, const char *host, unsigned short port)
+{
+    size_t selectorlen = strlen(selector);
+    int i;
+
+    if (titlelen > MAXTITLE)
+        titlelen = MAXTITLE;
+    b->title = malloc(titlelen + selectorlen + 2);
+    if (b->title == NULL)
+        return -1;
+    for (i = 0; i < titlelen; i++) /* a gophermap has no room for these in a title */
+        b->title[i] = ((title[i] == '\t') || (title[i] == '\r') || (title[i] == '\n')) ? ' ' : title[i];
+    b->title[titlelen] = 0;
+    b->selector = b->title + titlelen + 1;
+    memcpy(b->title + titlelen + 1, selector, selectorlen + 1);
+    b->host = host;
+    b->port = port;
+    b->itemtype = itemtype;
+    return 0;
+}
+
+/* loads the bookmarks from their file, on first use */
+static void load(void)
+{
+    char line[1024];
+    FILE *fd;
+
+    if (bookmarkcount >= 0)
+        return;
+    bookmarkcount = 0;
+    fd = fopen(bookmarkfile(), "rb");
+    if (fd == NULL)
+        return;
+
+    /* each line is a gophermap item: type and title, selector, host, port */
+    while ((bookmarkcount < MAXBOOKMARKS) && (fgets(line, sizeof line, fd) != NULL)) {
+        char *field[4];
+        const char *host;
+        int count = 1;
+        char *p;
+
+        line[strcspn(line, "\r\n")] = 0;
+        field[0] = line;
+        for (p = line; (*p != 0) && (count < 4); p++) {
+            if (*p == '\t') {
+                *p = 0;
+                field[count++] = p + 1;
+            }
+        }
+        if ((count < 4) || (line[0] == 0) || (field[2][0] == 0))
+            continue;
+        host = url_internhost(field[2], strlen(field[2]));
+        if ((host == NULL) || (setbookmark(&bookmark_table[bookmarkcount], line[0], line + 1, strlen(line + 1), field[1], host, (unsigned short)atoi(field[3])) != 0))
+            break;
+        bookmarkcount += 1;
+    }
+    fclose(fd);
+}
+
+/* writes the bookmarks to their file. Returns 0 on success. */
+static int save(void)
+{
+    FILE *fd = fopen(bookmarkfile(), "wb");
+    int i, res;
+
+    if (fd == NULL)
+        return -1;
+    for (i = 0; i < bookmarkcount; i++) {
+        const struct bookmark *b = &bookmark_table[i];
+        fprintf(fd, "%c%s\t%s\t%s\t%u\r\n", b->itemtype, b->title, b->selector, b->host, b->port);
+    }
+    res = ferror(fd);
+    if (fclose(fd) != 0)
+        res = -1;
+    return res;
+}
+
+/* returns the bookmark of url, or -1 if it is not bookmarked */
+static int findbookmark(const struct url *url)
+{
+    int i;
+
+    for (i = 0; i < bookmarkcount; i++) {
+        const struct bookmark *b = &bookmark_table[i];
+        if ((b->host == url->host) && (b->port == url->port) && (b->itemtype == url->itemtype) && (strcmp(b->selector, url->selector) == 0))
+            return i;
+    }
+    return -1;
+}
+
+int bookmark_ispage(const struct url *url)
+{
+    return (strcmp(url->host, "#bookmarks") == 0);
+}
+
+int bookmark_add(const struct url *url, const char *title, int len, char *statusbar)
+{
+    load();
+    if ((url->protocol != PARSEURL_PROTO_GOPHER) || (url->host[0] == '#') || (strpbrk(url->selector, "\t\r\n") != NULL)) {
+        sprintf(statusbar, "!This location cannot be bookmarked");
+        return -1;
+    }
+    if (findbookmark(url) >= 0) {
+        sprintf(statusbar, "This location is bookmarked already");
+        return -1;
+    }
+    if (bookmarkcount == MAXBOOKMARKS) {
+        sprintf(statusbar, "!There are too many bookmarks already");
+        return -1;
+    }
+    if (setbookmark(&bookmark_table[bookmarkcount], url->itemtype, title, len, url->selector, url->host, url->port) != 0) {
+        sprintf(statusbar, "!Out of memory");
+        return -1;
+    }
+    bookmarkcount += 1;
+    if (save() != 0) {
+        sprintf(statusbar, "!Error: could not save the bookmarks to %.80s", bookmarkfile());
+        return -1;
+    }
+    sprintf(statusbar, "Bookmarked: %.100s", bookmark_table[bookmarkcount - 1].title);
+    return 0;
+}
+
+int bookmark_remove(const struct url *url, char *statusbar)
+{
+    int i;
+
+    load();
+    i = findbookmark(url);
+    if (i < 0) {
+        sprintf(statusbar, "!This is not a bookmark");
+        return -1;
+    }
+    free(bookmark_table[i].title);
+    bookmarkcount -= 1;
+    memmove(&bookmark_table[i], &bookmark_table[i + 1], (bookmarkcount - i) * sizeof bookmark_table[i]);
+    if (save() != 0) {
+        sprintf(statusbar, "!Error: could not save the bookmarks to %.80s", bookmarkfile());
+        return -1;
+    }
+    sprintf(statusbar, "Bookmark removed");
+    return 0;
+}
+
+/* returns the probe of the server of a bookmark, or NULL if there is none */
+static struct probe *findprobe(const struct bookmark *b)
+{
+    int i;
+
+    for (i = 0; i < probecount; i++)
+        if ((probe_table[i].host == b->host) && (probe_table[i].port == b->port))
+            return &probe_table[i];
+    return NULL;
+}
+
+void bookmark_probe(void)
+{
+    int i;
+
+    load();
+    if (bookmark_probing())
+        return;
+
+    /* each server is probed once, however many bookmarks it serves */
+    probecount = 0;
+    for (i = 0; i < bookmarkcount; i++) {
+        const struct bookmark *b = &bookmark_table[i];
+        if ((b->host[0] == '#') || (findprobe(b) != NULL))
+            continue;
+        probe_table[probecount].host = b->host;
+        probe_table[probecount].port = b->port;
+        probe_table[probecount].state = PROBE_QUEUED;
+        probecount += 1;
+        dnscache_prefetch(b->host);
+    }
+}
+
+int bookmark_probing(void)
+{
+    int i;
+
+    for (i = 0; i < probecount; i++)
+        if ((probe_table[i].state == PROBE_QUEUED) || (probe_table[i].state == PROBE_CONNECTING))
+            return 1;
+    return 0;
+}
+
+/* returns the address of the host of a queued probe, or 0 if the probe has
+ * to wait for it to be resolved in the background. The probe of a host that
+ * could not be resolved is over. The name is resolved right away only where
+ * names cannot be resolved in the background at all (as in DOS), every
+ * page load waiting for names there anyway. */
+static unsigned long probeaddr(struct probe *p)
+{
+    unsigned long ipaddr = dnscache_ask(p->host);
+
+    if (ipaddr != 0)
+        return ipaddr;
+    if (dnscache_failed(p->host)) {
+        p->state = PROBE_NOHOST;
+        return 0;
+    }
+    if (dnscache_prefetch(p->host) >= 0) /* being resolved, or soon */
+        return 0;
+
+    ipaddr = net_dnsresolve(p->host);
+    dnscache_add(p->host, ipaddr);
+    if (ipaddr == 0)
+        p->state = PROBE_NOHOST;
+    return ipaddr;
+}
+
+/* starts the probe of a server whose host is resolved. Returns 0 if it is
+ * connecting, or non-zero if it is over already. */
+static int startprobe(struct probe *p, unsigned long ipaddr)
+{
+    gettimeofday(&p->start, NULL);
+    p->sk = net_connectprobe(ipaddr, p->port);
+    if (p->sk == NULL) {
+        p->state = PROBE_DOWN;
+        return -1;
+    }
+    p->deadline = hoststat_deadline(p->host, p->port, HOSTSTAT_CONNECT);
+    p->state = PROBE_CONNECTING;
+    return 0;
+}
+
+int bookmark_poll(long usec)
+{
+    struct net_tcpsocket *sk[PROBE_INFLIGHT];
+    struct probe *p;
+    int inflight = 0, changed = 0, resolving = 0, i;
+
+    for (i = 0; i < probecount; i++)
+        if (probe_table[i].state == PROBE_CONNECTING)
+            inflight += 1;
+
+    /* start the next probes, as others are over */
+    dnscache_collect(NULL, 0);
+    for (i = 0; (i < probecount) && (inflight < PROBE_INFLIGHT); i++) {
+        unsigned long ipaddr;
+        p = &probe_table[i];
+        if (p->state != PROBE_QUEUED)
+            continue;
+        ipaddr = probeaddr(p);
+        if (ipaddr == 0) {
+            if (p->state == PROBE_QUEUED) {
+                resolving = 1;
+            } else {
+                changed = 1;
+            }
+        } else if (startprobe(p, ipaddr) != 0) {
+            changed = 1;
+        } else {
+            inflight += 1;
+        }
+    }
+
+    if (inflight == 0) { /* nothing to wait for but names */
+        if (resolving && !changed)
+            dnscache_collect(NULL, usec);
+        return changed;
+    }
+
+    inflight = 0;
+    for (i = 0; i < probecount; i++)
+        if (probe_table[i].state == PROBE_CONNECTING)
+            sk[inflight++] = probe_table[i].sk;
+    net_wait(sk, inflight, usec);
+
+    /* several connections may be over at once */
+    for (i = 0; i < probecount; i++) {
+        int res;
+        p = &probe_table[i];
+        if (p->state != PROBE_CONNECTING)
+            continue;
+        res = net_isconnected(p->sk);
+        if (res > 0) {
+            p->latency = usec_since(&p->start);
+            p->state = PROBE_UP;
+            hoststat_measure(p->host, p->port, HOSTSTAT_CONNECT, p->latency);
+        } else if (res < 0) {
+            p->state = PROBE_DOWN;
+            hoststat_failure(p->host, p->port);
+        } else if (usec_since(&p->start) > p->deadline) {
+            p->state = PROBE_SILENT;
+            hoststat_timeout(p->host, p->port, HOSTSTAT_CONNECT);
+        } else {
+            continue;
+        }
+        net_abort(p->sk);
+        p->sk = NULL;
+        changed = 1;
+    }
+    return changed;
+}
+
+void bookmark_flush(void)
+{
+    int i;
+
+    for (i = 0; i < probecount; i++)
+        if (probe_table[i].state == PROBE_CONNECTING)
+            net_abort(probe_table[i].sk);
+    probecount = 0;
+    for (i = 0; i < bookmarkcount; i++)
+        free(bookmark_table[i].title);
+    bookmarkcount = -1;
+}
+
+/* appends the n bytes of str to the page in buffer, if they fit */
+static void append(char *buffer, long size, long *len, const char *str, long n)
+{
+    if (*len + n <= size)
+        memcpy(buffer + *len, str, n);
+    *len += n;
+}
+
+long bookmark_page(char *buffer, long size)
+{
+    static const char header[] = "iBookmarks\ni\n";
+    static const char empty[] = "iThere are no bookmarks yet.\n";
+    static const char footer[] =
+        "i\n"
+        "iPress 'b' on a link of a menu, or in a document, to bookmark it. Here, DEL\n"
+        "iremoves the selected bookmark, and F5 probes the servers again.\n";
+    char line[MAXTITLE + 64];
+    long len = 0;
+    int i;
+
+    load();
+    append(buffer, size, &len, header, sizeof header - 1);
+    if (bookmarkcount == 0)
+        append(buffer, size, &len, empty, sizeof empty - 1);
+
+    for (i = 0; i < bookmarkcount; i++) {
+        const struct bookmark *b = &bookmark_table[i];
+        const struct probe *p = findprobe(b);
+        char status[32];
+
+        status[0] = 0;
+        if (p == NULL) {
+            /* not probed */
+        } else if ((p->state == PROBE_QUEUED) || (p->state == PROBE_CONNECTING)) {
+            sprintf(status, "[...]");
+        } else if (p->state == PROBE_UP) {
+            if (p->latency < 1000) {
+                sprintf(status, "[<1 ms]");
+            } else {
+                sprintf(status, "[%ld ms]", p->latency / 1000);
+            }
+        } else if (p->state == PROBE_DOWN) {
+            sprintf(status, "[down]");
+        } else if (p->state == PROBE_SILENT) {
+            sprintf(status, "[no answer]");
+        } else {
+            sprintf(status, "[unknown host]");
+        }
+        sprintf(line, "%c%-*s%s\t", b->itemtype, PROBE_COLUMN, status, b->title);
+        append(buffer, size, &len, line, strlen(line));
+        append(buffer, size, &len, b->selector, strlen(b->selector));
+        sprintf(line, "\t%.200s\t%u\n", b->host, b->port);
+        append(buffer, size, &len, line, strlen(line));
+    }
+
+    append(buffer, size, &len, footer, sizeof footer - 1);
+    return len;
+}
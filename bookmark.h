@@ -0,0 +1,42 @@
+/*
+ * This file is part of the Gopherus project.
+ */
+
+#ifndef BOOKMARK_H
+#define BOOKMARK_H
+
+#include "parseurl.h"
+
+#define BOOKMARK_URL "gopher://#bookmarks/1"
+
+/* returns non-zero if url is the bookmarks page */
+int bookmark_ispage(const struct url *url);
+
+/* adds url to the bookmarks, described by the len first chars of title,
+ * and saves them. Tells how it went in statusbar. Returns 0 on success. */
+int bookmark_add(const struct url *url, const char *title, int len, char *statusbar);
+
+/* removes the bookmark of url, and saves the bookmarks. Tells how it went
+ * in statusbar. Returns 0 on success. */
+int bookmark_remove(const struct url *url, char *statusbar);
+
+/* starts probing the servers of the bookmarks in the background, unless
+ * they are being probed already */
+void bookmark_probe(void);
+
+/* returns non-zero while the servers of the bookmarks are being probed */
+int bookmark_probing(void);
+
+/* lets the probes go on, waiting up to usec microseconds for them. Returns
+ * non-zero if one of them is over, so that the page tells something new. */
+int bookmark_poll(long usec);
+
+/* writes the bookmarks page, a gophermap telling how fast each server is
+ * to connect to, into buffer of size bytes, and returns its length.
+ * Nothing is written if the page does not fit. */
+long bookmark_page(char *buffer, long size);
+
+/* stops the probes, and frees the bookmarks */
+void bookmark_flush(void);
+
+#endif
@@ -0,0 +1,112 @@
+/*
+ * This file is part of the Gopherus project.
+ *
+ * Resources are received into buffers of this pool, which become the cache
+ * of the history as they are, so that pages are neither copied nor sized
+ * again once loaded. Reusing freed buffers of a few fixed sizes also keeps
+ * the heap from being fragmented by pages of every size over a session.
+ */
+
+#include <stdlib.h>    /* malloc(), free() */
+#include <string.h>    /* memcpy() */
+#include "bufpool.h"
+
+#define CLASSCOUNT 5   /* 4 KiB, 16 KiB, 64 KiB, 256 KiB and 1 MiB */
+
+/* what precedes every buffer. The union keeps the buffer aligned for
+ * anything. */
+union header {
+    struct {
+        union header *next;  /* next free buffer of the same class */
+        long size;           /* bytes the buffer holds */
+    } h;
+    double align_d;
+    long align_l;
+    void *align_p;
+};
+
+static union header *freelist[CLASSCOUNT];
+static long keptbytes;
+
+/* returns the class of buffers of at least size bytes, or -1 if too large */
+static int sizeclass(long size)
+{
+    int class;
+    long classsize = BUFPOOL_MINSIZE;
+
+    for (class = 0; class < CLASSCOUNT; class++, classsize *= 4)
+        if (size <= classsize)
+            return class;
+    return -1;
+}
+
+char *bufpool_alloc(long size)
+{
+    int class = sizeclass(size);
+    union header *hdr;
+
+    if ((class >= 0) && (freelist[class] != NULL)) {
+        hdr = freelist[class];
+        freelist[class] = hdr->h.next;
+        keptbytes -= hdr->h.size;
+        return (char *)(hdr + 1);
+    }
+
+    if (class >= 0)
+        size = BUFPOOL_MINSIZE << (2 * class);
+    hdr = malloc(sizeof *hdr + size);
+    if (hdr == NULL)
+        return NULL;
+    hdr->h.size = size;
+    return (char *)(hdr + 1);
+}
+
+long bufpool_size(const char *buf)
+{
+    return ((const union header *)buf - 1)->h.size;
+}
+
+char *bufpool_grow(char *buf, long len, long size)
+{
+    char *newbuf = bufpool_alloc(size);
+
+    if (newbuf == NULL)
+        return NULL;
+    if (len > 0)
+        memcpy(newbuf, buf, len);
+    bufpool_free(buf);
+    return newbuf;
+}
+
+void bufpool_free(char *buf)
+{
+    union header *hdr;
+    int class;
+
+    if (buf == NULL)
+        return;
+    hdr = (union header *)buf - 1;
+    class = sizeclass(hdr->h.size);
+
+    if ((class < 0) || (keptbytes + hdr->h.size > BUFPOOL_MAXSIZE)) {
+        free(hdr);
+        return;
+    }
+    hdr->h.next = freelist[class];
+    freelist[class] = hdr;
+    keptbytes += hdr->h.size;
+}
+
+void bufpool_flush(void)
+{
+    int class;
+
+    for (class = 0; class < CLASSCOUNT; class++) {
+        while (freelist[class] != NULL) {
+            union header *hdr = freelist[class];
+            freelist[class] = hdr->h.next;
+            free(hdr);
+        }
+    }
+    keptbytes = 0;
+}
@@ -0,0 +1,32 @@
+/*
+ * This file is part of the Gopherus project.
+ */
+
+#ifndef BUFPOOL_H
+#define BUFPOOL_H
+
+/* buffers come in size classes, from BUFPOOL_MINSIZE to BUFPOOL_MAXSIZE
+ * bytes, each 4 times the previous one. A buffer given back is kept for
+ * reuse, as long as the pool does not hold more than BUFPOOL_MAXSIZE bytes
+ * this way. Larger buffers are allocated as asked, and never kept. */
+#define BUFPOOL_MINSIZE 4096l
+#define BUFPOOL_MAXSIZE (1024l * 1024l)
+
+/* returns a buffer of at least size bytes, or NULL if out of memory */
+char *bufpool_alloc(long size);
+
+/* returns the number of bytes buf can hold */
+long bufpool_size(const char *buf);
+
+/* moves the len first bytes of buf (possibly NULL) into a buffer of at
+ * least size bytes, and gives buf back. Returns the new buffer, or NULL if
+ * out of memory, buf being left as it is then. */
+char *bufpool_grow(char *buf, long len, long size);
+
+/* gives buf (possibly NULL) back to the pool */
+void bufpool_free(char *buf);
+
+/* frees the buffers kept for reuse */
+void bufpool_flush(void);
+
+#endif
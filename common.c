@@ -4,11 +4,58 @@
  */
 
 #include <string.h>
+#include <sys/time.h>  /* gettimeofday() */
 #include "alloca.h"
+#include "bookmark.h"
 #include "common.h"
 #include "history.h"
 #include "parseurl.h"
 #include "ui.h"
+#include "utf8.h"
+
+/* returns non-zero if the user asked to interrupt the current operation */
+int is_int_pending(void)
+{
+    int res = 0;
+    while (ui_kbhit()) {
+        int key = ui_getkey();
+        switch (key) {
+            case KEY_ESCAPE:
+            case KEY_BACKSPACE:
+                res = 1;
+                break;
+        }
+    }
+    return res;
+}
+
+/* returns the number of microseconds elapsed since *since */
+long usec_since(const struct timeval *since)
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (now.tv_sec - since->tv_sec) * 1000000l + (now.tv_usec - since->tv_usec);
+}
+
+/* sets *t to msec milliseconds from now */
+void later(struct timeval *t, long msec)
+{
+    gettimeofday(t, NULL);
+    t->tv_sec += msec / 1000;
+    t->tv_usec += (msec % 1000) * 1000;
+    if (t->tv_usec >= 1000000l) {
+        t->tv_sec += 1;
+        t->tv_usec -= 1000000l;
+    }
+}
+
+/* returns non-zero once the time *t has come */
+int due(const struct timeval *t)
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (now.tv_sec > t->tv_sec) || ((now.tv_sec == t->tv_sec) && (now.tv_usec >= t->tv_usec));
+}
 
 void draw_field(const char *str, int attr, int x, int y, int width, int len)
 {
@@ -17,10 +64,24 @@ void draw_field(const char *str, int attr, int x, int y, int width, int len)
     if (len == -1)
         len = strlen(str);
 
-    if (len < width) {
-        ui_cputs(str, attr, x, y);
-
-        for (i = len; i < width; i++)
+    if (!utf8_isascii(str, len)) { /* chars may take several bytes, and 0 to 2 columns */
+        const char *end = str + len;
+        int col = 0;
+        while ((str < end) && (*str != 0)) {
+            unsigned long cp = utf8_decode(&str);
+            int w = utf8_width(cp);
+            if (col + w > width)
+                break;
+            if (w > 0) /* combining chars are left out, a cell holds one char */
+                ui_putglyph(cp, attr, x + col, y);
+            col += w;
+        }
+        for (; col < width; col++)
+            ui_putchar(' ', attr, x + col, y);
+    } else if (len < width) {
+        for (i = 0; i < len; i++)
+            ui_putchar(str[i], attr, x+i, y);
+        for (; i < width; i++)
             ui_putchar(' ', attr, x+i, y);
     } else {
         for (i = 0; i < width; i++)
@@ -67,6 +128,7 @@ void draw_statusbar(char *origmsg, struct gopherusconfig *cfg)
     }
     for (; x < ui_cols; x++) ui_putchar(' ', colattr, x, y);
     origmsg[0] = 0; /* clear out the status message once it's displayed */
+    ui_refresh(); /* the status bar is often drawn right before a blocking operation */
 }
 
 /* edits a string on screen. returns 0 if the string hasn't been modified, non-zero otherwise. */
@@ -108,6 +170,10 @@ int editstring(char *str, int maxlen, int maxdisplaylen, int x, int y, int attr,
             case KEY_END:
                 cursorpos = len;
                 break;
+            case KEY_CTRL_U: /* clear the whole string */
+                cursorpos = len = 0;
+                str[0] = 0;
+                break;
             case KEY_ENTER:
                 result = -1;
                 goto exit;
@@ -206,3 +272,11 @@ void go_to_help(struct gopherus *g)
     parse_url(help_url_str, &help_url);
     history_add(&(g->history), &help_url);
 }
+
+void go_to_bookmarks(struct gopherus *g)
+{
+    struct url bookmarks_url;
+    char bookmarks_url_str[] = BOOKMARK_URL;
+    parse_url(bookmarks_url_str, &bookmarks_url);
+    history_add(&(g->history), &bookmarks_url);
+}
@@ -6,6 +6,7 @@
 #ifndef COMMON_H
 #define COMMON_H
 
+#include <sys/time.h>  /* struct timeval */
 #include "history.h"
 
 #define DISPLAY_ORDER_NONE 0
@@ -18,9 +19,11 @@
 
 #define KEY_BACKSPACE  0x08
 #define KEY_TAB        0x09
+#define KEY_CTRL_U     0x15
 #define KEY_ENTER      0x0D
 #define KEY_ESCAPE     0x1B
 #define KEY_F1         0x13B
+#define KEY_F2         0x13C
 #define KEY_F5         0x13F
 #define KEY_F9         0x143
 #define KEY_HOME       0x147
@@ -44,17 +47,34 @@ struct gopherusconfig {
     int attr_statusbarwarn;
     int attr_urlbar;
     int attr_urlbardeco;
+    long preconnect;  /* msec the selection rests on a link before its server gets connected, -1 for never */
+    long rcvbuf;      /* KiB of receive buffer of the connections, 0 for the system's default */
+    int waitclose;    /* non-zero if a menu is complete only once the server closed, even after its '.' line */
+    const char *offline; /* the mirror browsed instead of the servers (see mirror.h), or NULL */
 };
 
 struct gopherus {
     char statusbar[128];
-    char *buf;
     struct historytype *history;
     struct gopherusconfig cfg;
 };
 
+/* returns non-zero if the user asked to interrupt the current operation */
+int is_int_pending(void);
+
+/* returns the number of microseconds elapsed since *since */
+long usec_since(const struct timeval *since);
+
+/* sets *t to msec milliseconds from now */
+void later(struct timeval *t, long msec);
+
+/* returns non-zero once the time *t has come */
+int due(const struct timeval *t);
+
 void set_statusbar(char *buf, char *msg);
 
+/* draws the len first bytes of the UTF-8 string str (all of it if len is
+ * -1) on a field of width columns, padded with spaces */
 void draw_field(const char *str, int attr, int x, int y, int width, int len);
 
 void draw_urlbar(struct url *url, struct gopherusconfig *cfg);
@@ -72,4 +92,6 @@ int ask_quit_confirmation(struct gopherusconfig *cfg);
 
 void go_to_help(struct gopherus *g);
 
+void go_to_bookmarks(struct gopherus *g);
+
 #endif
@@ -6,10 +6,13 @@
 #include <time.h>
 #include <string.h>
 #include "dnscache.h"
+#include "net.h"
 
-#define MAXENTRIES 16
-#define MAXHOSTLEN 31
+#define MAXENTRIES 64
+#define MAXHOSTLEN 255 /* the longest name DNS has is 253 chars */
 #define CACHETIME 120
+#define FAILTIME 30    /* how long a name that could not be resolved is not tried again */
+#define MAXPENDING 64  /* hosts being resolved in the background */
 
 struct dnscache_type4 {
     char host[MAXHOSTLEN + 1];
@@ -18,6 +21,7 @@ struct dnscache_type4 {
 };
 
 static struct dnscache_type4 dnscache_table4[MAXENTRIES];
+static const char *dnscache_pending[MAXPENDING];
 
 /* returns the ip addr if host found in cache, 0 otherwise */
 unsigned long dnscache_ask(const char *host)
@@ -33,6 +37,22 @@ unsigned long dnscache_ask(const char *host)
     return 0;
 }
 
+int dnscache_failed(const char *host)
+{
+    size_t i;
+    time_t curtime = time(NULL);
+
+    if (strlen(host) > MAXHOSTLEN)
+        return 1; /* no such name exists */
+
+    for (i = 0; i < MAXENTRIES; i++)
+        if ((dnscache_table4[i].addr == 0) && (curtime - dnscache_table4[i].inserttime < FAILTIME))
+            if (!strcasecmp(host, dnscache_table4[i].host))
+                return 1;
+
+    return 0;
+}
+
 /* adds a new entry to the DNS cache */
 void dnscache_add(const char *host, unsigned long ipaddr)
 {
@@ -59,3 +79,61 @@ void dnscache_add(const char *host, unsigned long ipaddr)
     dnscache_table4[oldest].addr = ipaddr;
     dnscache_table4[oldest].inserttime = time(NULL);
 }
+
+/* returns the slot of host among the pending ones, or -1 if not there */
+static int findpending(const char *host)
+{
+    int i;
+
+    for (i = 0; i < MAXPENDING; i++)
+        if (dnscache_pending[i] == host) /* both are interned */
+            return i;
+    return -1;
+}
+
+/* returns non-zero if any name is being resolved in the background */
+static int anypending(void)
+{
+    int i;
+
+    for (i = 0; i < MAXPENDING; i++)
+        if (dnscache_pending[i] != NULL)
+            return 1;
+    return 0;
+}
+
+int dnscache_prefetch(const char *host)
+{
+    int slot, res;
+
+    dnscache_collect(NULL, 0); /* so that results do not pile up */
+    if ((findpending(host) >= 0) || (dnscache_ask(host) != 0) || dnscache_failed(host))
+        return 0;
+    slot = findpending(NULL);
+    if (slot < 0)
+        return 1;
+    res = net_dnsstart(host);
+    if (res == 0)
+        dnscache_pending[slot] = host;
+    return res;
+}
+
+int dnscache_collect(const char *host, long usec)
+{
+    const char *name;
+    unsigned long ipaddr;
+
+    for (;;) {
+        int waiting = (host != NULL) ? (findpending(host) >= 0) : anypending();
+        int slot;
+        name = net_dnsdone(&ipaddr, waiting ? usec : 0);
+        if (name == NULL)
+            return waiting;
+        slot = findpending(name);
+        if (slot >= 0)
+            dnscache_pending[slot] = NULL;
+        dnscache_add(name, ipaddr);
+        if (host == NULL)
+            usec = 0; /* any name was waited for, the others are only taken if done */
+    }
+}
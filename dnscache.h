@@ -9,7 +9,22 @@
 /* returns the ip addr if host found in cache, 0 otherwise */
 unsigned long dnscache_ask(const char *host);
 
-/* adds a new entry to the DNS cache */
+/* returns non-zero if host could not be resolved lately */
+int dnscache_failed(const char *host);
+
+/* adds a new entry to the DNS cache. An ipaddr of 0 tells that host could not
+   be resolved, which is remembered for a shorter while. */
 void dnscache_add(const char *host, unsigned long ipaddr);
 
+/* starts resolving host in the background, unless it is in the cache or
+   being resolved already. host is interned (see parseurl.h). Returns 0 if
+   host is in the cache or being resolved, 1 if too many names are being
+   resolved to start now, or -1 if it cannot be resolved in the background. */
+int dnscache_prefetch(const char *host);
+
+/* adds the hosts resolved in the background to the cache. If host (or any
+   name, if host is NULL) is being resolved, waits up to usec microseconds
+   for it. Returns non-zero if it is still being resolved then. */
+int dnscache_collect(const char *host, long usec);
+
 #endif
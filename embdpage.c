@@ -18,10 +18,11 @@
  */
 
 #include <string.h>
+#include "bookmark.h"
 #include "version.h"
 
-/* loads an embedded page into a memory buffer and returns */
-int load_embedded_page(char *buffer, char *selector)
+/* loads an embedded page into a memory buffer and returns its length */
+long load_embedded_page(char *buffer, long size, const char *selector)
 {
     static const char *welcome =
         "i\n"
@@ -75,12 +76,21 @@ int load_embedded_page(char *buffer, char *selector)
         "\n"
         " Key bindings:\n"
         "   TAB       - Switch to/from URL bar edition\n"
+        "   CTRL+U    - Clear the URL bar, while editing it\n"
         "   ESC       - Quit Gopherus (requires a confirmation)\n"
         "   UP/DOWN   - Scroll the screen's content up/down by one line\n"
         "   PGUP/PGDW - Scroll the screen's content up/down by one page\n"
         "   HOME/END  - Go to the begin/end of the document\n"
+        "   0..9      - Jump to 0%, 10%, ... 90% of a text document\n"
+        "   /         - Find a text within a text document (ignoring case)\n"
+        "   n/N       - Find the next/previous occurrence of the text\n"
+        "   LEFT/RGHT - Select the previous/next link of an html page\n"
+        "   ENTER     - Follow the selected link\n"
         "   BACKSPC   - Go back to the previous location\n"
+        "   b         - Bookmark the selected link, or the document\n"
+        "   DEL       - Remove the selected bookmark (on the bookmarks page)\n"
         "   F1        - Show help (this manual)\n"
+        "   F2        - Show bookmarks\n"
         "   F5        - Refresh current location\n"
         "   F9        - Download location on disk\n"
         "\n"
@@ -141,6 +151,18 @@ int load_embedded_page(char *buffer, char *selector)
         "  Missing those green 1980-like phosphor CRTs?..: \"022020202002020220\"\n"
         "\n"
         "\n"
+        " ** Bookmarks **\n"
+        "\n"
+        " Pressing 'b' bookmarks the link selected in a menu, or the document being\n"
+        " read, and F2 shows the bookmarks. As that page opens, Gopherus connects to\n"
+        " the servers of the bookmarks, and tells how long each one took to accept the\n"
+        " connection, or why it failed. There, DEL removes the selected bookmark, and\n"
+        " F5 connects to the servers again. The bookmarks are kept in the file\n"
+        " '.gopherus-bookmarks' of the home directory, or else in 'GOPHERUS.BMK' in the\n"
+        " current directory, unless the environment variable 'GOPHERUSBOOKMARKS' tells\n"
+        " another path. The file is a gophermap, that can be edited by hand.\n"
+        "\n"
+        "\n"
         " ** Final notes **\n"
         "\n"
         " Gopherus has been written with care to behave nicely and follow standards.\n"
@@ -152,6 +174,9 @@ int load_embedded_page(char *buffer, char *selector)
     size_t len;
 
     switch (selector[0]) {
+        case 'b': /* bookmarks, that are probed as the page is opened */
+            bookmark_probe();
+            return bookmark_page(buffer, size);
         case 'l': /* license */
             page = license;
             break;
@@ -163,7 +188,8 @@ int load_embedded_page(char *buffer, char *selector)
     }
 
     len = strlen(page);
-    memcpy(buffer, page, len);
+    if ((long)len <= size)
+        memcpy(buffer, page, len);
 
     return len;
 }
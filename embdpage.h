@@ -6,7 +6,8 @@
 #ifndef EMBDPAGE_H
 #define EMBDPAGE_H
 
-/* loads an embedded page into a memory buffer and returns */
-int load_embedded_page(char *buffer, char *selector);
+/* loads an embedded page into buffer, a buffer of size bytes, and returns
+ * its length. Nothing is loaded if the page does not fit. */
+long load_embedded_page(char *buffer, long size, const char *selector);
 
 #endif
@@ -21,14 +21,14 @@
 #include <string.h>  /* strlen() */
 #include <stdlib.h>  /* malloc(), getenv() */
 #include <stdio.h>   /* sprintf(), fwrite()... */
-#include <time.h>    /* time_t */
-#include <unistd.h>  /* usleep() */
+#include "bookmark.h"
+#include "bufpool.h"
 #include "common.h"
-#include "dnscache.h"
-#include "embdpage.h"
 #include "gopher.h"
 #include "history.h"
+#include "loadfile.h"
 #include "menuview.h"
+#include "mirror.h"
 #include "net.h"
 #include "parseurl.h"
 #include "textview.h"
@@ -36,6 +36,11 @@
 #include "version.h"
 #include "wordwrap.h"
 
+#define DEFAULT_PRECONNECT 300 /* msec */
+#define DEFAULT_MIRRORDEPTH 8
+#define DEFAULT_MIRRORJOBS 4
+#define DEFAULT_MIRRORDELAY 250 /* msec */
+
 static int hex2int(char c)
 {
     switch (c) {
@@ -111,187 +116,31 @@ static void loadcfg(struct gopherusconfig *cfg)
     cfg->attr_menuerr = (hex2int(colorstring[12]) << 4) | hex2int(colorstring[13]);
     cfg->attr_menuselectable = (hex2int(colorstring[14]) << 4) | hex2int(colorstring[15]);
     cfg->attr_menucurrent = (hex2int(colorstring[16]) << 4) | hex2int(colorstring[17]);
+    cfg->preconnect = DEFAULT_PRECONNECT;
+    if (getenv("GOPHERUSPRECONNECT") != NULL)
+        cfg->preconnect = atol(getenv("GOPHERUSPRECONNECT"));
+    cfg->rcvbuf = 0;
+    if (getenv("GOPHERUSRCVBUF") != NULL)
+        cfg->rcvbuf = atol(getenv("GOPHERUSRCVBUF"));
+    cfg->waitclose = 0;
+    if (getenv("GOPHERUSWAITCLOSE") != NULL)
+        cfg->waitclose = atoi(getenv("GOPHERUSWAITCLOSE"));
 }
 
-int is_int_pending(void)
-{
-    int res = 0;
-    while (ui_kbhit()) {
-        int key = ui_getkey();
-        switch (key) {
-            case KEY_ESCAPE:
-            case KEY_BACKSPACE:
-                res = 1;
-                break;
-        }
-    }
-    return res;
-}
-
-/* downloads a gopher or http resource and write it to a file or a memory buffer. if *filename is not NULL, the resource will
-   be written in the file (but a valid *buffer is still required) */
-static long loadfile_buff(const struct url *url, char *buffer, long buffer_max, char *statusbar, char *filename, struct gopherusconfig *cfg)
+/* returns the value of arg if it is the switch -name=value (or /name=value), or NULL otherwise */
+static const char *switchvalue(const char *arg, const char *name)
 {
-    unsigned long int ipaddr;
-    long reslength, byteread, fdlen = 0;
-    char statusmsg[128];
-    FILE *fd = NULL;
-    int headersdone = 0; /* used notably for HTTP, to localize the end of headers */
-    time_t lastactivity, curtime;
-    if (url->host[0] == '#') { /* embedded start page */
-        reslength = load_embedded_page(buffer, url->host + 1);
-        /* open file, if downloading to a file */
-        if (filename != NULL) {
-            fd = fopen(filename, "rb"); /* try to open for read - this should fail */
-            if (fd != NULL) {
-                set_statusbar(statusbar, "!File already exists! Operation aborted.");
-                fclose(fd);
-                return -1;
-            }
-            fd = fopen(filename, "wb"); /* now open for write - this will create the file */
-            if (fd == NULL) { /* this should not fail */
-                set_statusbar(statusbar, "!Error: could not create the file on disk!");
-                fclose(fd);
-                return -1;
-            }
-            fwrite(buffer, 1, reslength, fd);
-            fclose(fd);
-        }
-        return reslength;
-    }
-    ipaddr = dnscache_ask(url->host);
-    if (ipaddr == 0) {
-        sprintf(statusmsg, "Resolving '%s'...", url->host);
-        draw_statusbar(statusmsg, cfg);
-        ipaddr = net_dnsresolve(url->host);
-        if (ipaddr == 0) {
-            set_statusbar(statusbar, "!DNS resolution failed!");
-            return -1;
-        }
-        dnscache_add(url->host, ipaddr);
-    }
-    sprintf(statusmsg, "Connecting to %d.%d.%d.%d...", (int)(ipaddr >> 24) & 0xFF, (int)(ipaddr >> 16) & 0xFF, (int)(ipaddr >> 8) & 0xFF, (int)(ipaddr & 0xFF));
-    draw_statusbar(statusmsg, cfg);
+    size_t len = strlen(name);
 
-    if (net_connect(ipaddr, url->port) != 0) {
-        set_statusbar(statusbar, "!Connection error!");
-        return -1;
-    }
-    if (url->protocol == PARSEURL_PROTO_HTTP) { /* http */
-        sprintf(buffer, "GET /%s HTTP/1.0\r\nHOST: %s\r\nUSER-AGENT: Gopherus v" VERSION "\r\n\r\n", url->selector, url->host);
-    } else { /* gopher */
-        sprintf(buffer, "%s\r\n", url->selector);
-    }
-    if (net_send(buffer, strlen(buffer)) != (int)strlen(buffer)) {
-        set_statusbar(statusbar, "!send() error!");
-        net_close();
-        return -1;
-    }
-    /* prepare timers */
-    lastactivity = time(NULL);
-    curtime = lastactivity;
-    /* open file, if downloading to a file */
-    if (filename != NULL) {
-        fd = fopen(filename, "rb"); /* try to open for read - this should fail */
-        if (fd != NULL) {
-            set_statusbar(statusbar, "!File already exists! Operation aborted.");
-            fclose(fd);
-            net_abort();
-            return -1;
-        }
-        fd = fopen(filename, "wb"); /* now open for write - this will create the file */
-        if (fd == NULL) { /* this should not fail */
-            set_statusbar(statusbar, "!Error: could not create the file on disk!");
-            fclose(fd);
-            net_abort();
-            return -1;
-        }
-    }
-    /* receive answer */
-    reslength = 0;
-    for (;;) {
-        if (buffer_max + fdlen - reslength < 1) { /* too much data! */
-            set_statusbar(statusbar, "!Error: Server's answer is too long!");
-            reslength = -1;
-            break;
-        }
-        byteread = net_recv(buffer + (reslength - fdlen), buffer_max + fdlen - reslength);
-        curtime = time(NULL);
-        if (byteread < 0) break; /* end of connection */
-
-        if (is_int_pending()) {
-            set_statusbar(statusbar, "Connection aborted by the user.");
-            reslength = -1;
-            break;
-        }
-
-        if (byteread > 0) {
-            lastactivity = curtime;
-            reslength += byteread;
-            /* if protocol is http, ignore headers */
-            if ((url->protocol == PARSEURL_PROTO_HTTP) && (headersdone == 0)) {
-                int i;
-                for (i = 0; i < reslength - 2; i++) {
-                    if (buffer[i] == '\n') {
-                        if (buffer[i + 1] == '\r') i++; /* skip CR if following */
-                        if (buffer[i + 1] == '\n') {
-                            i += 2;
-                            headersdone = reslength;
-                            for (reslength = 0; i < headersdone; i++) buffer[reslength++] = buffer[i];
-                            break;
-                        }
-                    }
-                }
-            } else {
-                sprintf(statusmsg, "Downloading... [%ld bytes]", reslength);
-                set_statusbar(statusbar, statusmsg);
-                draw_statusbar(statusbar, cfg);
-                if ((fd != NULL) && (reslength - fdlen > 4096)) { /* if downloading to file, write stuff to disk */
-                    int writeres = fwrite(buffer, 1, reslength - fdlen, fd);
-                    if (writeres < 0) writeres = 0;
-                    fdlen += writeres;
-                }
-            }
-        } else {
-            if (curtime - lastactivity > 2) {
-                if (curtime - lastactivity > 20) { /* TIMEOUT! */
-                    set_statusbar(statusbar, "!Timeout while waiting for data!");
-                    reslength = -1;
-                    break;
-                } else {
-                    usleep(250000);  /* give the cpu some time up (250ms), the transfer is really slow */
-                }
-            }
-        }
-    }
-
-    if (reslength >= 0) {
-        statusmsg[0] = 0;
-        draw_statusbar(statusmsg, cfg);
-        net_close();
-    } else {
-        net_abort();
-    }
-
-    if (fd != NULL) { /* finish the buffer */
-        char tmpmsg[80];
-        if (reslength - fdlen > 0) { /* if anything left in the buffer, write it now */
-            fdlen += fwrite(buffer, 1, reslength - fdlen, fd);
-        }
-        fclose(fd);
-        sprintf(tmpmsg, "Saved %ld bytes on disk", fdlen);
-        set_statusbar(statusbar, tmpmsg);
-    }
-
-    return reslength;
+    if ((strncmp(arg + 1, name, len) != 0) || (arg[len + 1] != '='))
+        return NULL;
+    return arg + len + 2;
 }
 
-#define buffersize 1024*1024
-
 static void mainloop(struct gopherus *g)
 {
     int exitflag;
-    int bufferlen;
+    long bufferlen;
 
     for (;;) {
         struct url *url = &(g->history->url); /* a shortcut */
@@ -302,20 +151,27 @@ static void mainloop(struct gopherus *g)
             (url->itemtype == GOPHER_ITEM_HTML)) { /* if it's a displayable item type... */
             draw_urlbar(url, &g->cfg);
 
-            if (g->history->cache == NULL) { /* reload the resource if not in cache already */
-                bufferlen = loadfile_buff(url, g->buf, buffersize, g->statusbar, NULL, &g->cfg);
+            if ((g->history->cache == NULL) && (g->history->display == NULL)) { /* reload the resource if not in cache already */
+                struct loadfile_spool *spool;
+                char *buf = bufpool_alloc(BUFPOOL_MINSIZE);
+                if (buf == NULL) {
+                    sprintf(g->statusbar, "Out of memory!");
+                    break;
+                }
+                bufferlen = loadfile_buff(url, g->history->replica, g->history->replicacount, &buf, BUFPOOL_MAXSIZE, g->statusbar, NULL, &g->cfg, NULL, &spool);
                 if (bufferlen < 0) {
+                    bufpool_free(buf);
                     history_back(&g->history);
                     continue;
-                } else {
+                } else if (spool != NULL) { /* too large for memory, it is viewed from the disk */
+                    bufpool_free(buf);
                     history_cleanupcache(g->history);
-                    g->history->cache = malloc(bufferlen);
-                    if (g->history->cache == NULL) {
-                        sprintf(g->statusbar, "Out of memory!");
-                        exitflag = 1;
-                        break;
-                    }
-                    if (bufferlen > 0) memcpy(g->history->cache, g->buf, bufferlen);
+                    g->history->spool = spool;
+                    g->history->cache = spool->text;
+                    g->history->cachesize = spool->len;
+                } else { /* the buffer it has been received into becomes the cache */
+                    history_cleanupcache(g->history);
+                    g->history->cache = buf;
                     g->history->cachesize = bufferlen;
                 }
             }
@@ -340,9 +196,7 @@ static void mainloop(struct gopherus *g)
             if (exitflag == DISPLAY_ORDER_BACK) {
                 history_back(&(g->history));
             } else if (exitflag == DISPLAY_ORDER_REFR) {
-                free(g->history->cache);
-                g->history->cache = NULL;
-                g->history->cachesize = 0;
+                history_freecache(g->history);
                 g->history->displaymemory[0] = -1;
                 g->history->displaymemory[1] = -1;
             } else if (exitflag == DISPLAY_ORDER_QUIT) {
@@ -358,7 +212,12 @@ static void mainloop(struct gopherus *g)
             if (lastslash)
                 strncpy(filename, lastslash + 1, sizeof filename - 1);
             if (editstring(filename, 63, ui_cols - (sizeof prompt - 1), sizeof prompt - 1, ui_rows - 1, 0x70, NULL) != 0) {
-                loadfile_buff(url, g->buf, buffersize, g->statusbar, filename, &g->cfg);
+                char *buf = bufpool_alloc(BUFPOOL_MINSIZE);
+                if (buf != NULL)
+                    loadfile_buff(url, g->history->replica, g->history->replicacount, &buf, BUFPOOL_MAXSIZE, g->statusbar, filename, &g->cfg, NULL, NULL);
+                else
+                    set_statusbar(g->statusbar, "!Out of memory!");
+                bufpool_free(buf);
             }
             history_back(&(g->history));
         }
@@ -370,14 +229,19 @@ int main(int argc, char **argv)
     struct gopherus g;
     struct url start_url;
     char start_url_str[] = "gopher://#welcome";
+    const char *mirrordir = NULL;
+    struct mirrorlimits limits;
+    int res = 0;
 
     memset(&g, '\0', sizeof g);
+    limits.depth = DEFAULT_MIRRORDEPTH;
+    limits.jobs = DEFAULT_MIRRORJOBS;
+    limits.delay = DEFAULT_MIRRORDELAY;
+    limits.span = 0;
 
     /* Load configuration (or defaults) */
     loadcfg(&g.cfg);
 
-    ui_init();
-
     parse_url(start_url_str, &start_url);
 
     if (history_add(&g.history, &start_url) != 0) {
@@ -391,19 +255,36 @@ int main(int argc, char **argv)
 
         for (i = 1; i < argc; i++) {
             struct url next_url;
-
-            if ((argv[i][0] == '/') || (argv[i][0] == '-')) { /* unknown parameter */
-                ui_puts("Gopherus v" VERSION " Copyright (C) Mateusz Viste " DATE);
-                ui_puts("");
-                ui_puts("Usage: gopherus [url]");
-                ui_puts("");
-                return 1;
+            const char *value;
+
+            if ((argv[i][0] == '/') || (argv[i][0] == '-')) {
+                if ((value = switchvalue(argv[i], "mirror")) != NULL) {
+                    mirrordir = value;
+                } else if ((value = switchvalue(argv[i], "offline")) != NULL) {
+                    g.cfg.offline = value;
+                } else if ((value = switchvalue(argv[i], "depth")) != NULL) {
+                    limits.depth = atoi(value);
+                } else if ((value = switchvalue(argv[i], "jobs")) != NULL) {
+                    limits.jobs = atoi(value);
+                } else if ((value = switchvalue(argv[i], "delay")) != NULL) {
+                    limits.delay = atol(value);
+                } else if (strcmp(argv[i] + 1, "span") == 0) {
+                    limits.span = 1;
+                } else { /* unknown parameter */
+                    ui_puts("Gopherus v" VERSION " Copyright (C) Mateusz Viste " DATE);
+                    ui_puts("");
+                    ui_puts("Usage: gopherus [-offline=dir] [url]");
+                    ui_puts("       gopherus -mirror=dir [-depth=n] [-jobs=n] [-delay=msec] [-span] url");
+                    ui_puts("");
+                    return 1;
+                }
+                continue;
             }
             if (goturl != 0) {
                 ui_puts("Invalid parameters list.");
                 return 1;
             }
-            if (parse_url(argv[1], &next_url) != 0) {
+            if (parse_url(argv[i], &next_url) != 0) {
                 ui_puts("Invalid URL!");
                 return 1;
             }
@@ -416,36 +297,38 @@ int main(int argc, char **argv)
         }
     }
 
-    g.buf = malloc(buffersize);
-
-    if (g.buf == NULL) {
-        char message[128];
-        sprintf(message, "Out of memory. Could not allocate buffer of %d bytes.", buffersize);
-        ui_puts(message);
-        return 2;
+    if ((mirrordir != NULL) && (g.history->next == NULL)) {
+        ui_puts("The URL to mirror is missing.");
+        return 1;
     }
+    if (g.cfg.offline != NULL)
+        g.cfg.preconnect = -1; /* nothing is fetched from the servers */
 
     if (net_init() != 0) {
         ui_puts("Network subsystem initialization failed!");
-        free(g.buf);
         return 3;
     }
+    net_setrcvbuf(g.cfg.rcvbuf * 1024);
 
-    ui_cursor_hide();
-    ui_cls();
-
-    mainloop(&g);
-
-    ui_cls();
-    ui_cursor_show();
+    if (mirrordir != NULL) { /* no screen for that, it prints how it goes */
+        res = mirror_run(&g.history->url, mirrordir, &limits, &g.cfg);
+    } else {
+        ui_init();
+        ui_cursor_hide();
+        ui_cls();
+        mainloop(&g);
+        ui_cls();
+        ui_cursor_show();
+    }
 
     if (g.statusbar[0] != 0)
         ui_puts(g.statusbar); /* we might have here an error message to show */
 
-    /* Free the main buffer */
-    free(g.buf);
-    /* unallocate all the history */
+    /* unallocate all the history, and the buffers kept for reuse */
     history_flush(g.history);
+    bufpool_flush();
+    bookmark_flush();
+    url_freehosts();
 
-    return 0;
+    return (res != 0) ? 4 : 0;
 }
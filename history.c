@@ -4,22 +4,38 @@
  */
 
 #include <stdlib.h>  /* malloc(), NULL */
-#include <string.h>  /* strcasecmp(), ... */
+#include <string.h>  /* strcmp(), ... */
+#include "bufpool.h"
 #include "parseurl.h"
 #include "gopher.h"
 #include "history.h"
+#include "loadfile.h"
 
 #define MAXALLOWEDCACHE 1024*1024*2
 
+void history_freecache(struct historytype *node)
+{
+    if (node->display != NULL) /* it may refer to the raw cache, so it goes first */
+        node->display_free(node->display);
+    node->display = NULL;
+    node->displaysize = 0;
+
+    if (node->cache != NULL) {
+        if (node->spool != NULL) {
+            loadfile_freespool(node->spool);
+        } else {
+            bufpool_free(node->cache);
+        }
+    }
+    node->cache = NULL;
+    node->cachesize = 0;
+    node->spool = NULL;
+}
+
 static void history_free_node(struct historytype *node)
 {
-    if (node->cache != NULL)
-        free(node->cache);
-    if (node->url.selector != NULL)
-        free(node->url.selector);
-    if (node->url.host != NULL)
-        free(node->url.host);
-    free(node);
+    history_freecache(node);
+    free(node); /* the replicas and selectors are stored right after the node */
 }
 
 /* remove the last visited page from history (goes back to the previous one) */
@@ -37,10 +53,10 @@ void history_back(struct historytype **history)
 
     /* check if the last request was a query, and if not in cache, put a message instead to avoid reloading a query again */
     if (((*history)->url.itemtype == GOPHER_ITEM_INDEX_SEARCH_SERVER) &&
-        ((*history)->cache == NULL)) {
+        ((*history)->cache == NULL) && ((*history)->display == NULL)) {
         char *msg = "3Query not in cache\ni\niThis location is not avaiable in the local cache. Gopherus is not reissuing custom queries automatically. If you wish to force a reload, press F5.\n";
         (*history)->cachesize = strlen(msg);
-        (*history)->cache = malloc((*history)->cachesize + 1);
+        (*history)->cache = bufpool_alloc((*history)->cachesize + 1);
         if ((*history)->cache == NULL) { /* oops, out of memory! */
             (*history)->cachesize = 0;
             return;
@@ -51,14 +67,25 @@ void history_back(struct historytype **history)
 
 /* adds a new node to the history list. Returns 0 on success, non-zero otherwise. */
 int history_add(struct historytype **history, const struct url *new_url)
+{
+    return history_add_replicas(history, new_url, NULL, 0);
+}
+
+/* adds a new node to the history list, for a resource that replicacount other servers serve as well. Returns 0 on
+   success, non-zero otherwise. */
+int history_add_replicas(struct historytype **history, const struct url *new_url, const struct url *replica, int replicacount)
 {
     struct historytype *result;
+    struct url *replicas;
+    size_t size;
+    char *selector;
+    int i;
 
     /* shortcut - if the new node is identical to the previous page, the user is doing a 'back' action */
     if (*history != NULL) { /* do we have any history at all? */
         if ((*history)->next != NULL) { /* is there a 'previous' position? */
             if (new_url->protocol == (*history)->next->url.protocol) { /* same protocol */
-                if (strcasecmp(new_url->host, (*history)->next->url.host) == 0) { /* same host */
+                if (new_url->host == (*history)->next->url.host) { /* same host (both are interned) */
                     if (new_url->port == (*history)->next->url.port) { /* same port */
                         if (new_url->itemtype == (*history)->next->url.itemtype) { /* same itemtype */
                             if (strcmp(new_url->selector, (*history)->next->url.selector) == 0) { /* same resource */
@@ -71,27 +98,33 @@ int history_add(struct historytype **history, const struct url *new_url)
             }
         }
     }
-    /* add the node */
-    result = malloc(sizeof *result);
+    /* add the node, with copies of the replicas and of all selectors right after it */
+    size = sizeof *result + replicacount * sizeof *replica + strlen(new_url->selector) + 1;
+    for (i = 0; i < replicacount; i++)
+        size += strlen(replica[i].selector) + 1;
+    result = malloc(size);
     if (result == NULL) return -1;
-    result->url.host = strdup(new_url->host);
-    if (result->url.host == NULL) {
-        free(result);
-        return -1;
+    replicas = (struct url *)(result + 1);
+    selector = (char *)(replicas + replicacount);
+    result->url = *new_url;
+    for (i = 0; i < replicacount; i++)
+        replicas[i] = replica[i];
+    for (i = -1; i < replicacount; i++) {
+        struct url *u = (i < 0) ? &result->url : &replicas[i];
+        size_t len = strlen(u->selector) + 1;
+        memcpy(selector, u->selector, len);
+        u->selector = selector;
+        selector += len;
     }
-    result->url.protocol = new_url->protocol;
-    result->url.port = new_url->port;
-    result->url.itemtype = new_url->itemtype;
+    result->replica = replicas;
+    result->replicacount = replicacount;
     result->displaymemory[0] = -1;
     result->displaymemory[1] = -1;
-    result->url.selector = strdup(new_url->selector);
-    if (result->url.selector == NULL) {
-        free(result->url.host);
-        free(result);
-        return -1;
-    }
     result->cache = NULL;
     result->cachesize = 0;
+    result->spool = NULL;
+    result->display = NULL;
+    result->displaysize = 0;
     result->next = *history;
     *history = result;
     return 0;
@@ -103,13 +136,9 @@ void history_cleanupcache(struct historytype *history)
     unsigned long totalcache = 0;
 
     for (; history != NULL; history = history->next) {
-        totalcache += history->cachesize;
+        totalcache += history->cachesize + history->displaysize;
         if (totalcache > MAXALLOWEDCACHE) {
-            if (history->cache != NULL) {
-                free(history->cache);
-                history->cache = NULL;
-                history->cachesize = 0;
-            }
+            history_freecache(history);
         }
     }
 }
@@ -8,10 +8,18 @@
 
 #include "parseurl.h"
 
+struct loadfile_spool; /* see loadfile.h */
+
 struct historytype {
     struct url url;
+    const struct url *replica; /* redundant servers of the resource, if any */
+    int replicacount;
     long cachesize;
-    char *cache;
+    char *cache;           /* raw resource, followed by a NUL terminator */
+    struct loadfile_spool *spool; /* the spool file the cache is mapped from, rather than being a buffer of the pool (see bufpool.h), or NULL */
+    void *display;         /* display-ready form of the resource, made by the view that shows it */
+    long displaysize;      /* memory used by display */
+    void (*display_free)(void *display);
     struct historytype *next;
     int displaymemory[2];  /* used by some display plugins to remember how the item was displayed. this is always initialized to -1 values */
 };
@@ -22,6 +30,13 @@ void history_back(struct historytype **history);
 /* adds a new node to the history list. Returns 0 on success, non-zero otherwise. */
 int history_add(struct historytype **history, const struct url *new_url);
 
+/* adds a new node to the history list, for a resource that replicacount other servers serve as well. Returns 0 on
+   success, non-zero otherwise. */
+int history_add_replicas(struct historytype **history, const struct url *new_url, const struct url *replica, int replicacount);
+
+/* frees the cached content of a history node, raw and display-ready */
+void history_freecache(struct historytype *node);
+
 /* free cache content past latest maxallowedcache bytes */
 void history_cleanupcache(struct historytype *history);
 
@@ -0,0 +1,197 @@
+/*
+ * This file is part of the Gopherus project.
+ *
+ * Keeps how fast the servers recently asked were to answer, so that of the
+ * servers of a resource the fastest one is asked first, and a hedged
+ * request goes to the next one when the first is late. How long they take
+ * to connect, to answer and to go on sending also tells how long to wait
+ * for them before giving up.
+ */
+
+#include <string.h>
+#include "hoststat.h"
+
+#define MAXENTRIES 32
+#define MAXSAMPLES 16   /* recent times to first byte kept per server */
+#define MINSAMPLES 4    /* fewer than that make no percentile */
+#define FAILPENALTY 10000000l /* usec, per recent failure */
+#define MAXBACKOFF 3    /* a deadline is doubled at most that many times */
+#define DEADLINE_MAX 60000000l /* usec, however slow a server is known to be */
+#define TRANSFER_MIN 16384l    /* bytes: shorter transfers tell the round trip time rather than the throughput */
+
+/* how long to wait before giving up, in usec: when nothing is known of a
+ * server yet, and at least, so that a lost SYN (sent again after 1 s) or a
+ * few lost segments do not make a live server look dead */
+static const struct {
+    long initial;
+    long min;
+} limits[HOSTSTAT_DEADLINES] = {
+    { 3000000l, 2000000l},  /* HOSTSTAT_CONNECT */
+    {20000000l, 5000000l},  /* HOSTSTAT_ANSWER */
+    {20000000l, 5000000l}   /* HOSTSTAT_STALL */
+};
+
+/* a duration, estimated the way TCP does round trip times (RFC 6298) */
+struct estimator {
+    long srtt;     /* smoothed duration, usec */
+    long rttvar;   /* smoothed deviation from it, usec */
+    int measured;  /* 0 until a first duration is known */
+    int backoff;   /* timeouts since the last duration measured */
+};
+
+struct hoststat {
+    const char *host;     /* interned, NULL if the entry is free */
+    unsigned short port;
+    int failures;         /* recent failures, halved on every answer */
+    long srtt;            /* smoothed time to first byte, usec */
+    long sample[MAXSAMPLES];
+    int samplecount;
+    int nextsample;
+    struct estimator deadline[HOSTSTAT_DEADLINES];
+    long rate;            /* smoothed throughput, bytes per second, or 0 if unknown */
+    unsigned long lastuse;
+};
+
+static struct hoststat hoststat_table[MAXENTRIES];
+static unsigned long hoststat_clock;
+
+/* returns the entry of host:port, or NULL if none and create is 0. When
+ * created, the entry replaces the least recently used one. */
+static struct hoststat *findentry(const char *host, unsigned short port, int create)
+{
+    int i, oldest = 0;
+
+    for (i = 0; i < MAXENTRIES; i++) {
+        if ((hoststat_table[i].host == host) && (hoststat_table[i].port == port)) {
+            hoststat_table[i].lastuse = ++hoststat_clock;
+            return &hoststat_table[i];
+        }
+        if (hoststat_table[i].lastuse < hoststat_table[oldest].lastuse)
+            oldest = i;
+    }
+    if (create == 0)
+        return NULL;
+
+    memset(&hoststat_table[oldest], 0, sizeof hoststat_table[oldest]);
+    hoststat_table[oldest].host = host;
+    hoststat_table[oldest].port = port;
+    hoststat_table[oldest].lastuse = ++hoststat_clock;
+    return &hoststat_table[oldest];
+}
+
+void hoststat_answer(const char *host, unsigned short port, long usec)
+{
+    struct hoststat *e = findentry(host, port, 1);
+
+    /* the same smoothing as TCP applies to round trip times (RFC 6298) */
+    if (e->samplecount == 0) {
+        e->srtt = usec;
+    } else {
+        e->srtt += (usec - e->srtt) / 8;
+    }
+    e->sample[e->nextsample] = usec;
+    e->nextsample = (e->nextsample + 1) % MAXSAMPLES;
+    if (e->samplecount < MAXSAMPLES)
+        e->samplecount++;
+    e->failures /= 2;
+}
+
+void hoststat_failure(const char *host, unsigned short port)
+{
+    struct hoststat *e = findentry(host, port, 1);
+
+    if (e->failures < 16)
+        e->failures++;
+}
+
+long hoststat_cost(const char *host, unsigned short port)
+{
+    struct hoststat *e = findentry(host, port, 0);
+
+    if (e == NULL)
+        return 0;
+    return e->srtt + e->failures * FAILPENALTY;
+}
+
+long hoststat_percentile(const char *host, unsigned short port, int pct)
+{
+    struct hoststat *e = findentry(host, port, 0);
+    long sorted[MAXSAMPLES];
+    int i, j;
+
+    if ((e == NULL) || (e->samplecount < MINSAMPLES))
+        return -1;
+
+    /* a handful of samples: an insertion sort does */
+    for (i = 0; i < e->samplecount; i++) {
+        long v = e->sample[i];
+        for (j = i; (j > 0) && (sorted[j - 1] > v); j--)
+            sorted[j] = sorted[j - 1];
+        sorted[j] = v;
+    }
+    i = (pct * e->samplecount + 99) / 100; /* nearest rank */
+    return sorted[(i > 0) ? i - 1 : 0];
+}
+
+void hoststat_measure(const char *host, unsigned short port, int what, long usec)
+{
+    struct estimator *d = &findentry(host, port, 1)->deadline[what];
+
+    if (d->measured == 0) {
+        d->srtt = usec;
+        d->rttvar = usec / 2;
+        d->measured = 1;
+    } else {
+        long delta = (usec > d->srtt) ? usec - d->srtt : d->srtt - usec;
+        d->rttvar += (delta - d->rttvar) / 4;
+        d->srtt += (usec - d->srtt) / 8;
+    }
+    d->backoff = 0;
+}
+
+void hoststat_timeout(const char *host, unsigned short port, int what)
+{
+    struct hoststat *e = findentry(host, port, 1);
+
+    /* a server that does not even connect is likely dead: waiting longer for
+     * it each time it is asked again would only make that slower to tell */
+    if ((what != HOSTSTAT_CONNECT) && (e->deadline[what].backoff < MAXBACKOFF))
+        e->deadline[what].backoff++;
+    hoststat_failure(host, port);
+}
+
+long hoststat_deadline(const char *host, unsigned short port, int what)
+{
+    struct hoststat *e = findentry(host, port, 0);
+    long deadline = limits[what].initial;
+
+    if (e == NULL)
+        return deadline;
+    if (e->deadline[what].measured != 0)
+        deadline = e->deadline[what].srtt + 4 * e->deadline[what].rttvar;
+    if (deadline < limits[what].min)
+        deadline = limits[what].min;
+    deadline <<= e->deadline[what].backoff;
+    return (deadline > DEADLINE_MAX) ? DEADLINE_MAX : deadline;
+}
+
+void hoststat_transfer(const char *host, unsigned short port, long bytes, long usec)
+{
+    struct hoststat *e;
+    long ms = usec / 1000, rate;
+
+    if ((bytes < TRANSFER_MIN) || (ms <= 0))
+        return;
+    rate = (bytes / ms) * 1000 + ((bytes % ms) * 1000) / ms; /* bytes * 1000 / ms, that may overflow */
+    e = findentry(host, port, 1);
+    e->rate = (e->rate == 0) ? rate : e->rate + (rate - e->rate) / 8;
+}
+
+long hoststat_throughput(const char *host, unsigned short port)
+{
+    struct hoststat *e = findentry(host, port, 0);
+
+    if ((e == NULL) || (e->rate == 0))
+        return -1;
+    return e->rate;
+}
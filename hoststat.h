@@ -0,0 +1,53 @@
+/*
+ * This file is part of the Gopherus project.
+ */
+
+#ifndef HOSTSTAT_H
+#define HOSTSTAT_H
+
+/* records that the first byte of an answer of host:port came usec
+ * microseconds after the connection was started. host is interned. */
+void hoststat_answer(const char *host, unsigned short port, long usec);
+
+/* records that a request to host:port failed */
+void hoststat_failure(const char *host, unsigned short port);
+
+/* returns what asking host:port is expected to cost, to rank the servers
+ * of a resource: its smoothed time to first byte in microseconds, plus a
+ * penalty for recent failures. A server never asked yet costs nothing, so
+ * that each one gets asked once, and how fast it is gets known. */
+long hoststat_cost(const char *host, unsigned short port);
+
+/* returns the pct percentile of the recent times to first byte of
+ * host:port, in microseconds, or -1 if too few of them are known */
+long hoststat_percentile(const char *host, unsigned short port, int pct);
+
+/* what a deadline of hoststat_deadline() is for */
+#define HOSTSTAT_CONNECT 0  /* the connection getting established */
+#define HOSTSTAT_ANSWER 1   /* the first byte of the answer, once the request is sent */
+#define HOSTSTAT_STALL 2    /* more bytes of the answer, once it started coming */
+#define HOSTSTAT_DEADLINES 3
+
+/* records that what took usec microseconds with host:port. For
+ * HOSTSTAT_STALL, this is the longest silence of a complete transfer. */
+void hoststat_measure(const char *host, unsigned short port, int what, long usec);
+
+/* records that host:port was given up on past its deadline for what. This
+ * counts as a failure and, but for HOSTSTAT_CONNECT, doubles the next
+ * deadline for what, in case the server is slow rather than dead. */
+void hoststat_timeout(const char *host, unsigned short port, int what);
+
+/* returns how long to wait for what from host:port before giving up on it,
+ * in microseconds: a few deviations past how long it usually takes, the way
+ * TCP sets its retransmission timeout, or a lenient default if unknown */
+long hoststat_deadline(const char *host, unsigned short port, int what);
+
+/* records that bytes of an answer of host:port came in usec microseconds,
+ * from its first byte on */
+void hoststat_transfer(const char *host, unsigned short port, long bytes, long usec);
+
+/* returns the smoothed throughput of host:port in bytes per second, or -1
+ * if unknown */
+long hoststat_throughput(const char *host, unsigned short port);
+
+#endif
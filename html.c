@@ -0,0 +1,752 @@
+/*
+ * This file is part of the Gopherus project.
+ *
+ * Converts html into plain text in a single pass. Every byte of the source
+ * is mapped to a char class, and the (state, class) couple selects in a
+ * transition table the next state of the tokenizer along with the action to
+ * perform. Names of tags and entities are looked up in perfect hash tables,
+ * so that no name is ever compared more than once.
+ */
+
+#include <stdlib.h>    /* realloc(), free() */
+#include <string.h>    /* memchr(), memcmp(), strncmp() */
+#include "html.h"
+
+/* char classes */
+enum {
+    C_OTHER, C_SPACE, C_CTRL, C_LT, C_GT, C_AMP, C_SEMI, C_DQ, C_SQ, C_EQ,
+    C_BANG, C_DASH, C_SLASH, C_COUNT
+};
+
+/* states of the tokenizer */
+enum {
+    S_TEXT,         /* text */
+    S_TAGOPEN,      /* right after a '<' */
+    S_TAGNAME,      /* name of a tag */
+    S_ATTR,         /* within a tag, between attributes */
+    S_ATTRNAME,     /* name of an attribute */
+    S_AFTERNAME,    /* after the name of an attribute */
+    S_BEFOREVAL,    /* after the '=' of an attribute */
+    S_VALDQ,        /* "value" of an attribute */
+    S_VALSQ,        /* 'value' of an attribute */
+    S_VALUQ,        /* unquoted value of an attribute */
+    S_ENT,          /* name of an entity, after its '&' */
+    S_BANG,         /* right after "<!" */
+    S_BANGDASH,     /* right after "<!-" */
+    S_DECL,         /* <!DOCTYPE and alike */
+    S_COMMENT,      /* <!-- comment --> */
+    S_COMDASH1,     /* a '-' within a comment */
+    S_COMDASH2,     /* "--" within a comment */
+    S_RAW,          /* content of a <script> or <style> tag */
+    S_RAWLT,        /* a '<' within raw content */
+    S_COUNT
+};
+
+/* actions performed on transitions */
+enum {
+    A_NONE,
+    A_EMIT,         /* output the char */
+    A_SPACE,        /* output a single space for a sequence of whitespaces */
+    A_LTREDO,       /* output the '<' that did not open a tag, then process the char as text */
+    A_TAGOPEN,      /* start a tag */
+    A_TAGSTART,     /* start the name of the tag with the char if a letter, or else do as A_LTREDO */
+    A_TAGCH,        /* add the char to the name of the tag */
+    A_CLOSETAG,     /* start a closing tag within raw content */
+    A_TAGEND,       /* the tag is complete */
+    A_NAMESTART,    /* start the name of an attribute with the char */
+    A_NAMECH,       /* add the char to the name of the attribute */
+    A_VALSTART,     /* the value of an attribute starts at the char */
+    A_VALSTARTQ,    /* the value of an attribute starts right after the char */
+    A_VALEND,       /* the value of an attribute is complete */
+    A_VALENDTAG,    /* both the value of an attribute and the tag are complete */
+    A_ENTSTART,     /* start an entity */
+    A_ENTCH,        /* add the char to the name of the entity */
+    A_ENTEND,       /* the entity is complete */
+    A_ENTFAIL       /* not an entity: output it as is, then process the char as text */
+};
+
+struct transition {
+    unsigned char next;
+    unsigned char action;
+};
+
+/* states that only a single char can leave, along with that char: such
+ * states skip straight to it */
+static const char exitchar[S_COUNT] = {
+    0, 0, 0, 0, 0, 0, 0, '"', '\'', 0, 0, 0, 0, '>', '-', 0, 0, '<', 0
+};
+
+static const unsigned char charclass[256] = {
+    C_CTRL, C_CTRL, C_CTRL, C_CTRL, C_CTRL, C_CTRL, C_CTRL, C_CTRL,
+    C_CTRL, C_SPACE, C_SPACE, C_CTRL, C_CTRL, C_SPACE, C_CTRL, C_CTRL,
+    C_CTRL, C_CTRL, C_CTRL, C_CTRL, C_CTRL, C_CTRL, C_CTRL, C_CTRL,
+    C_CTRL, C_CTRL, C_CTRL, C_CTRL, C_CTRL, C_CTRL, C_CTRL, C_CTRL,
+    C_SPACE, C_BANG, C_DQ, C_OTHER, C_OTHER, C_OTHER, C_AMP, C_SQ,
+    C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_DASH, C_OTHER, C_SLASH,
+    C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER,
+    C_OTHER, C_OTHER, C_OTHER, C_SEMI, C_LT, C_EQ, C_GT, C_OTHER,
+    C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER,
+    C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER,
+    C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER,
+    C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER,
+    C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER,
+    C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER,
+    C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER,
+    C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_CTRL,
+    C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER,
+    C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER,
+    C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER,
+    C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER,
+    C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER,
+    C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER,
+    C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER,
+    C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER,
+    C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER,
+    C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER,
+    C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER,
+    C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER,
+    C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER,
+    C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER,
+    C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER,
+    C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER, C_OTHER
+};
+
+/* transitions of the tokenizer, indexed by state and char class:
+ *  OTHER SPACE CTRL LT GT AMP SEMI DQ SQ EQ BANG DASH SLASH */
+static const struct transition trans[S_COUNT][C_COUNT] = {
+    { /* S_TEXT */
+        {S_TEXT, A_EMIT}, {S_TEXT, A_SPACE}, {S_TEXT, A_NONE}, {S_TAGOPEN, A_TAGOPEN},
+        {S_TEXT, A_EMIT}, {S_ENT, A_ENTSTART}, {S_TEXT, A_EMIT}, {S_TEXT, A_EMIT},
+        {S_TEXT, A_EMIT}, {S_TEXT, A_EMIT}, {S_TEXT, A_EMIT}, {S_TEXT, A_EMIT},
+        {S_TEXT, A_EMIT}
+    },
+    { /* S_TAGOPEN */
+        {S_TAGNAME, A_TAGSTART}, {S_TEXT, A_LTREDO}, {S_TEXT, A_LTREDO}, {S_TEXT, A_LTREDO},
+        {S_TEXT, A_LTREDO}, {S_TEXT, A_LTREDO}, {S_TEXT, A_LTREDO}, {S_TEXT, A_LTREDO},
+        {S_TEXT, A_LTREDO}, {S_TEXT, A_LTREDO}, {S_BANG, A_NONE}, {S_TEXT, A_LTREDO},
+        {S_TAGNAME, A_TAGCH}
+    },
+    { /* S_TAGNAME */
+        {S_TAGNAME, A_TAGCH}, {S_ATTR, A_NONE}, {S_ATTR, A_NONE}, {S_TAGNAME, A_NONE},
+        {S_TEXT, A_TAGEND}, {S_TAGNAME, A_TAGCH}, {S_TAGNAME, A_TAGCH}, {S_ATTR, A_NONE},
+        {S_ATTR, A_NONE}, {S_ATTR, A_NONE}, {S_TAGNAME, A_TAGCH}, {S_TAGNAME, A_TAGCH},
+        {S_TAGNAME, A_TAGCH}
+    },
+    { /* S_ATTR */
+        {S_ATTRNAME, A_NAMESTART}, {S_ATTR, A_NONE}, {S_ATTR, A_NONE}, {S_ATTR, A_NONE},
+        {S_TEXT, A_TAGEND}, {S_ATTRNAME, A_NAMESTART}, {S_ATTRNAME, A_NAMESTART}, {S_ATTR, A_NONE},
+        {S_ATTR, A_NONE}, {S_ATTR, A_NONE}, {S_ATTRNAME, A_NAMESTART}, {S_ATTRNAME, A_NAMESTART},
+        {S_ATTR, A_NONE}
+    },
+    { /* S_ATTRNAME */
+        {S_ATTRNAME, A_NAMECH}, {S_AFTERNAME, A_NONE}, {S_AFTERNAME, A_NONE}, {S_ATTRNAME, A_NAMECH},
+        {S_TEXT, A_TAGEND}, {S_ATTRNAME, A_NAMECH}, {S_ATTRNAME, A_NAMECH}, {S_ATTRNAME, A_NAMECH},
+        {S_ATTRNAME, A_NAMECH}, {S_BEFOREVAL, A_NONE}, {S_ATTRNAME, A_NAMECH}, {S_ATTRNAME, A_NAMECH},
+        {S_ATTR, A_NONE}
+    },
+    { /* S_AFTERNAME */
+        {S_ATTRNAME, A_NAMESTART}, {S_AFTERNAME, A_NONE}, {S_AFTERNAME, A_NONE}, {S_ATTRNAME, A_NAMESTART},
+        {S_TEXT, A_TAGEND}, {S_ATTRNAME, A_NAMESTART}, {S_ATTRNAME, A_NAMESTART}, {S_ATTRNAME, A_NAMESTART},
+        {S_ATTRNAME, A_NAMESTART}, {S_BEFOREVAL, A_NONE}, {S_ATTRNAME, A_NAMESTART}, {S_ATTRNAME, A_NAMESTART},
+        {S_ATTR, A_NONE}
+    },
+    { /* S_BEFOREVAL */
+        {S_VALUQ, A_VALSTART}, {S_BEFOREVAL, A_NONE}, {S_BEFOREVAL, A_NONE}, {S_VALUQ, A_VALSTART},
+        {S_TEXT, A_TAGEND}, {S_VALUQ, A_VALSTART}, {S_VALUQ, A_VALSTART}, {S_VALDQ, A_VALSTARTQ},
+        {S_VALSQ, A_VALSTARTQ}, {S_VALUQ, A_VALSTART}, {S_VALUQ, A_VALSTART}, {S_VALUQ, A_VALSTART},
+        {S_VALUQ, A_VALSTART}
+    },
+    { /* S_VALDQ */
+        {S_VALDQ, A_NONE}, {S_VALDQ, A_NONE}, {S_VALDQ, A_NONE}, {S_VALDQ, A_NONE},
+        {S_VALDQ, A_NONE}, {S_VALDQ, A_NONE}, {S_VALDQ, A_NONE}, {S_ATTR, A_VALEND},
+        {S_VALDQ, A_NONE}, {S_VALDQ, A_NONE}, {S_VALDQ, A_NONE}, {S_VALDQ, A_NONE},
+        {S_VALDQ, A_NONE}
+    },
+    { /* S_VALSQ */
+        {S_VALSQ, A_NONE}, {S_VALSQ, A_NONE}, {S_VALSQ, A_NONE}, {S_VALSQ, A_NONE},
+        {S_VALSQ, A_NONE}, {S_VALSQ, A_NONE}, {S_VALSQ, A_NONE}, {S_VALSQ, A_NONE},
+        {S_ATTR, A_VALEND}, {S_VALSQ, A_NONE}, {S_VALSQ, A_NONE}, {S_VALSQ, A_NONE},
+        {S_VALSQ, A_NONE}
+    },
+    { /* S_VALUQ */
+        {S_VALUQ, A_NONE}, {S_ATTR, A_VALEND}, {S_ATTR, A_VALEND}, {S_VALUQ, A_NONE},
+        {S_TEXT, A_VALENDTAG}, {S_VALUQ, A_NONE}, {S_VALUQ, A_NONE}, {S_VALUQ, A_NONE},
+        {S_VALUQ, A_NONE}, {S_VALUQ, A_NONE}, {S_VALUQ, A_NONE}, {S_VALUQ, A_NONE},
+        {S_VALUQ, A_NONE}
+    },
+    { /* S_ENT */
+        {S_ENT, A_ENTCH}, {S_TEXT, A_ENTFAIL}, {S_TEXT, A_ENTFAIL}, {S_TEXT, A_ENTFAIL},
+        {S_TEXT, A_ENTFAIL}, {S_TEXT, A_ENTFAIL}, {S_TEXT, A_ENTEND}, {S_TEXT, A_ENTFAIL},
+        {S_TEXT, A_ENTFAIL}, {S_TEXT, A_ENTFAIL}, {S_TEXT, A_ENTFAIL}, {S_TEXT, A_ENTFAIL},
+        {S_TEXT, A_ENTFAIL}
+    },
+    { /* S_BANG */
+        {S_DECL, A_NONE}, {S_DECL, A_NONE}, {S_DECL, A_NONE}, {S_DECL, A_NONE},
+        {S_TEXT, A_NONE}, {S_DECL, A_NONE}, {S_DECL, A_NONE}, {S_DECL, A_NONE},
+        {S_DECL, A_NONE}, {S_DECL, A_NONE}, {S_DECL, A_NONE}, {S_BANGDASH, A_NONE},
+        {S_DECL, A_NONE}
+    },
+    { /* S_BANGDASH */
+        {S_DECL, A_NONE}, {S_DECL, A_NONE}, {S_DECL, A_NONE}, {S_DECL, A_NONE},
+        {S_TEXT, A_NONE}, {S_DECL, A_NONE}, {S_DECL, A_NONE}, {S_DECL, A_NONE},
+        {S_DECL, A_NONE}, {S_DECL, A_NONE}, {S_DECL, A_NONE}, {S_COMMENT, A_NONE},
+        {S_DECL, A_NONE}
+    },
+    { /* S_DECL */
+        {S_DECL, A_NONE}, {S_DECL, A_NONE}, {S_DECL, A_NONE}, {S_DECL, A_NONE},
+        {S_TEXT, A_NONE}, {S_DECL, A_NONE}, {S_DECL, A_NONE}, {S_DECL, A_NONE},
+        {S_DECL, A_NONE}, {S_DECL, A_NONE}, {S_DECL, A_NONE}, {S_DECL, A_NONE},
+        {S_DECL, A_NONE}
+    },
+    { /* S_COMMENT */
+        {S_COMMENT, A_NONE}, {S_COMMENT, A_NONE}, {S_COMMENT, A_NONE}, {S_COMMENT, A_NONE},
+        {S_COMMENT, A_NONE}, {S_COMMENT, A_NONE}, {S_COMMENT, A_NONE}, {S_COMMENT, A_NONE},
+        {S_COMMENT, A_NONE}, {S_COMMENT, A_NONE}, {S_COMMENT, A_NONE}, {S_COMDASH1, A_NONE},
+        {S_COMMENT, A_NONE}
+    },
+    { /* S_COMDASH1 */
+        {S_COMMENT, A_NONE}, {S_COMMENT, A_NONE}, {S_COMMENT, A_NONE}, {S_COMMENT, A_NONE},
+        {S_COMMENT, A_NONE}, {S_COMMENT, A_NONE}, {S_COMMENT, A_NONE}, {S_COMMENT, A_NONE},
+        {S_COMMENT, A_NONE}, {S_COMMENT, A_NONE}, {S_COMMENT, A_NONE}, {S_COMDASH2, A_NONE},
+        {S_COMMENT, A_NONE}
+    },
+    { /* S_COMDASH2 */
+        {S_COMMENT, A_NONE}, {S_COMMENT, A_NONE}, {S_COMMENT, A_NONE}, {S_COMMENT, A_NONE},
+        {S_TEXT, A_NONE}, {S_COMMENT, A_NONE}, {S_COMMENT, A_NONE}, {S_COMMENT, A_NONE},
+        {S_COMMENT, A_NONE}, {S_COMMENT, A_NONE}, {S_COMMENT, A_NONE}, {S_COMDASH2, A_NONE},
+        {S_COMMENT, A_NONE}
+    },
+    { /* S_RAW */
+        {S_RAW, A_NONE}, {S_RAW, A_NONE}, {S_RAW, A_NONE}, {S_RAWLT, A_NONE},
+        {S_RAW, A_NONE}, {S_RAW, A_NONE}, {S_RAW, A_NONE}, {S_RAW, A_NONE},
+        {S_RAW, A_NONE}, {S_RAW, A_NONE}, {S_RAW, A_NONE}, {S_RAW, A_NONE},
+        {S_RAW, A_NONE}
+    },
+    { /* S_RAWLT */
+        {S_RAW, A_NONE}, {S_RAW, A_NONE}, {S_RAW, A_NONE}, {S_RAWLT, A_NONE},
+        {S_RAW, A_NONE}, {S_RAW, A_NONE}, {S_RAW, A_NONE}, {S_RAW, A_NONE},
+        {S_RAW, A_NONE}, {S_RAW, A_NONE}, {S_RAW, A_NONE}, {S_RAW, A_NONE},
+        {S_TAGNAME, A_CLOSETAG}
+    }
+};
+
+/* Perfect hash tables. A name first selects a bucket with hash(name, 0),
+ * then the displacement of the bucket selects a slot with
+ * hash(name, displacement). Displacements have been searched so that no two
+ * names share a slot. Slots hold the index of their name, or 255 if empty. */
+
+#define TAG_BLOCK   1   /* starts and ends on a line of its own */
+#define TAG_BREAK   2   /* line break */
+#define TAG_SPACE   4   /* separated from what follows by a space */
+#define TAG_SKIP    8   /* content is not displayed */
+#define TAG_LINK   16   /* <a href> */
+#define TAG_PRE    32   /* whitespaces are kept as they are */
+
+static const struct {
+    const char *name;
+    int flags;
+} tags[] = {
+    {"a", TAG_LINK},
+    {"address", TAG_BLOCK},
+    {"article", TAG_BLOCK},
+    {"blockquote", TAG_BLOCK},
+    {"br", TAG_BREAK},
+    {"center", TAG_BLOCK},
+    {"dd", TAG_BLOCK},
+    {"div", TAG_BLOCK},
+    {"dl", TAG_BLOCK},
+    {"dt", TAG_BLOCK},
+    {"footer", TAG_BLOCK},
+    {"form", TAG_BLOCK},
+    {"h1", TAG_BLOCK},
+    {"h2", TAG_BLOCK},
+    {"h3", TAG_BLOCK},
+    {"h4", TAG_BLOCK},
+    {"h5", TAG_BLOCK},
+    {"h6", TAG_BLOCK},
+    {"header", TAG_BLOCK},
+    {"hr", TAG_BLOCK},
+    {"li", TAG_BLOCK},
+    {"nav", TAG_BLOCK},
+    {"ol", TAG_BLOCK},
+    {"p", TAG_BLOCK},
+    {"pre", TAG_BLOCK | TAG_PRE},
+    {"script", TAG_SKIP},
+    {"section", TAG_BLOCK},
+    {"style", TAG_SKIP},
+    {"table", TAG_BLOCK},
+    {"td", TAG_SPACE},
+    {"th", TAG_SPACE},
+    {"title", TAG_BLOCK},
+    {"tr", TAG_BLOCK},
+    {"ul", TAG_BLOCK}
+};
+
+static const unsigned short tagdisp[] = {
+    2, 3, 1, 1, 1, 2, 1, 1, 1, 1, 1, 2, 2, 2, 0, 2
+};
+
+static const unsigned char tagslots[] = {
+    255, 7, 255, 24, 17, 255, 255, 255, 255, 5, 255, 255, 14, 1, 19, 9,
+    8, 33, 255, 255, 255, 255, 11, 255, 4, 255, 20, 255, 29, 0, 255, 255,
+    255, 3, 6, 255, 10, 16, 25, 12, 30, 255, 27, 13, 255, 255, 26, 21,
+    255, 15, 22, 18, 31, 2, 255, 255, 32, 255, 28, 255, 255, 23, 255, 255
+};
+
+static const char *entnames[] = {
+    "AElig", "Aacute", "Acirc", "Agrave", "Alpha", "Aring", "Atilde", "Auml",
+    "Beta", "Ccedil", "Chi", "Dagger", "Delta", "ETH", "Eacute", "Ecirc",
+    "Egrave", "Epsilon", "Eta", "Euml", "Gamma", "Iacute", "Icirc", "Igrave",
+    "Iota", "Iuml", "Kappa", "Lambda", "Mu", "Ntilde", "Nu", "OElig",
+    "Oacute", "Ocirc", "Ograve", "Omega", "Omicron", "Oslash", "Otilde", "Ouml",
+    "Phi", "Pi", "Prime", "Psi", "Rho", "Scaron", "Sigma", "THORN",
+    "Tau", "Theta", "Uacute", "Ucirc", "Ugrave", "Upsilon", "Uuml", "Xi",
+    "Yacute", "Yuml", "Zeta", "aacute", "acirc", "acute", "aelig", "agrave",
+    "alefsym", "alpha", "amp", "and", "ang", "apos", "aring", "asymp",
+    "atilde", "auml", "bdquo", "beta", "brvbar", "bull", "cap", "ccedil",
+    "cedil", "cent", "chi", "circ", "clubs", "cong", "copy", "crarr",
+    "cup", "curren", "dArr", "dagger", "darr", "deg", "delta", "diams",
+    "divide", "eacute", "ecirc", "egrave", "empty", "emsp", "ensp", "epsilon",
+    "equiv", "eta", "eth", "euml", "euro", "exist", "fnof", "forall",
+    "frac12", "frac14", "frac34", "frasl", "gamma", "ge", "gt", "hArr",
+    "harr", "hearts", "hellip", "iacute", "icirc", "iexcl", "igrave", "image",
+    "infin", "int", "iota", "iquest", "isin", "iuml", "kappa", "lArr",
+    "lambda", "lang", "laquo", "larr", "lceil", "ldquo", "le", "lfloor",
+    "lowast", "loz", "lrm", "lsaquo", "lsquo", "lt", "macr", "mdash",
+    "micro", "middot", "minus", "mu", "nabla", "nbsp", "ndash", "ne",
+    "ni", "not", "notin", "nsub", "ntilde", "nu", "oacute", "ocirc",
+    "oelig", "ograve", "oline", "omega", "omicron", "oplus", "or", "ordf",
+    "ordm", "oslash", "otilde", "otimes", "ouml", "para", "part", "permil",
+    "perp", "phi", "pi", "piv", "plusmn", "pound", "prime", "prod",
+    "prop", "psi", "quot", "rArr", "radic", "rang", "raquo", "rarr",
+    "rceil", "rdquo", "real", "reg", "rfloor", "rho", "rlm", "rsaquo",
+    "rsquo", "sbquo", "scaron", "sdot", "sect", "shy", "sigma", "sigmaf",
+    "sim", "spades", "sub", "sube", "sum", "sup", "sup1", "sup2",
+    "sup3", "supe", "szlig", "tau", "there4", "theta", "thetasym", "thinsp",
+    "thorn", "tilde", "times", "trade", "uArr", "uacute", "uarr", "ucirc",
+    "ugrave", "uml", "upsih", "upsilon", "uuml", "weierp", "xi", "yacute",
+    "yen", "yuml", "zeta", "zwj", "zwnj"
+};
+
+static const unsigned short entcodes[] = {
+    198, 193, 194, 192, 913, 197, 195, 196, 914, 199,
+    935, 8225, 916, 208, 201, 202, 200, 917, 919, 203,
+    915, 205, 206, 204, 921, 207, 922, 923, 924, 209,
+    925, 338, 211, 212, 210, 937, 927, 216, 213, 214,
+    934, 928, 8243, 936, 929, 352, 931, 222, 932, 920,
+    218, 219, 217, 933, 220, 926, 221, 376, 918, 225,
+    226, 180, 230, 224, 8501, 945, 38, 8743, 8736, 39,
+    229, 8776, 227, 228, 8222, 946, 166, 8226, 8745, 231,
+    184, 162, 967, 710, 9827, 8773, 169, 8629, 8746, 164,
+    8659, 8224, 8595, 176, 948, 9830, 247, 233, 234, 232,
+    8709, 8195, 8194, 949, 8801, 951, 240, 235, 8364, 8707,
+    402, 8704, 189, 188, 190, 8260, 947, 8805, 62, 8660,
+    8596, 9829, 8230, 237, 238, 161, 236, 8465, 8734, 8747,
+    953, 191, 8712, 239, 954, 8656, 955, 9001, 171, 8592,
+    8968, 8220, 8804, 8970, 8727, 9674, 8206, 8249, 8216, 60,
+    175, 8212, 181, 183, 8722, 956, 8711, 160, 8211, 8800,
+    8715, 172, 8713, 8836, 241, 957, 243, 244, 339, 242,
+    8254, 969, 959, 8853, 8744, 170, 186, 248, 245, 8855,
+    246, 182, 8706, 8240, 8869, 966, 960, 982, 177, 163,
+    8242, 8719, 8733, 968, 34, 8658, 8730, 9002, 187, 8594,
+    8969, 8221, 8476, 174, 8971, 961, 8207, 8250, 8217, 8218,
+    353, 8901, 167, 173, 963, 962, 8764, 9824, 8834, 8838,
+    8721, 8835, 185, 178, 179, 8839, 223, 964, 8756, 952,
+    977, 8201, 254, 732, 215, 8482, 8657, 250, 8593, 251,
+    249, 168, 978, 965, 252, 8472, 958, 253, 165, 255,
+    950, 8205, 8204
+};
+
+static const unsigned short entdisp[] = {
+    2, 4, 1, 1, 9, 1, 2, 1, 3, 1, 6, 2, 1, 1, 5, 1,
+    1, 3, 1, 2, 9, 4, 2, 2, 8, 9, 1, 1, 3, 11, 2, 2,
+    8, 4, 2, 1, 7, 1, 1, 2, 7, 1, 1, 1, 16, 2, 3, 10,
+    2, 28, 3, 7, 4, 1, 2, 5, 1, 2, 12, 1, 1, 1, 1, 5
+};
+
+static const unsigned char entslots[] = {
+    15, 255, 255, 136, 172, 255, 255, 255, 255, 255, 88, 184, 255, 255, 203, 255,
+    243, 255, 186, 255, 160, 255, 233, 255, 255, 251, 255, 61, 255, 145, 255, 255,
+    255, 195, 255, 49, 255, 255, 58, 84, 255, 255, 140, 255, 54, 255, 255, 153,
+    255, 255, 255, 255, 132, 26, 255, 255, 39, 187, 255, 159, 255, 255, 152, 93,
+    255, 120, 158, 255, 43, 167, 228, 118, 255, 240, 11, 255, 255, 255, 255, 255,
+    255, 150, 255, 255, 252, 21, 255, 255, 161, 127, 255, 255, 255, 242, 197, 255,
+    35, 114, 89, 53, 224, 177, 71, 169, 255, 255, 255, 255, 86, 255, 255, 217,
+    255, 238, 255, 255, 255, 255, 255, 255, 12, 255, 255, 106, 180, 205, 255, 149,
+    247, 17, 222, 73, 68, 72, 123, 255, 255, 255, 189, 7, 221, 255, 59, 255,
+    255, 255, 255, 9, 70, 255, 80, 139, 255, 255, 255, 178, 255, 255, 209, 29,
+    255, 255, 234, 215, 232, 42, 16, 250, 255, 83, 255, 30, 255, 255, 255, 255,
+    255, 105, 255, 255, 223, 255, 255, 255, 255, 75, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 98, 144, 255, 255, 255, 90, 246, 255, 255, 255,
+    14, 170, 255, 200, 255, 255, 244, 255, 255, 67, 255, 255, 255, 147, 255, 77,
+    255, 226, 237, 151, 56, 34, 146, 255, 107, 97, 138, 122, 175, 255, 216, 255,
+    255, 255, 231, 99, 255, 198, 255, 113, 229, 255, 143, 219, 63, 6, 36, 255,
+    108, 255, 255, 255, 181, 255, 255, 255, 121, 255, 33, 249, 47, 48, 185, 255,
+    255, 255, 3, 255, 255, 255, 255, 110, 32, 211, 255, 85, 94, 255, 255, 255,
+    255, 13, 212, 255, 111, 255, 255, 199, 103, 255, 236, 66, 255, 255, 255, 255,
+    255, 5, 255, 2, 255, 255, 255, 125, 133, 230, 31, 255, 255, 255, 255, 137,
+    239, 255, 194, 176, 100, 255, 255, 109, 51, 188, 104, 255, 40, 255, 62, 201,
+    255, 142, 55, 174, 95, 255, 255, 255, 131, 255, 255, 45, 124, 255, 255, 148,
+    255, 255, 18, 50, 248, 190, 255, 255, 155, 255, 255, 255, 227, 102, 116, 218,
+    166, 255, 4, 255, 156, 154, 44, 8, 255, 255, 173, 112, 76, 255, 196, 255,
+    79, 168, 255, 255, 101, 255, 255, 37, 255, 255, 206, 115, 0, 255, 23, 255,
+    255, 1, 255, 255, 78, 134, 255, 255, 255, 22, 255, 183, 241, 255, 255, 193,
+    255, 213, 255, 255, 19, 162, 141, 117, 255, 38, 255, 171, 255, 165, 255, 255,
+    126, 255, 92, 64, 128, 24, 10, 129, 130, 255, 87, 207, 255, 202, 255, 164,
+    255, 255, 255, 255, 60, 255, 255, 204, 255, 182, 157, 210, 57, 255, 82, 255,
+    255, 25, 255, 191, 255, 69, 255, 255, 255, 255, 20, 208, 255, 255, 255, 255,
+    52, 179, 96, 81, 46, 225, 74, 220, 41, 255, 255, 27, 245, 255, 214, 255,
+    119, 255, 135, 255, 163, 91, 255, 235, 255, 255, 192, 255, 255, 28, 255, 65
+};
+
+static unsigned long hash(const char *s, int len, unsigned long seed)
+{
+    unsigned long h = (2166136261ul ^ (seed * 0x9E3779B1ul)) & 0xFFFFFFFFul;
+    int i;
+
+    for (i = 0; i < len; i++) { /* FNV-1a */
+        h ^= (unsigned char)s[i];
+        h = (h * 16777619ul) & 0xFFFFFFFFul;
+    }
+    h ^= h >> 16; /* mix the high bits into the low ones */
+    h = (h * 0x45D9F3Bul) & 0xFFFFFFFFul;
+    h ^= h >> 16;
+    return h;
+}
+
+/* returns the index of the only name that may match, or -1 */
+static int phash_lookup(const char *name, int len, const unsigned short *disp, int buckets,
+                        const unsigned char *slots, int slotcount)
+{
+    int i = slots[hash(name, len, disp[hash(name, len, 0) % buckets]) % slotcount];
+    return (i == 255) ? -1 : i;
+}
+
+/* compares a NUL-terminated candidate with the len chars of name */
+static int samename(const char *candidate, const char *name, int len)
+{
+    return (strncmp(candidate, name, len) == 0) && (candidate[len] == 0);
+}
+
+static int tagflags(const char *name, int len)
+{
+    int i = phash_lookup(name, len, tagdisp, sizeof tagdisp / sizeof tagdisp[0], tagslots, sizeof tagslots);
+    return ((i >= 0) && samename(tags[i].name, name, len)) ? tags[i].flags : 0;
+}
+
+/* returns the code point an entity stands for (without its '&' and ';'),
+ * or -1 if unknown */
+static long entity(const char *name, int len)
+{
+    long cp = 0;
+    int i;
+
+    if ((len > 1) && (name[0] == '#')) { /* &#65; or &#x41; */
+        int hex = ((name[1] == 'x') || (name[1] == 'X'));
+        if (len == 1 + hex)
+            return -1;
+        for (i = 1 + hex; i < len; i++) {
+            int digit;
+            if ((name[i] >= '0') && (name[i] <= '9')) {
+                digit = name[i] - '0';
+            } else if (hex && (name[i] >= 'a') && (name[i] <= 'f')) {
+                digit = name[i] - 'a' + 10;
+            } else if (hex && (name[i] >= 'A') && (name[i] <= 'F')) {
+                digit = name[i] - 'A' + 10;
+            } else {
+                return -1;
+            }
+            cp = cp * (hex ? 16 : 10) + digit;
+            if (cp > 0x10FFFFl)
+                return -1;
+        }
+        if ((cp == 0) || ((cp >= 0xD800l) && (cp <= 0xDFFFl))) /* not a character */
+            return -1;
+        return cp;
+    }
+
+    i = phash_lookup(name, len, entdisp, sizeof entdisp / sizeof entdisp[0], entslots, sizeof entslots);
+    return ((i >= 0) && samename(entnames[i], name, len)) ? entcodes[i] : -1;
+}
+
+/* writes a code point to dst, encoded in UTF-8, and returns its length */
+static int putcp(char *dst, long cp)
+{
+    if ((cp < 32) || ((cp >= 127) && (cp < 160)) || (cp == 0xA0)) { /* controls and nbsp */
+        dst[0] = ' ';
+        return 1;
+    }
+    if (cp < 0x80) {
+        dst[0] = cp;
+        return 1;
+    }
+    if (cp < 0x800) {
+        dst[0] = 0xC0 | (cp >> 6);
+        dst[1] = 0x80 | (cp & 0x3F);
+        return 2;
+    }
+    if (cp < 0x10000l) {
+        dst[0] = 0xE0 | (cp >> 12);
+        dst[1] = 0x80 | ((cp >> 6) & 0x3F);
+        dst[2] = 0x80 | (cp & 0x3F);
+        return 3;
+    }
+    dst[0] = 0xF0 | (cp >> 18);
+    dst[1] = 0x80 | ((cp >> 12) & 0x3F);
+    dst[2] = 0x80 | ((cp >> 6) & 0x3F);
+    dst[3] = 0x80 | (cp & 0x3F);
+    return 4;
+}
+
+static void addlink(struct htmllinks *links, long start, long end, long href, long hreflen)
+{
+    struct htmllink *link;
+
+    if (end <= start) /* nothing to select, like an image without alt text */
+        return;
+    if (links->count == links->size) {
+        long newsize = (links->size > 0) ? links->size * 2 : 64;
+        struct htmllink *newlink = realloc(links->link, newsize * sizeof *newlink);
+        if (newlink == NULL)
+            return; /* the document stays readable, only this link is lost */
+        links->link = newlink;
+        links->size = newsize;
+    }
+    link = &links->link[links->count++];
+    link->start = start;
+    link->end = end;
+    link->href = href;
+    link->hreflen = hreflen;
+}
+
+long process_html(char *dst, const char *src, long slen, struct htmllinks *links)
+{
+    char tag[16], attr[8], ent[12];
+    int taglen = 0, attrlen = 0, entlen = 0;
+    int state = S_TEXT;
+    int skipping = 0, pre = 0;
+    long href = -1, hreflen = 0, valstart = 0;
+    long linkstart = -1, linkhref = 0, linkhreflen = 0;
+    long dlen = 0;
+    long x = 0;
+
+    if (links != NULL) {
+        links->link = NULL;
+        links->count = 0;
+        links->size = 0;
+    }
+
+    /* Every action writes at most as many bytes as it has consumed, which
+     * keeps the output within slen bytes. */
+    while (x < slen) {
+        unsigned char c;
+        const struct transition *t;
+
+        if (exitchar[state] != 0) {
+            const char *p = memchr(src + x, exitchar[state], slen - x);
+            if (p == NULL)
+                break;
+            x = p - src;
+        }
+
+        c = src[x];
+        t = &trans[state][charclass[c]];
+
+        state = t->next;
+        switch (t->action) {
+            case A_EMIT:
+                dst[dlen++] = c;
+                /* go through the rest of the run of words at once */
+                for (x++; x < slen; x++) {
+                    int cls = charclass[(unsigned char)src[x]];
+                    if (cls == C_OTHER) {
+                        dst[dlen++] = src[x];
+                    } else if ((cls == C_SPACE) && !pre) {
+                        if (dst[dlen - 1] != ' ')
+                            dst[dlen++] = ' ';
+                    } else {
+                        break;
+                    }
+                }
+                continue;
+            case A_SPACE:
+                if (pre) {
+                    if (c != '\r')
+                        dst[dlen++] = c;
+                } else if ((dlen > 0) && (dst[dlen - 1] != ' ') && (dst[dlen - 1] != '\n')) {
+                    dst[dlen++] = ' ';
+                }
+                break;
+            case A_LTREDO:
+                dst[dlen++] = '<';
+                continue; /* process the char again, as text */
+            case A_TAGOPEN:
+                taglen = 0;
+                href = -1;
+                break;
+            case A_CLOSETAG:
+                tag[0] = '/';
+                taglen = 1;
+                href = -1;
+                break;
+            case A_TAGSTART:
+                if (!(((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z')))) { /* "a <3 b" */
+                    state = S_TEXT;
+                    dst[dlen++] = '<';
+                    continue; /* process the char again, as text */
+                }
+                /* FALLTHRU */
+            case A_TAGCH:
+                if (taglen < (int)sizeof tag) /* too long names match nothing */
+                    tag[taglen++] = ((c >= 'A') && (c <= 'Z')) ? c + ('a' - 'A') : c;
+                break;
+            case A_NAMESTART:
+                attrlen = 0;
+                /* FALLTHRU */
+            case A_NAMECH:
+                if (attrlen < (int)sizeof attr)
+                    attr[attrlen++] = ((c >= 'A') && (c <= 'Z')) ? c + ('a' - 'A') : c;
+                break;
+            case A_VALSTART:
+                valstart = x;
+                break;
+            case A_VALSTARTQ:
+                valstart = x + 1;
+                break;
+            case A_VALEND:
+            case A_VALENDTAG:
+                if ((attrlen == 4) && (memcmp(attr, "href", 4) == 0)) {
+                    href = valstart;
+                    hreflen = x - valstart;
+                }
+                if (t->action == A_VALEND)
+                    break;
+                /* FALLTHRU */
+            case A_TAGEND:
+            {
+                int closing = ((taglen > 0) && (tag[0] == '/'));
+                int len = taglen - closing;
+                int flags;
+
+                if ((len > 0) && (tag[closing + len - 1] == '/')) /* <br/> */
+                    len--;
+                flags = (taglen < (int)sizeof tag) ? tagflags(tag + closing, len) : 0;
+
+                if (skipping) {
+                    if (closing && (flags & TAG_SKIP))
+                        skipping = 0;
+                } else if (flags & TAG_SKIP) {
+                    skipping = !closing;
+                } else if (flags & TAG_BREAK) {
+                    dst[dlen++] = '\n';
+                } else if (flags & TAG_BLOCK) {
+                    if ((dlen > 0) && (dst[dlen - 1] != '\n'))
+                        dst[dlen++] = '\n';
+                    if (flags & TAG_PRE)
+                        pre = !closing;
+                } else if (flags & TAG_SPACE) {
+                    if ((dlen > 0) && (dst[dlen - 1] != ' ') && (dst[dlen - 1] != '\n'))
+                        dst[dlen++] = ' ';
+                } else if ((flags & TAG_LINK) && (links != NULL)) {
+                    if (linkstart >= 0) /* also closes links left open */
+                        addlink(links, linkstart, dlen, linkhref, linkhreflen);
+                    linkstart = -1;
+                    if (!closing && (href >= 0)) {
+                        linkstart = dlen;
+                        linkhref = href;
+                        linkhreflen = hreflen;
+                    }
+                }
+                state = skipping ? S_RAW : S_TEXT;
+                break;
+            }
+            case A_ENTSTART:
+                entlen = 0;
+                break;
+            case A_ENTCH:
+                while ((entlen < (int)sizeof ent) && (x < slen) && (charclass[(unsigned char)src[x]] == C_OTHER))
+                    ent[entlen++] = src[x++];
+                if ((entlen < (int)sizeof ent) || (x == slen))
+                    continue; /* the char after the name tells what it is */
+                /* too long to be an entity */
+                state = S_TEXT;
+                /* FALLTHRU */
+            case A_ENTFAIL:
+                dst[dlen++] = '&';
+                memcpy(dst + dlen, ent, entlen);
+                dlen += entlen;
+                continue; /* process the char again, as text */
+            case A_ENTEND:
+            {
+                long cp = entity(ent, entlen);
+                if (cp >= 0) {
+                    dlen += putcp(dst + dlen, cp); /* at most 4 bytes, never more than "&xx;" */
+                } else {
+                    dst[dlen++] = '&';
+                    memcpy(dst + dlen, ent, entlen);
+                    dlen += entlen;
+                    dst[dlen++] = ';';
+                }
+                break;
+            }
+        }
+        x++;
+    }
+
+    if (state == S_ENT) { /* an unterminated '&' at the very end */
+        dst[dlen++] = '&';
+        memcpy(dst + dlen, ent, entlen);
+        dlen += entlen;
+    } else if (state == S_TAGOPEN) {
+        dst[dlen++] = '<';
+    }
+
+    if ((links != NULL) && (linkstart >= 0))
+        addlink(links, linkstart, dlen, linkhref, linkhreflen);
+
+    /* terminate with a NUL-terminator */
+    dst[dlen] = '\0';
+    return dlen;
+}
+
+void html_linkhref(char *dst, size_t size, const char *src, const struct htmllink *link)
+{
+    const char *s = src + link->href;
+    const char *end = s + link->hreflen;
+    size_t len = 0;
+
+    if (size == 0)
+        return;
+
+    while ((s < end) && ((*s == ' ') || (*s == '\t') || (*s == '\r') || (*s == '\n')))
+        s++;
+    while ((end > s) && ((end[-1] == ' ') || (end[-1] == '\t') || (end[-1] == '\r') || (end[-1] == '\n')))
+        end--;
+
+    while ((s < end) && (len + 4 < size)) {
+        if (*s == '&') { /* look for a complete entity */
+            const char *semi = s + 1;
+            long cp = -1;
+            while ((semi < end) && (semi - s <= 12) && (*semi != ';'))
+                semi++;
+            if ((semi < end) && (*semi == ';'))
+                cp = entity(s + 1, semi - s - 1);
+            if (cp >= 0) {
+                len += putcp(dst + len, cp);
+                s = semi + 1;
+                continue;
+            }
+        }
+        dst[len++] = *(s++);
+    }
+
+    dst[len] = 0;
+}
+
+void html_freelinks(struct htmllinks *links)
+{
+    free(links->link);
+    links->link = NULL;
+    links->count = 0;
+    links->size = 0;
+}
@@ -0,0 +1,37 @@
+/*
+ * This file is part of the Gopherus project.
+ */
+
+#ifndef HTML_H
+#define HTML_H
+
+#include <stddef.h>    /* size_t */
+
+struct htmllink {
+    long start;     /* offset of the link text within the rendered text */
+    long end;       /* offset right after the link text */
+    long href;      /* offset of the link target within the html source */
+    long hreflen;   /* length of the link target */
+};
+
+/* links of an html document, in the order of appearance */
+struct htmllinks {
+    struct htmllink *link;
+    long count;
+    long size;      /* number of allocated entries in link */
+};
+
+/* converts html into plain text ready for display and returns its length.
+ * dst must be at least slen + 1 bytes long. If links is not NULL, the links
+ * of the document are stored there, and must be freed with html_freelinks().
+ * Entities are decoded to UTF-8. */
+long process_html(char *dst, const char *src, long slen, struct htmllinks *links);
+
+/* copies the target of link into dst, a buffer of size bytes, decoding the
+ * entities it may contain. src is the html source the link comes from. */
+void html_linkhref(char *dst, size_t size, const char *src, const struct htmllink *link);
+
+/* frees the memory used by links */
+void html_freelinks(struct htmllinks *links);
+
+#endif
@@ -0,0 +1,149 @@
+/*
+ * This file is part of the Gopherus project.
+ */
+
+#include <stdlib.h>    /* realloc(), free() */
+#include "lineidx.h"
+#include "wordwrap.h"
+
+/* returns where the line after the one starting at offset starts, or -1 if
+ * it is the last one */
+static long nextline(const struct lineidx *idx, long offset)
+{
+    int linelen;
+    long next = wordwrap_span(idx->text + offset, idx->len - offset, idx->width, &linelen);
+
+    if (next < 0)
+        return -1;
+    next += offset;
+
+    /* a final line feed is followed by an empty line, but what lies past
+     * len (if not the NUL terminator) is no part of the text */
+    if ((next > idx->len) || ((next == idx->len) && (idx->text[next] != 0)))
+        return -1;
+    return next;
+}
+
+static int addmark(struct lineidx *idx, long offset)
+{
+    if (idx->markcount == idx->marksize) {
+        long newsize = (idx->marksize > 0) ? idx->marksize * 2 : 1024;
+        long *newmarks = realloc(idx->marks, newsize * sizeof *newmarks);
+        if (newmarks == NULL)
+            return -1;
+        idx->marks = newmarks;
+        idx->marksize = newsize;
+    }
+    idx->marks[idx->markcount++] = offset;
+    return 0;
+}
+
+void lineidx_init(struct lineidx *idx, const char *text, long len, int width)
+{
+    idx->text = text;
+    idx->len = len;
+    idx->marks = NULL;
+    idx->markcount = 0;
+    idx->marksize = 0;
+    idx->count = 0;
+    idx->last = 0;
+    idx->next = 0; /* even an empty text has one line */
+    idx->width = width;
+}
+
+int lineidx_extend(struct lineidx *idx, long upto)
+{
+    while ((idx->next >= 0) && (idx->next <= upto)) {
+        if ((idx->count % LINEIDX_STEP == 0) && (addmark(idx, idx->next) != 0)) {
+            idx->next = -1;
+            return -1;
+        }
+        idx->count++;
+        idx->last = idx->next;
+        idx->next = nextline(idx, idx->next);
+    }
+
+    return 0;
+}
+
+void lineidx_grow(struct lineidx *idx, const char *text, long len)
+{
+    idx->text = text;
+
+    /* the last line ends with the former text, or is an empty one after it */
+    if ((idx->next < 0) && (idx->count > 0)) {
+        idx->count--;
+        if (idx->count % LINEIDX_STEP == 0)
+            idx->markcount--;
+        idx->next = idx->last;
+    }
+
+    idx->len = len;
+}
+
+long lineidx_lines(const struct lineidx *idx, long first, long n, long *offsets)
+{
+    long offset, line, found = 0;
+
+    if ((first < 0) || (first >= idx->count)) {
+        offsets[0] = idx->len;
+        return 0;
+    }
+
+    /* wrap the lines between the closest mark and the first one */
+    offset = idx->marks[first / LINEIDX_STEP];
+    for (line = first - first % LINEIDX_STEP; line < first; line++)
+        offset = nextline(idx, offset);
+
+    while ((found < n) && (first + found < idx->count)) {
+        offsets[found++] = offset;
+        offset = nextline(idx, offset);
+        if (offset < 0)
+            offset = idx->len;
+    }
+    offsets[found] = offset;
+
+    return found;
+}
+
+long lineidx_find(const struct lineidx *idx, long offset)
+{
+    long lo = 0, hi = idx->markcount - 1;
+    long line, start;
+
+    if (hi < 0)
+        return 0;
+
+    /* look for the last mark at or before offset */
+    while (lo < hi) {
+        long mid = lo + (hi - lo + 1) / 2;
+        if (idx->marks[mid] <= offset) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+
+    /* then wrap the lines that follow it */
+    line = lo * LINEIDX_STEP;
+    start = idx->marks[lo];
+    while (line + 1 < idx->count) {
+        long next = nextline(idx, start);
+        if ((next < 0) || (next > offset))
+            break;
+        start = next;
+        line++;
+    }
+
+    return line;
+}
+
+void lineidx_free(struct lineidx *idx)
+{
+    free(idx->marks);
+    idx->marks = NULL;
+    idx->markcount = 0;
+    idx->marksize = 0;
+    idx->count = 0;
+    idx->next = -1;
+}
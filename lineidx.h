@@ -0,0 +1,51 @@
+/*
+ * This file is part of the Gopherus project.
+ */
+
+#ifndef LINEIDX_H
+#define LINEIDX_H
+
+/* only the start of one line out of LINEIDX_STEP is recorded, the lines in
+ * between being found again by wrapping from there */
+#define LINEIDX_STEP 32
+
+/* where the lines a text is made of start, once wrapped at a given width.
+ * The index is built step by step, so that a large text can be shown before
+ * all of it has been wrapped. */
+struct lineidx {
+    const char *text; /* the text, NUL-terminated */
+    long len;         /* length of the text, lines past it are ignored */
+    long *marks;      /* offset of lines 0, LINEIDX_STEP, 2 * LINEIDX_STEP... */
+    long markcount;   /* number of marks */
+    long marksize;    /* number of allocated entries in marks */
+    long count;       /* number of lines indexed so far */
+    long last;        /* where the last line indexed starts */
+    long next;        /* where the next line to index starts, or -1 once done */
+    int width;        /* width the text is wrapped at */
+};
+
+/* prepares an index of text, without indexing anything yet */
+void lineidx_init(struct lineidx *idx, const char *text, long len, int width);
+
+/* indexes the lines starting up to offset upto (idx->len for all of them).
+ * Returns 0 on success. If out of memory, the index ends where it got, and
+ * -1 is returned. */
+int lineidx_extend(struct lineidx *idx, long upto);
+
+/* makes the index follow its text, that got longer: text (that may have
+ * moved) and len replace the former ones. The former text must have ended
+ * with a line feed, since only its last line is wrapped again. */
+void lineidx_grow(struct lineidx *idx, const char *text, long len);
+
+/* fills offsets with the start of the n lines from line first on, followed
+ * by where the last of them ends. Returns the number of lines found, that
+ * stops at the last indexed line. */
+long lineidx_lines(const struct lineidx *idx, long first, long n, long *offsets);
+
+/* returns the number of the line containing offset, which must be indexed */
+long lineidx_find(const struct lineidx *idx, long offset);
+
+/* frees the memory used by the index */
+void lineidx_free(struct lineidx *idx);
+
+#endif
@@ -0,0 +1,884 @@
+/*
+ * This file is part of the Gopherus project.
+ * Copyright (C) Mateusz Viste 2013
+ */
+
+#include <ctype.h>     /* tolower() */
+#include <stdlib.h>    /* atol(), malloc() */
+#include <string.h>
+#include <stdio.h>     /* sprintf(), fwrite()... */
+#include <unistd.h>    /* usleep() */
+#include <sys/time.h>  /* gettimeofday() */
+#include "bufpool.h"
+#include "common.h"
+#include "dnscache.h"
+#include "embdpage.h"
+#include "gopher.h"
+#include "hoststat.h"
+#include "loadfile.h"
+#include "mirror.h"
+#include "net.h"
+#include "parseurl.h"
+#include "preconn.h"
+#include "spool.h"
+#include "version.h"
+
+#define MAXSERVERS 8            /* a resource and its replicas, that are asked at most */
+#define MAXINFLIGHT 2           /* servers asked at once: one, and a hedge if it is late */
+#define HEDGE_PERCENTILE 95     /* a server is late past this percentile of its times to first byte */
+#define HEDGE_DEFAULT 1000000l  /* usec, how late a server that answered too few times yet is */
+#define HEDGE_MIN 20000l        /* usec, so that a hedge does not fire on every jitter of a fast link */
+#define STATUS_INTERVAL 100000l /* usec between two updates of the status bar during a transfer */
+#define SIZECACHE 16            /* resources whose size is remembered, to tell how long fetching them again takes */
+#define SPOOL_CHUNK 65536       /* bytes received at once into a spool file, once loadfile_buff() returned */
+
+/* a request to one of the servers of a resource */
+struct attempt {
+    const struct url *url;
+    struct timeval start;
+    struct timeval sent;
+    long dns;
+    long connect;  /* -1 until connected */
+    long deadline; /* usec to wait for the connection, then for the first byte of the answer, before giving up */
+    int timed;     /* 0 if the connection was opened in advance, 1 if it is timed */
+    int asked;     /* non-zero once the request is sent */
+};
+
+/* how a transfer goes, as the status bar tells it */
+struct progress {
+    long expected;    /* size of the resource, or -1 if unknown */
+    long lastupdate;  /* when the status bar was updated last, in usec from the start of the transfer */
+    long lastbytes;   /* bytes received by then */
+    long rate;        /* smoothed throughput in bytes per second, or -1 until known */
+};
+
+/* the sizes of the resources fetched last, replaced in turn */
+static struct {
+    const char *host;  /* interned, NULL if the entry is free */
+    unsigned short port;
+    unsigned long hash;
+    long size;
+} sizecache[SIZECACHE];
+static int sizecachenext;
+
+/* makes sure the pool buffer *bufptr holds at least size bytes, keeping
+ * its keep first bytes. Returns 0 on success, non-zero if out of memory. */
+static int reserve(char **bufptr, long keep, long size)
+{
+    char *newbuf;
+
+    if (bufpool_size(*bufptr) >= size)
+        return 0;
+    newbuf = bufpool_grow(*bufptr, keep, size);
+    if (newbuf == NULL)
+        return -1;
+    *bufptr = newbuf;
+    return 0;
+}
+
+/* returns how long to wait for the first byte of an answer of a server before asking another one */
+static long hedgedelay(const struct url *url)
+{
+    long delay = hoststat_percentile(url->host, url->port, HEDGE_PERCENTILE);
+    if (delay < 0)
+        return HEDGE_DEFAULT;
+    return (delay < HEDGE_MIN) ? HEDGE_MIN : delay;
+}
+
+/* resolves the host of a server, and starts connecting to it, unless a connection to it has been opened in advance
+   already. Returns the socket, or NULL on error. */
+static struct net_tcpsocket *startattempt(struct attempt *a, char *statusbar, struct gopherusconfig *cfg)
+{
+    unsigned long int ipaddr;
+    char statusmsg[128];
+    struct net_tcpsocket *sk;
+
+    gettimeofday(&a->start, NULL);
+    a->dns = 0;
+    a->connect = -1;
+    a->deadline = hoststat_deadline(a->url->host, a->url->port, HOSTSTAT_CONNECT);
+    a->timed = 0;
+    a->asked = 0;
+    sk = preconn_take(a->url->host, a->url->port);
+    if (sk != NULL)
+        return sk;
+
+    ipaddr = dnscache_ask(a->url->host);
+    if (ipaddr == 0) {
+        sprintf(statusmsg, "Resolving '%s'...", a->url->host);
+        draw_statusbar(statusmsg, cfg);
+        /* the host may have been resolved in the background already, or be on its way */
+        while ((dnscache_collect(a->url->host, 100000) != 0) && !is_int_pending());
+        ipaddr = dnscache_ask(a->url->host);
+    }
+    if (ipaddr == 0) {
+        ipaddr = net_dnsresolve(a->url->host);
+        if (ipaddr == 0) {
+            set_statusbar(statusbar, "!DNS resolution failed!");
+            return NULL;
+        }
+        dnscache_add(a->url->host, ipaddr);
+    }
+    a->dns = usec_since(&a->start);
+    sprintf(statusmsg, "Connecting to %d.%d.%d.%d...", (int)(ipaddr >> 24) & 0xFF, (int)(ipaddr >> 16) & 0xFF, (int)(ipaddr >> 8) & 0xFF, (int)(ipaddr & 0xFF));
+    draw_statusbar(statusmsg, cfg);
+
+    sk = net_connect(ipaddr, a->url->port);
+    if (sk == NULL) {
+        set_statusbar(statusbar, "!Connection error!");
+    } else {
+        a->timed = 1;
+    }
+    return sk;
+}
+
+/* returns a hash of the selector of a resource, and of its item type (FNV-1a) */
+static unsigned long selectorhash(const struct url *url)
+{
+    unsigned long hash = 2166136261ul;
+    const char *s;
+
+    hash = ((hash ^ (unsigned char)url->itemtype) * 16777619ul) & 0xFFFFFFFFul;
+    for (s = url->selector; *s != 0; s++)
+        hash = ((hash ^ (unsigned char)*s) * 16777619ul) & 0xFFFFFFFFul;
+    return hash;
+}
+
+/* returns the size of the resource when it was fetched last, or -1 if unknown */
+static long knownsize(const struct url *url)
+{
+    unsigned long hash = selectorhash(url);
+    int i;
+
+    for (i = 0; i < SIZECACHE; i++)
+        if ((sizecache[i].host == url->host) && (sizecache[i].port == url->port) && (sizecache[i].hash == hash))
+            return sizecache[i].size;
+    return -1;
+}
+
+static void remembersize(const struct url *url, long size)
+{
+    unsigned long hash = selectorhash(url);
+    int i;
+
+    for (i = 0; i < SIZECACHE; i++)
+        if ((sizecache[i].host == url->host) && (sizecache[i].port == url->port) && (sizecache[i].hash == hash))
+            break;
+    if (i == SIZECACHE) {
+        i = sizecachenext;
+        sizecachenext = (sizecachenext + 1) % SIZECACHE;
+    }
+    sizecache[i].host = url->host;
+    sizecache[i].port = url->port;
+    sizecache[i].hash = hash;
+    sizecache[i].size = size;
+}
+
+/* returns the Content-Length given in the len bytes of the headers of an HTTP answer, or -1 if none */
+static long contentlength(const char *headers, long len)
+{
+    static const char name[] = "content-length:";
+    long i;
+    int j;
+
+    for (i = 0; i + (long)sizeof name < len; i++) {
+        if ((i > 0) && (headers[i - 1] != '\n'))
+            continue;
+        for (j = 0; (name[j] != 0) && (tolower((unsigned char)headers[i + j]) == name[j]); j++);
+        if (name[j] == 0)
+            return atol(headers + i + j);
+    }
+    return -1;
+}
+
+/* updates the status bar with how the transfer goes: received bytes, throughput, and what is left if the size of the
+   resource is known. now is the time elapsed since the start of the transfer, in usec. */
+static void showprogress(struct progress *p, long received, long now, char *statusbar, struct gopherusconfig *cfg)
+{
+    char statusmsg[128];
+    char rate[32];
+    char eta[32];
+    long ms = (now - p->lastupdate) / 1000;
+
+    if (ms > 0) {
+        long delta = received - p->lastbytes;
+        long current = (delta / ms) * 1000 + ((delta % ms) * 1000) / ms; /* delta * 1000 / ms, that may overflow */
+        /* smoothed the way TCP does round trip times, so that the figures do not flicker */
+        p->rate = (p->rate < 0) ? current : p->rate - p->rate / 4 + current / 4;
+    }
+    p->lastupdate = now;
+    p->lastbytes = received;
+
+    if (p->rate < 0) {
+        rate[0] = 0;
+    } else if (p->rate < 1024) {
+        sprintf(rate, ", %ld B/s", p->rate);
+    } else if (p->rate < 10 * 1024l * 1024) {
+        sprintf(rate, ", %ld KiB/s", p->rate / 1024);
+    } else {
+        sprintf(rate, ", %ld MiB/s", p->rate / (1024l * 1024));
+    }
+
+    eta[0] = 0;
+    if ((p->expected > received) && (p->rate > 0)) {
+        long left = (p->expected - received) / p->rate + 1;
+        if (left < 120) {
+            sprintf(eta, ", %ld s left", left);
+        } else {
+            sprintf(eta, ", %ld min left", left / 60);
+        }
+    }
+
+    if (p->expected >= received) {
+        sprintf(statusmsg, "Downloading... [%ld of %ld bytes%s%s]", received, p->expected, rate, eta);
+    } else {
+        sprintf(statusmsg, "Downloading... [%ld bytes%s]", received, rate);
+    }
+    set_statusbar(statusbar, statusmsg);
+    draw_statusbar(statusbar, cfg);
+}
+
+long loadfile_findterminator(const char *buf, long len, int *state)
+{
+    const char *p = buf, *end = buf + len;
+
+    while (p < end) {
+        if (*state < 0) { /* no terminator in this line: skip to the next one */
+            p = memchr(p, '\n', end - p);
+            if (p == NULL)
+                return -1;
+            *state = 0;
+        } else if (*p == '\n') {
+            if (*state > 0)
+                return (p + 1) - buf;
+            *state = 0; /* an empty line */
+        } else if ((*p == '.') && (*state == 0)) {
+            *state = 1;
+        } else if ((*p == '\r') && (*state == 1)) {
+            *state = 2;
+        } else {
+            *state = -1;
+        }
+        p++;
+    }
+    return -1;
+}
+
+/* sends the request for a resource to a server, building it in buffer. Returns 0 on success. */
+static int sendrequest(struct net_tcpsocket *sk, const struct url *url, char *buffer)
+{
+    if (url->protocol == PARSEURL_PROTO_HTTP) { /* http */
+        sprintf(buffer, "GET /%s HTTP/1.0\r\nHOST: %s\r\nUSER-AGENT: Gopherus v" VERSION "\r\n\r\n", url->selector, url->host);
+    } else { /* gopher */
+        sprintf(buffer, "%s\r\n", url->selector);
+    }
+    return (net_send(sk, buffer, strlen(buffer)) == (int)strlen(buffer)) ? 0 : -1;
+}
+
+/* returns how long an attempt has been waiting for, either for its connection or for the first byte of the answer */
+static long waited(const struct attempt *a)
+{
+    if (a->connect < 0)
+        return usec_since(&a->start) - a->dns;
+    return usec_since(&a->sent);
+}
+
+/* drops the i-th of the *inflight attempts */
+static void dropattempt(struct attempt *attempt, struct net_tcpsocket **sk, int *inflight, int i)
+{
+    net_abort(sk[i]);
+    *inflight -= 1;
+    attempt[i] = attempt[*inflight];
+    sk[i] = sk[*inflight];
+}
+
+/* asks the servers of a resource for it, in order, until one answers. The next server is asked as well when a request
+   fails or is past its deadline, or when the first byte of the answer is late: then the first server to answer wins, and the other one is dropped.
+   The first bytes of the answer are received into buffer. Returns the socket of the winner, with *received set as
+   net_recv() would and *winner to its server, or NULL on error. */
+static struct net_tcpsocket *askservers(const struct url **server, int servercount, char *buffer, long room, long *received, const struct url **winner, char *statusbar, struct gopherusconfig *cfg, struct loadstats *stats)
+{
+    struct attempt attempt[MAXINFLIGHT];
+    struct net_tcpsocket *sk[MAXINFLIGHT];
+    int inflight = 0, next = 0, i;
+    long deadline = 0;  /* when the last server asked is late, in usec from start */
+    struct timeval start;
+
+    gettimeofday(&start, NULL);
+    for (;;) {
+        long elapsed = usec_since(&start);
+        long wait = 100000;
+        int res, j;
+
+        /* ask the next server, if no one is being asked, or as a hedge */
+        if ((next < servercount) && (inflight < MAXINFLIGHT) && ((inflight == 0) || (elapsed >= deadline))) {
+            attempt[inflight].url = server[next++];
+            sk[inflight] = startattempt(&attempt[inflight], statusbar, cfg);
+            stats->servers += 1;
+            if (sk[inflight] == NULL) {
+                hoststat_failure(server[next - 1]->host, server[next - 1]->port);
+                continue;
+            }
+            deadline = usec_since(&start) + hedgedelay(attempt[inflight].url);
+            inflight += 1;
+            continue;
+        }
+        if (inflight == 0)
+            return NULL; /* no server left, the status bar tells how the last one failed */
+        if (is_int_pending()) {
+            set_statusbar(statusbar, "Connection aborted by the user.");
+            break;
+        }
+        /* a server past its deadline is given up on: it is likely dead, and the next one may not be */
+        for (i = 0; (i < inflight) && (waited(&attempt[i]) <= attempt[i].deadline); i++);
+        if (i < inflight) {
+            if (attempt[i].connect < 0) {
+                set_statusbar(statusbar, "!Connection timed out!");
+                hoststat_timeout(attempt[i].url->host, attempt[i].url->port, HOSTSTAT_CONNECT);
+            } else {
+                set_statusbar(statusbar, "!Timeout while waiting for data!");
+                hoststat_timeout(attempt[i].url->host, attempt[i].url->port, HOSTSTAT_ANSWER);
+            }
+            dropattempt(attempt, sk, &inflight, i);
+            continue;
+        }
+
+        if ((next < servercount) && (inflight < MAXINFLIGHT) && (deadline - elapsed < wait))
+            wait = (deadline > elapsed) ? deadline - elapsed : 0;
+        /* a connection may be established (or failed) already, notably one opened in advance: no need to wait then */
+        for (i = 0; (i < inflight) && ((attempt[i].connect >= 0) || (net_isconnected(sk[i]) == 0)); i++);
+        if (i == inflight) {
+            i = net_wait(sk, inflight, wait);
+            if (i < 0)
+                continue;
+        }
+
+        if (attempt[i].connect < 0) { /* still connecting */
+            res = net_isconnected(sk[i]);
+            /* the request is sent as soon as it may be: a Fast Open connection only starts then, the request going
+               along with its SYN, and it is connected once the server answered that (within the connect deadline) */
+            if ((res > 0) && (attempt[i].asked == 0)) {
+                attempt[i].asked = 1;
+                res = (sendrequest(sk[i], attempt[i].url, buffer) == 0) ? net_isconnected(sk[i]) : -2;
+            }
+            if (res == 0)
+                continue;
+            if (res > 0) {
+                attempt[i].connect = usec_since(&attempt[i].start) - attempt[i].dns;
+                if (attempt[i].timed)
+                    hoststat_measure(attempt[i].url->host, attempt[i].url->port, HOSTSTAT_CONNECT, attempt[i].connect);
+                attempt[i].deadline = hoststat_deadline(attempt[i].url->host, attempt[i].url->port, HOSTSTAT_ANSWER);
+                gettimeofday(&attempt[i].sent, NULL);
+                continue;
+            }
+            set_statusbar(statusbar, (res == -2) ? "!send() error!" : "!Connection error!");
+        } else {
+            res = net_recv(sk[i], buffer, room);
+            if (res == 0)
+                continue;
+            /* an empty answer is only taken if there is no one else to ask */
+            if ((res > 0) || ((res == -1) && (inflight == 1) && (next == servercount))) {
+                long latency = usec_since(&attempt[i].start);
+                stats->dns = attempt[i].dns;
+                stats->connect = attempt[i].connect;
+                stats->ttfb = usec_since(&attempt[i].sent);
+                hoststat_answer(attempt[i].url->host, attempt[i].url->port, latency);
+                hoststat_measure(attempt[i].url->host, attempt[i].url->port, HOSTSTAT_ANSWER, stats->ttfb);
+                /* a server asked before the winner, that did not answer yet, is at least that slow */
+                for (j = 0; j < inflight; j++) {
+                    if (j == i)
+                        continue;
+                    if (usec_since(&attempt[j].start) > latency)
+                        hoststat_answer(attempt[j].url->host, attempt[j].url->port, usec_since(&attempt[j].start));
+                    net_abort(sk[j]);
+                }
+                *received = res;
+                *winner = attempt[i].url;
+                return sk[i];
+            }
+            if (res < -1)
+                set_statusbar(statusbar, "!Connection error!");
+        }
+
+        /* the request to this server failed: drop it */
+        hoststat_failure(attempt[i].url->host, attempt[i].url->port);
+        dropattempt(attempt, sk, &inflight, i);
+    }
+
+    for (i = 0; i < inflight; i++)
+        net_abort(sk[i]);
+    return NULL;
+}
+
+/* creates the file a resource is saved into, unless there is one by that name already. Returns NULL on error. */
+static FILE *createfile(const char *filename, char *statusbar)
+{
+    FILE *fd = fopen(filename, "rb"); /* try to open for read - this should fail */
+
+    if (fd != NULL) {
+        set_statusbar(statusbar, "!File already exists! Operation aborted.");
+        fclose(fd);
+        return NULL;
+    }
+    fd = fopen(filename, "wb"); /* now open for write - this will create the file */
+    if (fd == NULL) /* this should not fail */
+        set_statusbar(statusbar, "!Error: could not create the file on disk!");
+    return fd;
+}
+
+/* opens the file of a resource in the mirror dir, or returns NULL if it is not there */
+static FILE *openmirror(const struct url *url, const char *dir)
+{
+    static const char kept[] = {GOPHER_ITEM_FILE, GOPHER_ITEM_DIR};
+    char path[MIRROR_MAXPATH];
+    struct url other = *url;
+    FILE *fd = NULL;
+    int i;
+
+    if (mirror_path(path, sizeof path, dir, url) == 0)
+        fd = fopen(path, "rb");
+    /* a location saved with F9 is asked for as a binary file, whatever it is: the mirror keeps menus and texts */
+    for (i = 0; (fd == NULL) && (url->itemtype == GOPHER_ITEM_BINARY) && (i < (int)sizeof kept); i++) {
+        other.itemtype = kept[i];
+        if (mirror_path(path, sizeof path, dir, &other) == 0)
+            fd = fopen(path, "rb");
+    }
+    return fd;
+}
+
+/* ends the transfer of a spool: done is 1 if all came, -1 if it failed */
+static void endspool(struct loadfile_spool *spool, int done)
+{
+    if (spool->sk != NULL) {
+        if (done > 0) {
+            net_close(spool->sk);
+        } else {
+            net_abort(spool->sk);
+        }
+        spool->sk = NULL;
+    }
+    if (spool->fd != NULL)
+        fclose(spool->fd);
+    spool->fd = NULL;
+    free(spool->chunk);
+    spool->chunk = NULL;
+    spool->done = done;
+}
+
+/* makes a spool of the len bytes written to fd, the rest coming from sk, or from nowhere if it is NULL. Returns NULL
+   on error, fd and sk being closed then. */
+static struct loadfile_spool *newspool(FILE *fd, long len, struct net_tcpsocket *sk, char *statusbar)
+{
+    struct loadfile_spool *spool = malloc(sizeof *spool);
+
+    if (spool == NULL) {
+        set_statusbar(statusbar, "!Out of memory!");
+        fclose(fd);
+        if (sk != NULL)
+            net_abort(sk);
+        return NULL;
+    }
+    memset(spool, 0, sizeof *spool);
+    spool->fd = fd;
+    spool->sk = sk;
+    spool->len = len;
+    spool->received = len;
+    spool->text = spool_view(fd, len, NULL, &spool->maplen);
+    if (sk != NULL)
+        spool->chunk = malloc(SPOOL_CHUNK);
+
+    if (spool->text == NULL) {
+        set_statusbar(statusbar, "!Error: could not map the spool file!");
+    } else if ((sk != NULL) && (spool->chunk == NULL)) {
+        set_statusbar(statusbar, "!Out of memory!");
+        spool_unmap(spool->text, spool->maplen);
+    } else {
+        if (sk == NULL)
+            endspool(spool, 1);
+        return spool;
+    }
+    endspool(spool, -1);
+    free(spool);
+    return NULL;
+}
+
+void loadfile_more(struct loadfile_spool *spool, long usec, char *statusbar)
+{
+    struct timeval start;
+    long now = 0, last = 0;
+    int done = 0;
+    char *text;
+
+    if (spool->done != 0)
+        return;
+
+    gettimeofday(&start, NULL);
+    while (now < usec) {
+        int byteread = net_recv(spool->sk, spool->chunk, SPOOL_CHUNK);
+        now = usec_since(&start);
+        if (byteread < 0) { /* end of connection */
+            done = 1;
+            break;
+        }
+        if (byteread == 0) { /* nothing came: the user may have something else to do meanwhile */
+            spool->silence += now - last;
+            if (spool->silence > spool->stalldeadline) {
+                set_statusbar(statusbar, "!Timeout while waiting for data!");
+                hoststat_timeout(spool->winner->host, spool->winner->port, HOSTSTAT_STALL);
+                done = -1;
+            }
+            break;
+        }
+        if (fwrite(spool->chunk, 1, byteread, spool->fd) != (size_t)byteread) {
+            set_statusbar(statusbar, "!Error: could not write the spool file!");
+            done = -1;
+            break;
+        }
+        spool->received += byteread;
+        if (spool->silence > spool->longestgap)
+            spool->longestgap = spool->silence;
+        spool->silence = 0;
+        last = now;
+    }
+    spool->busy += now;
+
+    /* what came is shown, even if the rest is not to come */
+    text = spool_view(spool->fd, spool->received, spool->text, &spool->maplen);
+    if (text == NULL) {
+        set_statusbar(statusbar, "!Error: could not map the spool file!");
+        done = -1;
+    } else {
+        spool->text = text;
+        spool->len = spool->received;
+    }
+
+    if (done > 0) {
+        remembersize(spool->url, spool->len);
+        hoststat_measure(spool->winner->host, spool->winner->port, HOSTSTAT_STALL, spool->longestgap);
+        hoststat_transfer(spool->winner->host, spool->winner->port, spool->len, spool->busy);
+    }
+    if (done != 0)
+        endspool(spool, done);
+}
+
+void loadfile_freespool(struct loadfile_spool *spool)
+{
+    if (spool->done == 0)
+        endspool(spool, -1);
+    spool_unmap(spool->text, spool->maplen);
+    free(spool);
+}
+
+/* reads a resource from the mirror being browsed offline, the way loadfile_buff() gets it from a server */
+static long loadmirror(const struct url *url, char **bufptr, long buffer_max, char *statusbar, char *filename, struct gopherusconfig *cfg, struct loadfile_spool **spool)
+{
+    FILE *src, *fd = NULL;
+    long len, copied = 0;
+
+    src = openmirror(url, cfg->offline);
+    if (src == NULL) {
+        set_statusbar(statusbar, "!This location is not in the mirror!");
+        return -1;
+    }
+    fseek(src, 0, SEEK_END);
+    len = ftell(src);
+    fseek(src, 0, SEEK_SET);
+
+    if ((filename == NULL) && (len < buffer_max)) {
+        if (reserve(bufptr, 0, len + 1) != 0) {
+            set_statusbar(statusbar, "!Out of memory!");
+            len = -1;
+        } else if ((long)fread(*bufptr, 1, len, src) != len) {
+            set_statusbar(statusbar, "!Error: could not read the mirror!");
+            len = -1;
+        } else {
+            (*bufptr)[len] = 0;
+        }
+        fclose(src);
+        return len;
+    }
+
+    /* saved on disk, or too large for memory: copied into a file through the buffer */
+    if (filename != NULL) {
+        fd = createfile(filename, statusbar);
+    } else if (spool != NULL) {
+        fd = spool_open();
+        if (fd == NULL)
+            set_statusbar(statusbar, "!Error: the resource is too long!");
+    }
+    while ((fd != NULL) && (copied < len)) {
+        size_t n = fread(*bufptr, 1, bufpool_size(*bufptr), src);
+        if ((n == 0) || (fwrite(*bufptr, 1, n, fd) != n))
+            break;
+        copied += n;
+    }
+    fclose(src);
+    if (fd == NULL)
+        return -1;
+    if (copied < len) {
+        set_statusbar(statusbar, "!Error: could not copy the resource from the mirror!");
+        fclose(fd);
+        return -1;
+    }
+    if (filename != NULL) {
+        char tmpmsg[80];
+        fclose(fd);
+        sprintf(tmpmsg, "Saved %ld bytes on disk", len);
+        set_statusbar(statusbar, tmpmsg);
+    } else {
+        *spool = newspool(fd, len, NULL, statusbar);
+        if (*spool == NULL)
+            return -1;
+    }
+    return len;
+}
+
+/* downloads a gopher or http resource and write it to a file or a memory buffer. if *filename is not NULL, the resource will
+   be written in the file (but a valid *bufptr is still required) */
+long loadfile_buff(const struct url *url, const struct url *replica, int replicacount, char **bufptr, long buffer_max, char *statusbar, char *filename, struct gopherusconfig *cfg, struct loadstats *stats, struct loadfile_spool **spool)
+{
+    char *buffer = *bufptr;
+    long buffer_room; /* what buffer holds, less a byte for a NUL terminator */
+    long reslength, byteread, fdlen = 0;
+    char statusmsg[128];
+    FILE *fd = NULL;
+    int headersdone = 0; /* used notably for HTTP, to localize the end of headers */
+    int menustate = 0;   /* where a menu is at, as loadfile_findterminator() tracks it */
+    int menudone = -1;   /* -1 if the answer is not a menu, 0 until its terminator came, 1 then */
+    int background = 0;  /* the rest of the answer is left to loadfile_more() */
+    long firstbyte, lastactivity, now, longestgap = 0, stalldeadline;
+    struct timeval start;
+    struct loadstats dummystats;
+    const struct url *server[MAXSERVERS];
+    const struct url *winner;
+    int servercount, j;
+    long requestsize = 0;
+    struct net_tcpsocket *sk;
+    struct progress progress;
+
+    if (spool != NULL)
+        *spool = NULL;
+    if (stats == NULL)
+        stats = &dummystats;
+    memset(stats, 0, sizeof *stats);
+    gettimeofday(&start, NULL);
+
+    if (url->host[0] == '#') { /* embedded start page */
+        reslength = load_embedded_page(buffer, bufpool_size(buffer) - 1, url->host + 1);
+        if (reslength > bufpool_size(buffer) - 1) {
+            if (reserve(bufptr, 0, reslength + 1) != 0) {
+                set_statusbar(statusbar, "!Out of memory!");
+                return -1;
+            }
+            buffer = *bufptr;
+            load_embedded_page(buffer, reslength, url->host + 1);
+        }
+        buffer[reslength] = 0;
+        /* open file, if downloading to a file */
+        if (filename != NULL) {
+            fd = createfile(filename, statusbar);
+            if (fd == NULL)
+                return -1;
+            fwrite(buffer, 1, reslength, fd);
+            fclose(fd);
+        }
+        return reslength;
+    }
+
+    if (cfg->offline != NULL) /* nothing is fetched from the servers */
+        return loadmirror(url, bufptr, buffer_max, statusbar, filename, cfg, spool);
+
+    /* the servers of the resource, the fastest ones first (the sort is stable, so unknown ones stay in order) */
+    for (servercount = 0; (servercount < MAXSERVERS) && (servercount <= replicacount); servercount++) {
+        const struct url *s = (servercount == 0) ? url : &replica[servercount - 1];
+        long size = strlen(s->selector) + strlen(s->host) + 128;
+        long cost = hoststat_cost(s->host, s->port);
+        if (size > requestsize)
+            requestsize = size;
+        for (j = servercount; (j > 0) && (hoststat_cost(server[j - 1]->host, server[j - 1]->port) > cost); j--)
+            server[j] = server[j - 1];
+        server[j] = s;
+    }
+    if (reserve(bufptr, 0, requestsize) != 0) {
+        set_statusbar(statusbar, "!Out of memory!");
+        return -1;
+    }
+    buffer = *bufptr;
+    sk = askservers(server, servercount, buffer, bufpool_size(buffer) - 1, &byteread, &winner, statusbar, cfg, stats);
+    if (sk == NULL)
+        return -1;
+    stats->server = (winner == url) ? 0 : (winner - replica) + 1;
+    /* prepare timers: the server is given up on if it stays silent for much longer than it used to */
+    firstbyte = usec_since(&start);
+    lastactivity = firstbyte;
+    now = firstbyte;
+    stalldeadline = hoststat_deadline(winner->host, winner->port, HOSTSTAT_STALL);
+    /* open file, if downloading to a file */
+    if (filename != NULL) {
+        fd = createfile(filename, statusbar);
+        if (fd == NULL) {
+            net_abort(sk);
+            return -1;
+        }
+    }
+    /* a menu is complete once its terminator came: the server may linger before closing the connection, and that
+       wait is spared (unless the user would rather wait, for servers that send lone dots in their menus) */
+    if ((url->protocol == PARSEURL_PROTO_GOPHER) && (cfg->waitclose == 0) &&
+        ((url->itemtype == GOPHER_ITEM_DIR) || (url->itemtype == GOPHER_ITEM_INDEX_SEARCH_SERVER)))
+        menudone = 0;
+    /* the size of the resource is known if it has been fetched already, or from the headers of an HTTP answer */
+    progress.expected = knownsize(url);
+    progress.lastupdate = usec_since(&start);
+    progress.lastbytes = 0;
+    progress.rate = hoststat_throughput(winner->host, winner->port);
+    /* receive answer, its first bytes being there already */
+    reslength = 0;
+    for (;;) {
+        if (byteread < 0) break; /* end of connection */
+
+        if (is_int_pending()) {
+            set_statusbar(statusbar, "Connection aborted by the user.");
+            reslength = -1;
+            break;
+        }
+
+        if (byteread > 0) {
+            if (now - lastactivity > longestgap)
+                longestgap = now - lastactivity;
+            lastactivity = now;
+            reslength += byteread;
+            /* if protocol is http, ignore headers */
+            if ((url->protocol == PARSEURL_PROTO_HTTP) && (headersdone == 0)) {
+                int i;
+                for (i = 0; i < reslength - 2; i++) {
+                    if (buffer[i] == '\n') {
+                        if (buffer[i + 1] == '\r') i++; /* skip CR if following */
+                        if (buffer[i + 1] == '\n') {
+                            i += 2;
+                            progress.expected = contentlength(buffer, i);
+                            headersdone = reslength;
+                            for (reslength = 0; i < headersdone; i++) buffer[reslength++] = buffer[i];
+                            break;
+                        }
+                    }
+                }
+            } else {
+                if (menudone == 0) {
+                    long end = loadfile_findterminator(buffer + (reslength - fdlen - byteread), byteread, &menustate);
+                    if (end >= 0) {
+                        reslength -= byteread - end; /* what may follow the terminator is not part of the menu */
+                        menudone = 1;
+                    }
+                }
+                if ((fd != NULL) && (reslength - fdlen > 4096)) { /* if downloading to file, write stuff to disk */
+                    int writeres = fwrite(buffer, 1, reslength - fdlen, fd);
+                    if (writeres < 0) writeres = 0;
+                    fdlen += writeres;
+                }
+                if (menudone > 0)
+                    break;
+            }
+        } else {
+            if (now - lastactivity > 2000000l) {
+                if (now - lastactivity > stalldeadline) { /* TIMEOUT! */
+                    set_statusbar(statusbar, "!Timeout while waiting for data!");
+                    hoststat_timeout(winner->host, winner->port, HOSTSTAT_STALL);
+                    reslength = -1;
+                    break;
+                } else {
+                    usleep(250000);  /* give the cpu some time up (250ms), the transfer is really slow */
+                }
+            }
+        }
+
+        /* the status bar is updated at a steady pace rather than for every chunk: drawing it may take longer than
+           receiving one */
+        if (((url->protocol != PARSEURL_PROTO_HTTP) || (headersdone != 0)) && (usec_since(&start) - progress.lastupdate >= STATUS_INTERVAL))
+            showprogress(&progress, reslength, usec_since(&start), statusbar, cfg);
+
+        buffer_room = bufpool_size(buffer) - 1;
+        if ((buffer_room + fdlen - reslength < 1) && (fd == NULL) && (buffer_room + 1 < buffer_max)) {
+            /* the buffer is full: go on into a larger one, if there is memory for it */
+            long size = (buffer_room + 1) * 4;
+            if (reserve(bufptr, reslength, (size < buffer_max) ? size : buffer_max) == 0) {
+                buffer = *bufptr;
+                buffer_room = bufpool_size(buffer) - 1;
+            }
+        }
+        if (buffer_room + fdlen - reslength < 1) { /* too much data! */
+            if ((spool != NULL) && (fd == NULL) && ((url->protocol != PARSEURL_PROTO_HTTP) || (headersdone != 0))) {
+                fd = spool_open(); /* go on into a spool file, if possible */
+            }
+            if ((fd == NULL) || (fwrite(buffer, 1, reslength - fdlen, fd) != (size_t)(reslength - fdlen))) {
+                set_statusbar(statusbar, "!Error: Server's answer is too long!");
+                reslength = -1;
+                break;
+            }
+            fdlen = reslength;
+            /* a plain text is shown from the spool file while the rest comes */
+            if ((filename == NULL) && (url->itemtype == GOPHER_ITEM_FILE)) {
+                background = 1;
+                break;
+            }
+        }
+        byteread = net_recv(sk, buffer + (reslength - fdlen), buffer_room + fdlen - reslength);
+        now = usec_since(&start);
+    }
+
+    if (background) {
+        *spool = newspool(fd, reslength, sk, statusbar);
+        stats->total = usec_since(&start);
+        if (*spool == NULL)
+            return -1;
+        (*spool)->url = url;
+        (*spool)->winner = winner;
+        (*spool)->busy = now - firstbyte;
+        (*spool)->longestgap = longestgap;
+        (*spool)->stalldeadline = stalldeadline;
+        statusmsg[0] = 0;
+        draw_statusbar(statusmsg, cfg);
+        return reslength;
+    }
+
+    if (reslength >= 0) {
+        remembersize(url, reslength);
+        hoststat_measure(winner->host, winner->port, HOSTSTAT_STALL, longestgap);
+        hoststat_transfer(winner->host, winner->port, reslength, now - firstbyte);
+        statusmsg[0] = 0;
+        draw_statusbar(statusmsg, cfg);
+        if (menudone > 0) {
+            net_abort(sk); /* no need to wait for a lingering server to close */
+        } else {
+            net_close(sk);
+        }
+        if (fd == NULL)
+            buffer[reslength] = 0;
+    } else {
+        net_abort(sk);
+    }
+    stats->total = usec_since(&start);
+
+    if ((fd != NULL) && (filename == NULL)) { /* finish the spool file */
+        if ((reslength - fdlen > 0) && (fwrite(buffer, 1, reslength - fdlen, fd) != (size_t)(reslength - fdlen))) {
+            set_statusbar(statusbar, "!Error: could not write the spool file!");
+            reslength = -1;
+        }
+        if (reslength < 0) {
+            fclose(fd);
+        } else {
+            *spool = newspool(fd, reslength, NULL, statusbar);
+            if (*spool == NULL)
+                reslength = -1;
+        }
+    } else if (fd != NULL) { /* finish the buffer */
+        char tmpmsg[80];
+        if (reslength - fdlen > 0) { /* if anything left in the buffer, write it now */
+            fdlen += fwrite(buffer, 1, reslength - fdlen, fd);
+        }
+        fclose(fd);
+        sprintf(tmpmsg, "Saved %ld bytes on disk", fdlen);
+        set_statusbar(statusbar, tmpmsg);
+    }
+
+    return reslength;
+}
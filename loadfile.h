@@ -0,0 +1,71 @@
+/*
+ * This file is part of the Gopherus project.
+ * Copyright (C) Mateusz Viste 2013
+ */
+
+#ifndef LOADFILE_H
+#define LOADFILE_H
+
+#include <stdio.h>    /* FILE */
+#include "common.h"
+#include "net.h"
+#include "parseurl.h"
+
+/* timings of a transfer, in microseconds. dns is about 0 on a cache hit, and
+ * ttfb is measured from the moment the request has been sent. These are the
+ * timings of the server that answered, out of those asked. */
+struct loadstats {
+    long dns;
+    long connect;
+    long ttfb;
+    long total;
+    int servers;  /* servers asked: more than one if a request failed or was hedged */
+    int server;   /* the one that answered: 0 for the URL, n for its n-th replica */
+};
+
+/* a resource too long for memory, kept in a spool file (see spool.h). A plain text is shown before all of it came:
+   loadfile_buff() returns as soon as it goes into the spool file, and loadfile_more() receives the rest. */
+struct loadfile_spool {
+    char *text;      /* what came so far, followed by a NUL terminator */
+    long len;        /* length of text */
+    int done;        /* 0 while the rest is coming, 1 once all came, -1 if the transfer failed */
+    /* what follows is the transfer, for loadfile.c to go on with */
+    FILE *fd;        /* the spool file, NULL once done */
+    long maplen;     /* bytes mapped at text, to grow into */
+    long received;   /* bytes written to fd */
+    char *chunk;     /* what is received goes through there */
+    struct net_tcpsocket *sk;
+    const struct url *url;
+    const struct url *winner;  /* the server that answered, url or a replica */
+    long busy;       /* usec spent receiving, the time the user did not wait for being left out */
+    long silence;    /* usec spent waiting since data came last */
+    long longestgap; /* the longest of those waits */
+    long stalldeadline;
+};
+
+/* downloads a gopher or http resource and write it to a file or a memory buffer. *bufptr is a buffer of the pool (see
+   bufpool.h), that is replaced by larger ones as the resource comes, up to buffer_max bytes. The resource is followed by a
+   NUL terminator there. If *filename is not NULL, the resource will be written in the file instead (but a valid *bufptr is
+   still required). If stats is not NULL, it is filled with the timings of the transfer. If spool is not NULL, a resource
+   too long for the buffer goes on into a spool file that is returned in *spool, which is NULL otherwise: a plain text
+   is returned as it goes there, for loadfile_more() to receive the rest.
+   The resource may also be served by replicacount replicas (the redundant servers of a gopher menu item): the fastest
+   known server is asked first, and the next one as well if it fails or is late to answer.
+   Returns the length of the resource, or -1 on error. */
+long loadfile_buff(const struct url *url, const struct url *replica, int replicacount, char **bufptr, long buffer_max, char *statusbar, char *filename, struct gopherusconfig *cfg, struct loadstats *stats, struct loadfile_spool **spool);
+
+/* receives more of a spooled resource for about usec, spool->text and spool->len being updated with what came. This
+   returns soon if nothing comes, so that the user is not kept waiting. On error, spool->done is set to -1 and statusbar
+   tells why, what came being kept. */
+void loadfile_more(struct loadfile_spool *spool, long usec, char *statusbar);
+
+/* frees a spool, aborting its transfer if it is not done */
+void loadfile_freespool(struct loadfile_spool *spool);
+
+/* follows the lines of a gopher menu as they come, to tell when its terminator (a line made of a single '.') has come.
+   Only the len new bytes of buf are looked at, *state telling where the previous ones left the current line: 0 at its
+   start, 1 after a '.' there, 2 after ".\r", or -1 anywhere else. Returns the offset in buf past the terminator, or -1
+   if it has not come yet. */
+long loadfile_findterminator(const char *buf, long len, int *state);
+
+#endif
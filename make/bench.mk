@@ -0,0 +1,48 @@
+# Benchmark programs: 'make bench' builds them, 'make bench-run' runs them
+# all. BENCHFLAGS is passed to every program, e.g. BENCHFLAGS="-s 1048576"
+# skips corpora bigger than 1 MiB. 'make bench' also builds gopherd, a local
+# gopher/HTTP test server, and loadtest, which measures page loads against it.
+
+benchdir := $(objdir)/bench
+benchprogs := wrapbench textbench menubench urlbench dnsbench
+benchbins := $(addprefix $(benchdir)/,$(addsuffix $(exeext),$(benchprogs)))
+uibench := $(benchdir)/uibench$(exeext)
+nettools := $(benchdir)/gopherd$(exeext) $(benchdir)/loadtest$(exeext)
+
+# everything but the main program and UI, plus a display-less UI
+benchobjs := \
+	$(filter-out $(objdir)/gopherus.o $(objdir)/ui%.o $(objdir)/%.res,$(objs)) \
+	$(objdir)/ui-headless.o \
+	$(benchdir)/bench.o
+
+bench: $(benchbins) $(uibench) $(nettools)
+
+bench-run: $(benchbins)
+	$(foreach prog,$(benchbins),$(prog) $(BENCHFLAGS) &&) true
+
+$(benchdir):
+	$(call mkdir,$@)
+
+$(benchdir)/%.o: $(srcdir)/bench/%.c | $(benchdir)
+	$(CC) $(CFLAGS) $(CPPFLAGS) -I$(srcdir) -MMD -c -o $@ $<
+
+$(benchdir)/%$(exeext): $(benchdir)/%.o $(benchobjs)
+	$(CC) $(CFLAGS) $^ -o $@
+
+# uibench measures the UI frontend gopherus is built with
+$(uibench): $(benchdir)/uibench.o $(filter $(objdir)/ui%.o,$(objs)) $(objdir)/utf8.o
+	$(CC) $(CFLAGS) $^ $(libs) -o $@
+
+$(benchdir)/gopherd$(exeext): $(benchdir)/gopherd.o $(benchdir)/bench.o
+	$(CC) $(CFLAGS) $^ -o $@
+
+bench-clean:
+	$(call rm,$(benchbins) $(uibench) $(nettools) $(wildcard $(benchdir)/*.o))
+
+clean: bench-clean
+
+-include $(wildcard $(benchdir)/*.d)
+
+.PRECIOUS: $(benchdir)/%.o
+
+.PHONY: bench bench-run bench-clean
@@ -4,14 +4,25 @@ UPX := upx
 CFLAGS += -O3 -pedantic
 
 objs := \
+	bookmark.o \
+	bufpool.o \
 	common.o \
 	dnscache.o \
 	embdpage.o \
 	gopherus.o \
 	history.o \
+	hoststat.o \
+	html.o \
+	lineidx.o \
+	loadfile.o \
 	menuview.o \
+	mirror.o \
 	parseurl.o \
+	plaintext.o \
+	preconn.o \
+	search.o \
 	textview.o \
+	utf8.o \
 	wordwrap.o
 
 libs :=
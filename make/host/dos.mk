@@ -13,6 +13,6 @@ else
 objs += net-stub.o
 endif
 
-objs += ui.o snprintf.o
+objs += spool-stub.o ui.o snprintf.o
 
 distfiles += gopherus.ico
@@ -2,8 +2,26 @@ CFLAGS += -std=gnu89 -Wall -Wextra
 CPPFLAGS += -DHAVE_SNPRINTF
 exeext :=
 
-objs += net-lin.o ui-sdl.o
+ifeq ($(NO_NET),)
+objs += net-lin.o
+CFLAGS += -pthread
+else
+objs += net-stub.o
+endif
 
+objs += spool-lin.o
+
+# UI=term builds the ANSI terminal frontend instead of the SDL one,
+# UI=headless builds a frontend replaying key presses from a script
+ifeq ($(UI),term)
+objs += ui-term.o
+else
+ifeq ($(UI),headless)
+objs += ui-headless.o
+else
+objs += ui-sdl.o
 libs += -lSDL
+endif
+endif
 
 distfiles += gopherus.svg
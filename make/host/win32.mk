@@ -4,6 +4,7 @@ exeext := .exe
 
 objs += \
 	net-win.o \
+	spool-stub.o \
 	ui-sdl.o \
 	gopherus.res
 
@@ -6,11 +6,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "bookmark.h"
+#include "bufpool.h"
 #include "common.h"
+#include "dnscache.h"
 #include "gopher.h"
 #include "history.h"
+#include "hoststat.h"
 #include "menuview.h"
 #include "parseurl.h"
+#include "preconn.h"
 #include "ui.h"
 #include "wordwrap.h"
 
@@ -18,6 +23,9 @@
 #define GOPHERUS_ITEM_CONT      0    /* continuation of the previous menu item */
 #define GOPHERUS_ITEM_INVALID   0x7F /* malformed menu item */
 
+#define MAXPREFETCH 64 /* hosts of a menu resolved in the background, at most */
+#define PROBE_SLICE 50000l /* usec the bookmarks page waits for its probes before looking at the keyboard again */
+
 /* used by display_menu to tell whether an itemtype is selectable or not */
 static int isitemtypeselectable(char itemtype)
 {
@@ -32,38 +40,123 @@ static int isitemtypeselectable(char itemtype)
     }
 }
 
-int display_menu(struct gopherus *g)
+/* makes room for one more line in a menu. Returns 0 on success. */
+static int addline(struct menu *m)
 {
-    char *cursor;
-    char *line_description[1024];
-    struct url line_url[1024];
-    unsigned char line_description_len[1024];
-    int linecount = 0;
-    char singlelinebuf[128];
-    int *selectedline = &(g->history->displaymemory[0]);
-    int *screenlineoffset = &(g->history->displaymemory[1]);
-    int oldline = -1;
-    int oldoffset = -1;
-    int firstlinkline = -1, lastlinkline = -1;
-    long bufferlen = g->history->cachesize;
+    int newsize = (m->linesize > 0) ? m->linesize * 2 : 64;
+    void *ptr;
 
-    /* copy the history content into buffer - we need to do this because we'll perform changes on the data */
-    memcpy(g->buf, g->history->cache, g->history->cachesize);
-    g->buf[bufferlen] = 0;
+    if (m->linecount < m->linesize)
+        return 0;
+    if (newsize > MENU_MAXLINES)
+        newsize = MENU_MAXLINES;
+    if (m->linecount >= newsize)
+        return -1;
 
-    if (*screenlineoffset < 0)
-        *screenlineoffset = 0;
+    ptr = realloc(m->line_description, newsize * sizeof *m->line_description);
+    if (ptr == NULL)
+        return -1;
+    m->line_description = ptr;
+    ptr = realloc(m->line_url, newsize * sizeof *m->line_url);
+    if (ptr == NULL)
+        return -1;
+    m->line_url = ptr;
+    ptr = realloc(m->line_description_len, newsize * sizeof *m->line_description_len);
+    if (ptr == NULL)
+        return -1;
+    m->line_description_len = ptr;
+    m->linesize = newsize;
+    return 0;
+}
+
+/* adds a replica to the item starting at line. Returns 0 on success. */
+static int addreplica(struct menu *m, int line, const struct url *url)
+{
+    if (m->replicacount == m->replicasize) {
+        int newsize = (m->replicasize > 0) ? m->replicasize * 2 : 8;
+        void *ptr = realloc(m->replica_url, newsize * sizeof *m->replica_url);
+        if (ptr == NULL)
+            return -1;
+        m->replica_url = ptr;
+        ptr = realloc(m->replica_line, newsize * sizeof *m->replica_line);
+        if (ptr == NULL)
+            return -1;
+        m->replica_line = ptr;
+        m->replicasize = newsize;
+    }
+    m->replica_url[m->replicacount] = *url;
+    m->replica_line[m->replicacount] = line;
+    m->replicacount += 1;
+    return 0;
+}
+
+void menu_free(struct menu *m)
+{
+    free(m->line_description);
+    free(m->line_url);
+    free(m->line_description_len);
+    free(m->replica_url);
+    free(m->replica_line);
+    m->line_description = NULL;
+    m->line_url = NULL;
+    m->line_description_len = NULL;
+    m->replica_url = NULL;
+    m->replica_line = NULL;
+    m->linecount = 0;
+    m->linesize = 0;
+    m->replicacount = 0;
+    m->replicasize = 0;
+}
+
+int menu_replicas(const struct menu *m, int line, const struct url **replica)
+{
+    int lo = 0, hi = m->replicacount, first;
+
+    while (lo < hi) { /* the first replica of line, or of a line after it */
+        int mid = (lo + hi) / 2;
+        if (m->replica_line[mid] < line) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    first = lo;
+    while ((lo < m->replicacount) && (m->replica_line[lo] == line))
+        lo++;
+    *replica = (first < m->replicacount) ? &m->replica_url[first] : NULL;
+    return lo - first;
+}
 
-    for (cursor = g->buf; cursor < (g->buf + bufferlen) ;) {
+void menu_parse(struct menu *m, char *buf, long bufferlen, int width)
+{
+    char *cursor;
+    int lastitem = -1; /* the line of the last selectable item, while '+' items may follow it */
+
+    if (width > MENU_MAXWIDTH)
+        width = MENU_MAXWIDTH;
+    m->line_description = NULL;
+    m->line_url = NULL;
+    m->line_description_len = NULL;
+    m->linesize = 0;
+    m->linecount = 0;
+    m->firstlinkline = -1;
+    m->lastlinkline = -1;
+    m->replica_url = NULL;
+    m->replica_line = NULL;
+    m->replicacount = 0;
+    m->replicasize = 0;
+
+    for (cursor = buf; cursor < (buf + bufferlen) ;) {
         char itemtype = *(cursor++);
         int column = 0;
         char *description = cursor;
         char *selector = NULL;
         char *host = NULL;
         char *port = NULL;
+        const char *hostname;
         int endofline = 0;
 
-        for (; cursor < (g->buf + bufferlen); cursor += 1) { /* read the whole line */
+        for (; cursor < (buf + bufferlen); cursor += 1) { /* read the whole line */
             if (*cursor == '\r') continue; /* silently ignore CR chars */
             if ((*cursor == '\t') || (*cursor == '\n')) { /* delimiter */
                 if (*cursor == '\n') endofline = 1;
@@ -84,16 +177,32 @@ int display_menu(struct gopherus *g)
         }
         if (itemtype == '.') continue; /* ignore lines starting by '.' - it's most probably the end of menu terminator */
 
-        if (isitemtypeselectable(itemtype) && !(selector && host))
+        /* items of a menu mostly point to the same few hosts, which are interned */
+        hostname = (host != NULL) ? url_internhost(host, strlen(host)) : NULL;
+        if (isitemtypeselectable(itemtype) && !(selector && hostname))
             itemtype = GOPHERUS_ITEM_INVALID;
 
-        if (linecount < 1024) {
+        /* a redundant server of the item above is not shown, but kept as a replica of it */
+        if ((itemtype == GOPHER_ITEM_REDUNDANT_SERVER) && (lastitem >= 0)) {
+            struct url replica = m->line_url[lastitem];
+            replica.selector = selector;
+            replica.host = hostname;
+            replica.port = port ? atoi(port) : 70;
+            if (replica.port < 1) replica.port = 70;
+            addreplica(m, lastitem, &replica);
+            continue;
+        }
+        lastitem = -1;
+
+        if (addline(m) == 0) {
             char *wrapptr = description;
-            int wraplen;
+            int wraplen, linelen;
+            long next;
             int firstiteration = 0;
             if (isitemtypeselectable(itemtype) != 0) {
-                if (firstlinkline < 0) firstlinkline = linecount;
-                lastlinkline = linecount;
+                if (m->firstlinkline < 0) m->firstlinkline = m->linecount;
+                m->lastlinkline = m->linecount;
+                lastitem = m->linecount;
             }
             for (;; firstiteration += 1) {
                 if ((firstiteration > 0) &&
@@ -102,60 +211,212 @@ int display_menu(struct gopherus *g)
                     itemtype = GOPHERUS_ITEM_CONT;
 
                 if (itemtype == GOPHER_ITEM_INLINE_MSG) {
-                    wraplen = ui_cols;
+                    wraplen = width;
                 } else {
-                    wraplen = ui_cols - 4;
+                    wraplen = width - 4;
                 }
-                line_description[linecount] = wrapptr;
-                wrapptr = wordwrap(singlelinebuf, wrapptr, wraplen);
-                line_description_len[linecount] = strlen(singlelinebuf);
-                line_url[linecount].protocol = PARSEURL_PROTO_GOPHER;
-                line_url[linecount].selector = selector;
-                line_url[linecount].host = host;
-                line_url[linecount].itemtype = itemtype;
+                m->line_description[m->linecount] = wrapptr;
+                next = wordwrap_span(wrapptr, buf + bufferlen - wrapptr, wraplen, &linelen);
+                m->line_description_len[m->linecount] = linelen;
+                m->line_url[m->linecount].protocol = PARSEURL_PROTO_GOPHER;
+                m->line_url[m->linecount].selector = selector;
+                m->line_url[m->linecount].host = hostname;
+                m->line_url[m->linecount].itemtype = itemtype;
                 if (port) {
-                    line_url[linecount].port = atoi(port);
-                    if (line_url[linecount].port < 1) line_url[linecount].port = 70;
+                    m->line_url[m->linecount].port = atoi(port);
+                    if (m->line_url[m->linecount].port < 1) m->line_url[m->linecount].port = 70;
                 } else {
-                    line_url[linecount].port = 70;
+                    m->line_url[m->linecount].port = 70;
                 }
-                linecount += 1;
-                if (wrapptr == NULL) break;
-                if (linecount >= 1024) break;
+                m->linecount += 1;
+                if (next < 0) break;
+                wrapptr += next;
+                if (addline(m) != 0) break;
             }
         }
     }
 
     /* trim out the last line if its starting with a '.' (gopher's end of menu marker) */
-    if (linecount > 0) {
-        if (line_url[linecount - 1].itemtype == '.') linecount -= 1;
+    if (m->linecount > 0) {
+        if (m->line_url[m->linecount - 1].itemtype == '.') m->linecount -= 1;
+    }
+}
+
+/* resolves the hosts the items of a menu point to in the background, so
+ * that following a link to another server does not wait for it. Hosts
+ * are interned, so telling them apart is cheap. */
+static void prefetch_hosts(const struct menu *m)
+{
+    const char *seen[MAXPREFETCH];
+    int seencount = 0, y, i;
+
+    for (y = 0; (y < m->linecount + m->replicacount) && (seencount < MAXPREFETCH); y++) {
+        const struct url *url = (y < m->linecount) ? &m->line_url[y] : &m->replica_url[y - m->linecount];
+        if (!isitemtypeselectable(url->itemtype) || (url->host[0] == '#'))
+            continue;
+        for (i = 0; (i < seencount) && (seen[i] != url->host); i++);
+        if (i < seencount)
+            continue;
+        seen[seencount++] = url->host;
+        dnscache_prefetch(url->host);
+    }
+}
+
+/* returns the server that would be asked first for the link on a line (see
+ * loadfile.h), or NULL if the line is not a link to a server */
+static const struct url *firstserver(const struct menu *m, int line)
+{
+    const struct url *best = &m->line_url[line];
+    const struct url *replica;
+    int replicacount, i;
+
+    if ((best->protocol == PARSEURL_PROTO_UNKNOWN) || (best->host[0] == '#'))
+        return NULL;
+    replicacount = menu_replicas(m, line, &replica);
+    for (i = 0; i < replicacount; i++)
+        if (hoststat_cost(replica[i].host, replica[i].port) < hoststat_cost(best->host, best->port))
+            best = &replica[i];
+    return best;
+}
+
+static void free_menu(void *ptr)
+{
+    menu_free(ptr);
+    free(ptr);
+}
+
+/* parses the menu of a location, right in its cache, so that it is done
+ * once. Returns NULL if out of memory. */
+static struct menu *make_menu(struct historytype *node)
+{
+    struct menu *m;
+
+    /* a menu shows MENU_MAXLINES lines at most, so of a spooled one that is
+     * too large for memory, only what fits in a buffer is kept */
+    if (node->spool != NULL) {
+        long len = (node->cachesize < BUFPOOL_MAXSIZE) ? node->cachesize : BUFPOOL_MAXSIZE - 1;
+        char *buf = bufpool_alloc(len + 1);
+        if (buf == NULL)
+            return NULL;
+        memcpy(buf, node->cache, len);
+        buf[len] = 0;
+        history_freecache(node);
+        node->cache = buf;
+        node->cachesize = len;
+    }
+
+    m = malloc(sizeof *m);
+    if (m == NULL)
+        return NULL;
+    menu_parse(m, node->cache, node->cachesize, ui_cols);
+    return m;
+}
+
+/* makes the menu of a location, and keeps it as the display-ready form of
+ * the location. Returns NULL if out of memory. */
+static struct menu *setup_menu(struct historytype *node)
+{
+    struct menu *m = make_menu(node);
+
+    if (m == NULL)
+        return NULL;
+    node->display = m;
+    node->display_free = free_menu;
+    node->displaysize = sizeof *m + m->linesize *
+        (sizeof *m->line_description + sizeof *m->line_url + sizeof *m->line_description_len) +
+        m->replicasize * (sizeof *m->replica_url + sizeof *m->replica_line);
+    return m;
+}
+
+/* builds the bookmarks page again, once it tells something new, and makes
+ * its menu. The selected line is kept, if it is still there. Returns NULL if
+ * out of memory. */
+static struct menu *rebuild_bookmarks(struct historytype *node)
+{
+    struct menu *m;
+    char *buf = bufpool_alloc(BUFPOOL_MINSIZE);
+    long len;
+
+    if (buf == NULL)
+        return NULL;
+    len = bookmark_page(buf, bufpool_size(buf) - 1);
+    if (len > bufpool_size(buf) - 1) {
+        bufpool_free(buf);
+        buf = bufpool_alloc(len + 1);
+        if (buf == NULL)
+            return NULL;
+        bookmark_page(buf, len);
+    }
+    buf[len] = 0;
+    history_freecache(node);
+    node->cache = buf;
+    node->cachesize = len;
+
+    m = setup_menu(node);
+    if (m == NULL)
+        return NULL;
+    if (node->displaymemory[0] > m->lastlinkline)
+        node->displaymemory[0] = m->lastlinkline;
+    return m;
+}
+
+int display_menu(struct gopherus *g)
+{
+    struct menu *m = g->history->display;
+    int *selectedline = &(g->history->displaymemory[0]);
+    int *screenlineoffset = &(g->history->displaymemory[1]);
+    int oldline = -1;
+    int oldoffset = -1;
+    int preconnline = -1; /* the line whose server got connected in advance */
+    int keepstatus = 0;   /* non-zero if the status bar tells something else than the selected link */
+    unsigned int rows = ui_rows, cols = ui_cols; /* the screen the menu is drawn on */
+
+    if (m == NULL) { /* the first time the location is displayed */
+        m = setup_menu(g->history);
+        if (m == NULL) {
+            set_statusbar(g->statusbar, "!Out of memory");
+            return DISPLAY_ORDER_BACK;
+        }
+        if (g->cfg.offline == NULL)
+            prefetch_hosts(m);
     }
 
+    if (*screenlineoffset < 0)
+        *screenlineoffset = 0;
+
     /* if there is at least one position, and nothing is selected yet, make it active */
-    if ((firstlinkline >= 0) && (*selectedline < 0))
-        *selectedline = firstlinkline;
+    if ((m->firstlinkline >= 0) && (*selectedline < 0))
+        *selectedline = m->firstlinkline;
+
+    /* the screen may have shrunk since the menu was shown last */
+    if (*selectedline > *screenlineoffset + ((int)ui_rows - 3))
+        *screenlineoffset = *selectedline - (ui_rows - 3);
 
     for (;;) {
         int keypress;
 
+        if ((ui_rows != rows) || (ui_cols != cols)) /* the screen got resized */
+            return DISPLAY_ORDER_NONE;
+
         if (*selectedline != oldline || *screenlineoffset != oldoffset) {
             int y;
 
             /* if any position is selected, print the url in status bar */
-            if (*selectedline >= 0) {
+            if ((*selectedline >= 0) && (keepstatus == 0)) {
                 char url_str[512];
-                build_url(url_str, sizeof url_str, &line_url[*selectedline]);
+                build_url(url_str, sizeof url_str, &m->line_url[*selectedline]);
                 set_statusbar(g->statusbar, url_str);
             }
+            keepstatus = 0;
 
             /* start drawing lines of the menu */
             for (y = *screenlineoffset; y < *screenlineoffset + ((int)ui_rows - 2); y++) {
-                if (y < linecount) {
+                if (y < m->linecount) {
                     int attr;
                     int xshift = 0;
                     const char *prefix = NULL;
 
-                    switch (line_url[y].itemtype) {
+                    switch (m->line_url[y].itemtype) {
                         case GOPHER_ITEM_INLINE_MSG: /* message */
                             break;
                         case GOPHER_ITEM_HTML: /* html */
@@ -206,21 +467,21 @@ int display_menu(struct gopherus *g)
 
                     if (y == *selectedline)
                         attr = g->cfg.attr_menucurrent;
-                    else if (line_url[y].itemtype == GOPHER_ITEM_ERROR)
+                    else if (m->line_url[y].itemtype == GOPHER_ITEM_ERROR)
                         attr = g->cfg.attr_menuerr;
-                    else if (isitemtypeselectable(line_url[y].itemtype))
+                    else if (isitemtypeselectable(m->line_url[y].itemtype))
                         attr = g->cfg.attr_menuselectable;
                     else
                         attr = g->cfg.attr_textnorm;
 
                     /* print the the line's description */
-                    draw_field(line_description[y],
+                    draw_field(m->line_description[y],
                             attr,
                             xshift,
                             1 + (y - *screenlineoffset),
                             ui_cols - xshift,
-                            line_description_len[y]);
-                } else { /* y >= linecount */
+                            m->line_description_len[y]);
+                } else { /* y >= m->linecount */
                     unsigned int x;
                     for (x = 0; x < ui_cols; x++)
                         ui_putchar(' ', g->cfg.attr_textnorm, x, 1 + (y - *screenlineoffset));
@@ -233,46 +494,78 @@ int display_menu(struct gopherus *g)
             oldoffset = *screenlineoffset;
         }
 
+        /* the bookmarks page tells how its servers answer as the probes come back, and keys are
+           looked at in between */
+        if (bookmark_ispage(&g->history->url) && bookmark_probing() && (ui_waitkey(0) == 0)) {
+            if (bookmark_poll(PROBE_SLICE) != 0) {
+                m = rebuild_bookmarks(g->history);
+                if (m == NULL) {
+                    set_statusbar(g->statusbar, "!Out of memory");
+                    return DISPLAY_ORDER_BACK;
+                }
+                oldline = -1;
+                keepstatus = 1;
+            }
+            continue;
+        }
+
+        /* once the selection rests on a link for a while, its server gets connected in advance */
+        if ((*selectedline >= 0) && (*selectedline != preconnline) && (g->cfg.preconnect >= 0)) {
+            const struct url *server = firstserver(m, *selectedline);
+            preconn_keep(server);
+            if ((server == NULL) || (ui_waitkey(g->cfg.preconnect * 1000l) == 0)) {
+                if (server != NULL)
+                    preconn_start(server);
+                preconnline = *selectedline;
+            }
+        }
+
         /* wait for keypress */
         keypress = ui_getkey();
 
         switch (keypress) {
             case KEY_BACKSPACE:
+                preconn_keep(NULL);
                 return DISPLAY_ORDER_BACK;
             case KEY_TAB:
-                if (edit_url(&(g->history), &(g->cfg)) == 0) return DISPLAY_ORDER_NONE;
+                if (edit_url(&(g->history), &(g->cfg)) == 0) {
+                    preconn_keep(NULL);
+                    return DISPLAY_ORDER_NONE;
+                }
                 break;
             case KEY_F9:
             case KEY_ENTER:
                 if (*selectedline >= 0) {
-                    if ((line_url[*selectedline].itemtype == GOPHER_ITEM_INDEX_SEARCH_SERVER) && (keypress != KEY_F9)) { /* a query needs to be issued */
+                    if ((m->line_url[*selectedline].itemtype == GOPHER_ITEM_INDEX_SEARCH_SERVER) && (keypress != KEY_F9)) { /* a query needs to be issued */
                         char query[64];
                         char *finalselector;
                         sprintf(query, "Enter a query: ");
                         draw_statusbar(query, &(g->cfg));
                         query[0] = 0;
                         if (editstring(query, 64, 64, 15, ui_rows - 1, g->cfg.attr_statusbarinfo, NULL) == 0) break;
-                        finalselector = malloc(strlen(line_url[*selectedline].selector) + strlen(query) + 2); /* add 1 for the TAB, and 1 for the NULL terminator */
+                        finalselector = malloc(strlen(m->line_url[*selectedline].selector) + strlen(query) + 2); /* add 1 for the TAB, and 1 for the NULL terminator */
                         if (finalselector == NULL) {
                             set_statusbar(g->statusbar, "Out of memory");
                             break;
                         } else {
-                            struct url final_url = line_url[*selectedline];
-                            sprintf(finalselector, "%s\t%s", line_url[*selectedline].selector, query);
+                            struct url final_url = m->line_url[*selectedline];
+                            sprintf(finalselector, "%s\t%s", m->line_url[*selectedline].selector, query);
                             final_url.selector = finalselector;
                             history_add(&(g->history), &final_url);
                             free(finalselector);
                             return DISPLAY_ORDER_NONE;
                         }
-                    } else if (line_url[*selectedline].protocol != PARSEURL_PROTO_UNKNOWN) {
+                    } else if (m->line_url[*selectedline].protocol != PARSEURL_PROTO_UNKNOWN) {
                         /* itemtype is anything else than type 7 */
-                        struct url next_url = line_url[*selectedline];
+                        struct url next_url = m->line_url[*selectedline];
+                        const struct url *replica;
+                        int replicacount = menu_replicas(m, *selectedline, &replica);
 
                         /* force the itemtype to 'binary' if 'save as' was requested */
                         if (keypress == KEY_F9)
                             next_url.itemtype = GOPHER_ITEM_BINARY;
 
-                        history_add(&(g->history), &next_url);
+                        history_add_replicas(&(g->history), &next_url, replica, replicacount);
                         return DISPLAY_ORDER_NONE;
                     } else {
                         set_statusbar(g->statusbar, "!Unknown protocol");
@@ -280,20 +573,49 @@ int display_menu(struct gopherus *g)
                 }
                 break;
             case KEY_ESCAPE:
-                if (ask_quit_confirmation(&(g->cfg)) != 0) return DISPLAY_ORDER_QUIT;
+                if (ask_quit_confirmation(&(g->cfg)) != 0) {
+                    preconn_keep(NULL);
+                    return DISPLAY_ORDER_QUIT;
+                }
                 break;
             case KEY_F1: /* help */
+                preconn_keep(NULL);
                 go_to_help(g);
                 return DISPLAY_ORDER_NONE;
+            case KEY_F2: /* bookmarks */
+                if (bookmark_ispage(&g->history->url))
+                    break;
+                preconn_keep(NULL);
+                go_to_bookmarks(g);
+                return DISPLAY_ORDER_NONE;
             case KEY_F5: /* refresh */
+                preconn_keep(NULL);
                 return DISPLAY_ORDER_REFR;
+            case 'b': /* bookmark the selected link */
+                if (*selectedline >= 0) {
+                    bookmark_add(&m->line_url[*selectedline], m->line_description[*selectedline], m->line_description_len[*selectedline], g->statusbar);
+                    draw_statusbar(g->statusbar, &(g->cfg));
+                }
+                continue;
+            case KEY_DELETE: /* remove the selected bookmark, on the bookmarks page */
+                if (!bookmark_ispage(&g->history->url) || (*selectedline < 0))
+                    continue;
+                bookmark_remove(&m->line_url[*selectedline], g->statusbar);
+                m = rebuild_bookmarks(g->history);
+                if (m == NULL) {
+                    set_statusbar(g->statusbar, "!Out of memory");
+                    return DISPLAY_ORDER_BACK;
+                }
+                oldline = -1;
+                keepstatus = 1;
+                break;
             case KEY_HOME:
-                if (*selectedline >= 0) *selectedline = firstlinkline;
+                if (*selectedline >= 0) *selectedline = m->firstlinkline;
                 *screenlineoffset = 0;
                 break;
             case KEY_UP:
-                if (*selectedline > firstlinkline) {
-                    while (isitemtypeselectable(line_url[--(*selectedline)].itemtype) == 0); /* select the next item that is selectable */
+                if (*selectedline > m->firstlinkline) {
+                    while (isitemtypeselectable(m->line_url[--(*selectedline)].itemtype) == 0); /* select the next item that is selectable */
                 } else {
                     if (*screenlineoffset > 0) *screenlineoffset -= 1;
                     continue; /* do not force the selected line to be on screen */
@@ -302,12 +624,12 @@ int display_menu(struct gopherus *g)
             case KEY_PAGEUP:
                 if (*selectedline >= 0) {
                     *selectedline -= (ui_rows - 3);
-                    if (*selectedline < firstlinkline) *selectedline = firstlinkline;
+                    if (*selectedline < m->firstlinkline) *selectedline = m->firstlinkline;
                 }
                 break;
             case KEY_END:
-                if (*selectedline >= 0) *selectedline = lastlinkline;
-                *screenlineoffset = linecount - (ui_rows - 3);
+                if (*selectedline >= 0) *selectedline = m->lastlinkline;
+                *screenlineoffset = m->linecount - (ui_rows - 3);
                 if (*screenlineoffset < 0) *screenlineoffset = 0;
                 break;
             case KEY_DOWN:
@@ -315,20 +637,21 @@ int display_menu(struct gopherus *g)
                     *screenlineoffset += 1;
                     continue;
                 }
-                if (*selectedline < lastlinkline) {
-                    while (isitemtypeselectable(line_url[++(*selectedline)].itemtype) == 0); /* select the next item that is selectable */
+                if (*selectedline < m->lastlinkline) {
+                    while (isitemtypeselectable(m->line_url[++(*selectedline)].itemtype) == 0); /* select the next item that is selectable */
                 } else {
-                    if (*screenlineoffset < linecount - ((int)ui_rows - 3)) *screenlineoffset += 1;
+                    if (*screenlineoffset < m->linecount - ((int)ui_rows - 3)) *screenlineoffset += 1;
                     continue; /* do not force the selected line to be on screen */
                 }
                 break;
             case KEY_PAGEDOWN:
                 if (*selectedline >= 0) {
                     *selectedline += (ui_rows - 3);
-                    if (*selectedline > lastlinkline) *selectedline = lastlinkline;
+                    if (*selectedline > m->lastlinkline) *selectedline = m->lastlinkline;
                 }
                 break;
             case KEY_QUIT: /* quit immediately */
+                preconn_keep(NULL);
                 return 1;
             default:
                 /* sprintf(singlelinebuf, "Got unknown key press: 0x%02X", keypress);
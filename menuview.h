@@ -7,6 +7,40 @@
 #define MENUVIEW_H
 
 #include "common.h"
+#include "parseurl.h"
+
+#define MENU_MAXLINES 1024
+#define MENU_MAXWIDTH 255 /* menus are not wrapped wider than that */
+
+/* lines of a menu, which refer to the gophermap they come from */
+struct menu {
+    char **line_description;
+    struct url *line_url;
+    unsigned short *line_description_len;
+    int linecount;
+    int linesize;       /* number of allocated lines */
+    int firstlinkline;  /* first selectable line, or -1 if none */
+    int lastlinkline;   /* last selectable line, or -1 if none */
+    struct url *replica_url;  /* redundant servers ('+' items) of the items */
+    int *replica_line;        /* line of the item each one serves, in increasing order */
+    int replicacount;
+    int replicasize;          /* number of allocated replicas */
+};
+
+/* parses the gophermap in buf (bufferlen bytes followed by a NUL
+ * terminator, modified in place) into menu lines, wrapping descriptions for
+ * a screen of width columns. Redundant servers ('+' items) are not shown,
+ * but kept as replicas of the item they follow. Lines are allocated as
+ * needed, and must be freed with menu_free(). If out of memory, the menu
+ * ends where it got. */
+void menu_parse(struct menu *m, char *buf, long bufferlen, int width);
+
+/* frees the lines of a menu */
+void menu_free(struct menu *m);
+
+/* returns the number of replicas of the item starting at line, and sets
+ * *replica to the first of them */
+int menu_replicas(const struct menu *m, int line, const struct url **replica);
 
 int display_menu(struct gopherus *g);
 
@@ -0,0 +1,831 @@
+/*
+ * This file is part of the Gopherus project.
+ *
+ * Mirrors a gopher hole to disk. Starting from a menu, the menus and text
+ * files it leads to are fetched, a few at once, and kept in files named
+ * after their selectors. The links of the menus are found by menu_parse(),
+ * as they are for display, and each resource is fetched once: the ones met
+ * already are found in a hash table. Servers are asked politely, their
+ * requests starting some time apart, and given up on past the deadlines
+ * learnt from how fast they are (see hoststat.h).
+ */
+
+#include <ctype.h>     /* tolower() */
+#include <signal.h>    /* signal(), SIGINT */
+#include <stdio.h>     /* FILE, printf(), rename() */
+#include <stdlib.h>    /* malloc(), realloc(), atoi() */
+#include <string.h>
+#include <unistd.h>    /* usleep() */
+#include <sys/time.h>  /* gettimeofday() */
+#ifdef __MINGW32__
+#include <io.h>        /* mkdir() */
+#define makedir(path) mkdir(path)
+#else
+#include <sys/stat.h>  /* mkdir() */
+#define makedir(path) mkdir(path, 0777)
+#endif
+#include "bufpool.h"
+#include "common.h"
+#include "dnscache.h"
+#include "gopher.h"
+#include "hoststat.h"
+#include "loadfile.h"
+#include "menuview.h"
+#include "mirror.h"
+#include "net.h"
+#include "parseurl.h"
+
+#define MAXJOBS 16
+#define MAXTRIES 2              /* requests for a resource in a run, before it is given up on */
+#define SCANAHEAD 64            /* queued resources looked at for one whose server may be asked now */
+#define WAIT_SLICE 20000l       /* usec waited for the connections at once, before looking at the queue again */
+#define STATUS_INTERVAL 5000000l /* usec between two reports of how the mirroring goes */
+#define CHUNKSIZE 16384l        /* bytes received at once */
+#define JOURNAL "journal"       /* the journal, in the directory of the mirror */
+
+/* how the mirroring of a resource goes */
+#define ITEM_QUEUED 0
+#define ITEM_FETCHING 1
+#define ITEM_DONE 2
+#define ITEM_FAILED 3  /* given up on, until the next run */
+
+/* a resource met in a menu */
+struct item {
+    char *selector;
+    const char *host;    /* interned */
+    unsigned short port;
+    char itemtype;
+    char state;
+    char tries;
+    int depth;           /* links followed from the start to get there */
+    int server;          /* its entry in server_table */
+    unsigned long hash;
+};
+
+/* a server of the resources, whose requests start some time apart */
+struct server {
+    const char *host;    /* interned */
+    unsigned short port;
+    struct timeval next; /* no request to it starts before then */
+    unsigned long ipaddr; /* 0 until its host is resolved */
+    int unknown;         /* non-zero if its host could not be resolved */
+};
+
+/* the fetching of a resource */
+struct job {
+    int item;
+    struct net_tcpsocket *sk;
+    struct timeval start;
+    struct timeval last;  /* when the request was sent, or the last bytes came */
+    struct timeval first; /* when the first bytes came */
+    long connect;         /* usec connecting took, -1 until connected */
+    long deadline;        /* usec to wait since start until connected, or else since last, before giving up */
+    long longestgap;
+    long len;             /* bytes received */
+    int menustate;        /* where a menu is at, as loadfile_findterminator() tracks it */
+    char *menu;           /* what came of a menu, to follow its links, or NULL */
+    FILE *fd;             /* the file it is received into, renamed once complete */
+    char path[MIRROR_MAXPATH];
+};
+
+static struct item *item_table;
+static int itemcount, itemsize;
+static int *hash_table;  /* open addressing, items as their index + 1 (0 for a free slot), at most half full */
+static int hashsize;     /* a power of 2 */
+static struct server *server_table;
+static int servercount, serversize;
+static struct job job_table[MAXJOBS];
+static int jobcount;
+static int firstqueued;  /* no item before it is queued */
+static long queuedcount, donecount, failedcount, bytecount;
+static volatile sig_atomic_t interrupted; /* set on SIGINT */
+static const char *mirrordir;
+static const struct url *origin;
+static FILE *journal;
+static char *chunk;
+
+/* appends to the path of pos chars the len chars of name, as a name that
+ * any file system takes: chars other than letters, digits, '-', '_' and
+ * '.' are written as %XX, and so are the dots of a name made only of them,
+ * such as "..". An empty name is written as "%". Returns the new length of
+ * path, or -1 if it does not fit in size bytes. */
+static long addname(char *path, long pos, long size, const char *name, long len, int lowercase)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    int dotsonly = 1;
+    long i;
+
+    for (i = 0; i < len; i++)
+        if (name[i] != '.')
+            dotsonly = 0;
+    if (len == 0) {
+        if (pos + 1 >= size)
+            return -1;
+        path[pos++] = '%';
+    }
+    for (i = 0; i < len; i++) {
+        unsigned char c = name[i];
+        if (pos + 3 >= size)
+            return -1;
+        if (lowercase)
+            c = tolower(c);
+        if (((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z')) || ((c >= '0') && (c <= '9')) ||
+            (c == '-') || (c == '_') || ((c == '.') && !dotsonly)) {
+            path[pos++] = c;
+        } else {
+            path[pos++] = '%';
+            path[pos++] = hex[c >> 4];
+            path[pos++] = hex[c & 15];
+        }
+    }
+    path[pos] = 0;
+    return pos;
+}
+
+/* the server makes a directory of the mirror, and each part of the selector
+ * a directory in it, where the resource is the file named after its item
+ * type: "@1" if the selector starts with a '/', "=1" otherwise. No other
+ * file has such a name, nor the same path. */
+int mirror_path(char *path, size_t size, const char *dir, const struct url *url)
+{
+    const char *selector = url->selector;
+    const char *end;
+    char server[16];
+    long pos = strlen(dir);
+    int slash = (selector[0] == '/');
+
+    if ((url->protocol != PARSEURL_PROTO_GOPHER) || (url->host[0] == 0) || (url->host[0] == '#'))
+        return -1;
+    if (pos + 1 >= (long)size)
+        return -1;
+    memcpy(path, dir, pos);
+    path[pos++] = '/';
+    pos = addname(path, pos, size, url->host, strlen(url->host), 1);
+    sprintf(server, "_%u/", (unsigned)url->port);
+    if ((pos < 0) || (pos + (long)strlen(server) >= (long)size))
+        return -1;
+    strcpy(path + pos, server);
+    pos += strlen(server);
+
+    for (selector += slash; *selector != 0; selector = (*end != 0) ? end + 1 : end) {
+        end = strchr(selector, '/');
+        if (end == NULL)
+            end = selector + strlen(selector);
+        pos = addname(path, pos, size, selector, end - selector, 0);
+        if ((pos < 0) || (pos + 1 >= (long)size))
+            return -1;
+        path[pos++] = '/';
+        if ((*end != 0) && (end[1] == 0)) { /* a trailing '/' leaves an empty name after it */
+            pos = addname(path, pos, size, end + 1, 0, 0);
+            if ((pos < 0) || (pos + 1 >= (long)size))
+                return -1;
+            path[pos++] = '/';
+        }
+    }
+    if (pos + 3 > (long)size)
+        return -1;
+    path[pos++] = slash ? '@' : '=';
+    path[pos++] = url->itemtype;
+    path[pos] = 0;
+    return 0;
+}
+
+/* makes the directories of path that follow its first skip chars */
+static void makedirs(char *path, size_t skip)
+{
+    char *p;
+
+    for (p = path + skip; (p = strchr(p, '/')) != NULL; p++) {
+        *p = 0;
+        makedir(path);
+        *p = '/';
+    }
+}
+
+/* writes in part the path a resource is received into, until complete */
+static void partpath(char *part, const char *path)
+{
+    sprintf(part, "%s.part", path);
+}
+
+#define FNV(hash, c) ((((hash) ^ (unsigned char)(c)) * 16777619ul) & 0xFFFFFFFFul)
+
+/* returns a hash of a resource (FNV-1a). The host is hashed regardless of
+ * case, as it is interned. */
+static unsigned long itemhash(const char *host, unsigned short port, char itemtype, const char *selector)
+{
+    unsigned long hash = 2166136261ul;
+
+    for (; *host != 0; host++)
+        hash = FNV(hash, tolower((unsigned char)*host));
+    hash = FNV(hash, port >> 8);
+    hash = FNV(hash, port & 0xFF);
+    hash = FNV(hash, itemtype);
+    for (; *selector != 0; selector++)
+        hash = FNV(hash, *selector);
+    return hash;
+}
+
+/* doubles the size of the hash table. Returns 0 on success. */
+static int growhash(void)
+{
+    int newsize = (hashsize > 0) ? hashsize * 2 : 256;
+    int *newtable = calloc(newsize, sizeof *newtable);
+    int i;
+
+    if (newtable == NULL)
+        return -1;
+    for (i = 0; i < itemcount; i++) {
+        int slot = item_table[i].hash & (newsize - 1);
+        while (newtable[slot] != 0)
+            slot = (slot + 1) & (newsize - 1);
+        newtable[slot] = i + 1;
+    }
+    free(hash_table);
+    hash_table = newtable;
+    hashsize = newsize;
+    return 0;
+}
+
+/* returns the slot of the hash table of a resource: the one it is in, or
+ * else the free one it goes to */
+static int findslot(const char *host, unsigned short port, char itemtype, const char *selector, unsigned long hash)
+{
+    int slot;
+
+    for (slot = hash & (hashsize - 1); hash_table[slot] != 0; slot = (slot + 1) & (hashsize - 1)) {
+        const struct item *it = &item_table[hash_table[slot] - 1];
+        if ((it->hash == hash) && (it->host == host) && (it->port == port) && (it->itemtype == itemtype) &&
+            (strcmp(it->selector, selector) == 0))
+            break;
+    }
+    return slot;
+}
+
+/* returns the entry of a server, added on first use, or -1 if out of memory */
+static int findserver(const char *host, unsigned short port)
+{
+    int i;
+
+    for (i = 0; i < servercount; i++)
+        if ((server_table[i].host == host) && (server_table[i].port == port))
+            return i;
+    if (servercount == serversize) {
+        int newsize = (serversize > 0) ? serversize * 2 : 8;
+        void *ptr = realloc(server_table, newsize * sizeof *server_table);
+        if (ptr == NULL)
+            return -1;
+        server_table = ptr;
+        serversize = newsize;
+    }
+    server_table[servercount].host = host;
+    server_table[servercount].port = port;
+    server_table[servercount].ipaddr = 0;
+    server_table[servercount].unknown = 0;
+    gettimeofday(&server_table[servercount].next, NULL);
+    dnscache_prefetch(host); /* so that it is known once its turn comes */
+    return servercount++;
+}
+
+/* queues a resource, unless it has been met already, and writes it down in
+ * the journal if journaled. Returns its index, or -1 if it has been met
+ * already or if out of memory. */
+static int additem(const char *host, unsigned short port, char itemtype, const char *selector, int depth, int journaled)
+{
+    unsigned long hash = itemhash(host, port, itemtype, selector);
+    size_t len = strlen(selector);
+    struct item *it;
+    int slot;
+
+    if (((itemcount + 1) * 2 > hashsize) && (growhash() != 0))
+        return -1;
+    slot = findslot(host, port, itemtype, selector, hash);
+    if (hash_table[slot] != 0)
+        return -1;
+    if (itemcount == itemsize) {
+        int newsize = (itemsize > 0) ? itemsize * 2 : 256;
+        void *ptr = realloc(item_table, newsize * sizeof *item_table);
+        if (ptr == NULL)
+            return -1;
+        item_table = ptr;
+        itemsize = newsize;
+    }
+    it = &item_table[itemcount];
+    it->server = findserver(host, port);
+    it->selector = malloc(len + 1);
+    if ((it->server < 0) || (it->selector == NULL)) {
+        free(it->selector);
+        return -1;
+    }
+    memcpy(it->selector, selector, len + 1);
+    it->host = host;
+    it->port = port;
+    it->itemtype = itemtype;
+    it->state = ITEM_QUEUED;
+    it->tries = 0;
+    it->depth = depth;
+    it->hash = hash;
+    hash_table[slot] = ++itemcount;
+    queuedcount += 1;
+    if (journaled)
+        fprintf(journal, "+%c%s\t%s\t%u\t%d\n", itemtype, selector, host, (unsigned)port, depth);
+    return itemcount - 1;
+}
+
+/* goes through the journal of an earlier run, to queue again what it did
+ * not fetch. Each line tells a resource that got queued ('+'), with how
+ * deep it is, or fetched ('-'): the op, the item type and the selector,
+ * then the host, port and depth, separated by tabs. Returns non-zero if the
+ * journal ends with an incomplete line, that the run got interrupted in. */
+static int replay(const char *path)
+{
+    static char line[MIRROR_MAXPATH * 2];
+    FILE *fd = fopen(path, "rb");
+    int complete = 1;
+
+    if (fd == NULL)
+        return 0;
+    while (fgets(line, sizeof line, fd) != NULL) {
+        char *field[4];
+        const char *host;
+        int count = 1, slot;
+        char *p;
+
+        complete = (strchr(line, '\n') != NULL);
+        if (!complete) { /* too long for the buffer: skipped */
+            int c;
+            while (((c = fgetc(fd)) != EOF) && (c != '\n'));
+            complete = (c == '\n');
+            continue;
+        }
+        line[strcspn(line, "\r\n")] = 0;
+        field[0] = line;
+        for (p = line; (*p != 0) && (count < 4); p++) {
+            if (*p == '\t') {
+                *p = 0;
+                field[count++] = p + 1;
+            }
+        }
+        if ((count < 3) || (line[0] == 0) || (line[1] == 0) || (field[1][0] == 0))
+            continue;
+        host = url_internhost(field[1], strlen(field[1]));
+        if (host == NULL)
+            break;
+        if ((line[0] == '+') && (count == 4)) {
+            additem(host, (unsigned short)atoi(field[2]), line[1], line + 2, atoi(field[3]), 0);
+        } else if ((line[0] == '-') && (hashsize > 0)) {
+            unsigned short port = atoi(field[2]);
+            slot = findslot(host, port, line[1], line + 2, itemhash(host, port, line[1], line + 2));
+            if ((hash_table[slot] != 0) && (item_table[hash_table[slot] - 1].state == ITEM_QUEUED)) {
+                item_table[hash_table[slot] - 1].state = ITEM_DONE;
+                queuedcount -= 1;
+            }
+        }
+    }
+    fclose(fd);
+    return !complete;
+}
+
+/* prints how the mirroring of a resource went */
+static void logitem(const struct item *it, const char *how)
+{
+    char line[512];
+    struct url url;
+
+    url.host = it->host;
+    url.selector = it->selector;
+    url.port = it->port;
+    url.protocol = PARSEURL_PROTO_GOPHER;
+    url.itemtype = it->itemtype;
+    build_url(line, sizeof line, &url);
+    printf("%12s  %s\n", how, line);
+}
+
+/* follows the links to menus and text files of the len bytes of a menu,
+ * that is depth links away from the start */
+static void followlinks(char *buf, long len, int depth, const struct mirrorlimits *limits)
+{
+    char *end = buf + len;
+
+    /* a menu has MENU_MAXLINES lines at most, so a long one is parsed a few
+     * lines at a time */
+    while (buf < end) {
+        struct menu m;
+        char *cut = buf;
+        char next;
+        int n, y;
+
+        for (n = 0; (n < MENU_MAXLINES / 2) && (cut < end); n++) {
+            cut = memchr(cut, '\n', end - cut);
+            cut = (cut != NULL) ? cut + 1 : end;
+        }
+        next = *cut;
+        *cut = 0;
+        menu_parse(&m, buf, cut - buf, MENU_MAXWIDTH);
+        for (y = 0; y < m.linecount; y++) {
+            const struct url *url = &m.line_url[y];
+            if ((url->itemtype != GOPHER_ITEM_FILE) && (url->itemtype != GOPHER_ITEM_DIR))
+                continue;
+            if ((url->host[0] == 0) || (url->host[0] == '#'))
+                continue;
+            if (!limits->span && ((url->host != origin->host) || (url->port != origin->port)))
+                continue;
+            additem(url->host, url->port, url->itemtype, url->selector, depth + 1, 1);
+        }
+        menu_free(&m);
+        *cut = next;
+        buf = cut;
+    }
+}
+
+/* returns non-zero once the host of a server is resolved, or is known not
+ * to be. It is resolved in the background, and waited for meanwhile, but
+ * where names cannot be resolved in the background at all. */
+static int resolved(struct server *s)
+{
+    if ((s->ipaddr != 0) || s->unknown)
+        return 1;
+    s->ipaddr = dnscache_ask(s->host);
+    if (s->ipaddr != 0)
+        return 1;
+    if (dnscache_failed(s->host)) {
+        s->unknown = 1;
+        return 1;
+    }
+    if (dnscache_prefetch(s->host) >= 0) /* being resolved, or soon */
+        return 0;
+
+    s->ipaddr = net_dnsresolve(s->host);
+    dnscache_add(s->host, s->ipaddr);
+    s->unknown = (s->ipaddr == 0);
+    return 1;
+}
+
+/* returns a queued resource whose server may be asked now, or -1 if none */
+static int nextitem(void)
+{
+    int looked = 0, i;
+
+    while ((firstqueued < itemcount) && (item_table[firstqueued].state != ITEM_QUEUED))
+        firstqueued++;
+    for (i = firstqueued; (i < itemcount) && (looked < SCANAHEAD); i++) {
+        struct server *s;
+        if (item_table[i].state != ITEM_QUEUED)
+            continue;
+        looked += 1;
+        s = &server_table[item_table[i].server];
+        if (s->unknown || (due(&s->next) && resolved(s)))
+            return i;
+    }
+    return -1;
+}
+
+/* ends the j-th job: the resource is kept if complete, or else asked for
+ * again later, unless it has been tried too often already */
+static void endjob(int j, int complete, const struct mirrorlimits *limits)
+{
+    struct job *job = &job_table[j];
+    struct item *it = &item_table[job->item];
+    char part[MIRROR_MAXPATH + 8];
+    char how[32];
+
+    partpath(part, job->path);
+    if (complete) {
+        hoststat_measure(it->host, it->port, HOSTSTAT_STALL, job->longestgap);
+        if (job->len > 0)
+            hoststat_transfer(it->host, it->port, job->len, usec_since(&job->first));
+        net_close(job->sk);
+        remove(job->path); /* a file is renamed over another one only once it is gone, on some systems */
+        if ((fclose(job->fd) != 0) || (rename(part, job->path) != 0)) {
+            remove(part);
+            it->tries = MAXTRIES;
+            complete = 0;
+        }
+    } else {
+        if (job->sk != NULL)
+            net_abort(job->sk);
+        if (job->fd != NULL) {
+            fclose(job->fd);
+            remove(part);
+        }
+    }
+
+    if (complete) {
+        it->state = ITEM_DONE;
+        donecount += 1;
+        bytecount += job->len;
+        sprintf(how, "%ld bytes", job->len);
+        logitem(it, how);
+        /* the links of a menu are written down before the menu is told done,
+         * so that a run killed meanwhile fetches the menu again */
+        if ((job->menu != NULL) && (it->depth < limits->depth))
+            followlinks(job->menu, job->len, it->depth, limits);
+        fprintf(journal, "-%c%s\t%s\t%u\n", it->itemtype, it->selector, it->host, (unsigned)it->port);
+        fflush(journal);
+    } else if (it->tries < MAXTRIES) {
+        it->state = ITEM_QUEUED;
+        queuedcount += 1;
+        if (job->item < firstqueued)
+            firstqueued = job->item;
+    } else {
+        it->state = ITEM_FAILED;
+        failedcount += 1;
+        logitem(it, server_table[it->server].unknown ? "unknown host" : "failed");
+    }
+
+    bufpool_free(job->menu);
+    jobcount -= 1;
+    if (j < jobcount)
+        memcpy(job, &job_table[jobcount], sizeof *job);
+}
+
+/* starts fetching the i-th resource in a new job: connects to its server,
+ * and creates the file it is received into. Returns 0 on success, or
+ * non-zero if it failed then, the job being left for endjob(). */
+static int startjob(int i, const struct mirrorlimits *limits)
+{
+    struct item *it = &item_table[i];
+    struct server *s = &server_table[it->server];
+    struct job *job = &job_table[jobcount++];
+    char part[MIRROR_MAXPATH + 8];
+    struct url url;
+
+    it->state = ITEM_FETCHING;
+    it->tries += 1;
+    queuedcount -= 1;
+    job->item = i;
+    job->sk = NULL;
+    job->menu = NULL;
+    job->fd = NULL;
+    job->path[0] = 0;
+    later(&s->next, limits->delay);
+
+    url.host = it->host;
+    url.selector = it->selector;
+    url.port = it->port;
+    url.protocol = PARSEURL_PROTO_GOPHER;
+    url.itemtype = it->itemtype;
+    if (s->unknown || (mirror_path(job->path, sizeof job->path, mirrordir, &url) != 0)) {
+        it->tries = MAXTRIES; /* asking again would not do better */
+        return -1;
+    }
+    partpath(part, job->path);
+    makedirs(part, strlen(mirrordir) + 1);
+    job->fd = fopen(part, "wb");
+    if (job->fd == NULL) {
+        it->tries = MAXTRIES;
+        return -1;
+    }
+    if (it->itemtype == GOPHER_ITEM_DIR)
+        job->menu = bufpool_alloc(BUFPOOL_MINSIZE);
+
+    /* not with Fast Open: its net_send() would wait for the connection, while other transfers are due */
+    job->sk = net_connectprobe(s->ipaddr, it->port);
+    gettimeofday(&job->start, NULL);
+    job->connect = -1;
+    job->deadline = hoststat_deadline(it->host, it->port, HOSTSTAT_CONNECT);
+    job->longestgap = 0;
+    job->len = 0;
+    job->menustate = 0;
+    if (job->sk == NULL) {
+        hoststat_failure(it->host, it->port);
+        return -1;
+    }
+    return 0;
+}
+
+/* looks after the j-th job, whose connection needs attention. Returns
+ * non-zero if it is over, 0 otherwise. */
+static int runjob(int j, const struct mirrorlimits *limits, struct gopherusconfig *cfg)
+{
+    struct job *job = &job_table[j];
+    const struct item *it = &item_table[job->item];
+    long res;
+    int complete = 0;
+
+    if (job->connect < 0) {
+        char *request;
+        size_t len = strlen(it->selector) + 2;
+        res = net_isconnected(job->sk);
+        if (res == 0)
+            return 0;
+        if (res > 0) {
+            job->connect = usec_since(&job->start);
+            hoststat_measure(it->host, it->port, HOSTSTAT_CONNECT, job->connect);
+            request = malloc(len + 1);
+            if (request != NULL) {
+                sprintf(request, "%s\r\n", it->selector);
+                res = net_send(job->sk, request, len);
+                free(request);
+                if (res == (long)len) {
+                    gettimeofday(&job->last, NULL);
+                    job->deadline = hoststat_deadline(it->host, it->port, HOSTSTAT_ANSWER);
+                    return 0;
+                }
+            }
+        }
+        hoststat_failure(it->host, it->port);
+        endjob(j, 0, limits);
+        return 1;
+    }
+
+    res = net_recv(job->sk, chunk, CHUNKSIZE);
+    if (res == 0)
+        return 0;
+    if (res == -1) { /* the server closed the connection: the resource is complete */
+        endjob(j, 1, limits);
+        return 1;
+    }
+    if (res < 0) {
+        hoststat_failure(it->host, it->port);
+        endjob(j, 0, limits);
+        return 1;
+    }
+
+    if (job->len == 0) {
+        hoststat_answer(it->host, it->port, usec_since(&job->start));
+        hoststat_measure(it->host, it->port, HOSTSTAT_ANSWER, usec_since(&job->last));
+        job->deadline = hoststat_deadline(it->host, it->port, HOSTSTAT_STALL);
+        gettimeofday(&job->first, NULL);
+    } else if (usec_since(&job->last) > job->longestgap) {
+        job->longestgap = usec_since(&job->last);
+    }
+    gettimeofday(&job->last, NULL);
+
+    /* a menu is complete once its terminator came, unless the server is
+     * waited for to close the connection (see GOPHERUSWAITCLOSE): what may
+     * follow the terminator is not part of the menu */
+    if ((it->itemtype == GOPHER_ITEM_DIR) && (cfg->waitclose == 0)) {
+        long end = loadfile_findterminator(chunk, res, &job->menustate);
+        if (end >= 0) {
+            res = end;
+            complete = 1;
+        }
+    }
+
+    if (fwrite(chunk, 1, res, job->fd) != (size_t)res) { /* the disk is full, likely: no use asking again */
+        item_table[job->item].tries = MAXTRIES;
+        endjob(j, 0, limits);
+        return 1;
+    }
+
+    /* what came of a menu is kept, to follow its links */
+    if (job->menu != NULL) {
+        if (job->len + res >= bufpool_size(job->menu)) {
+            char *newbuf = bufpool_grow(job->menu, job->len, (job->len + res + 1) * 4);
+            if (newbuf == NULL) { /* out of memory: its links are not followed */
+                bufpool_free(job->menu);
+            }
+            job->menu = newbuf;
+        }
+        if (job->menu != NULL) {
+            memcpy(job->menu + job->len, chunk, res);
+            job->menu[job->len + res] = 0;
+        }
+    }
+    job->len += res;
+
+    if (complete) {
+        endjob(j, 1, limits);
+        return 1;
+    }
+    return 0;
+}
+
+/* prints how the mirroring goes */
+static void showstatus(void)
+{
+    printf("Mirroring... [%ld done, %ld queued, %d fetching, %ld failed, %ld KiB]\n",
+           donecount, queuedcount, jobcount, failedcount, bytecount / 1024);
+    fflush(stdout);
+}
+
+/* tells the main loop to stop, on SIGINT */
+static void oninterrupt(int sig)
+{
+    (void)sig;
+    interrupted = 1;
+}
+
+/* frees what the mirroring used, aborting the jobs that are left */
+static void cleanup(const struct mirrorlimits *limits)
+{
+    int i;
+
+    while (jobcount > 0) { /* the journal tells they are to be fetched again */
+        item_table[job_table[0].item].tries = 0;
+        endjob(0, 0, limits);
+    }
+    for (i = 0; i < itemcount; i++)
+        free(item_table[i].selector);
+    free(item_table);
+    free(hash_table);
+    free(server_table);
+    item_table = NULL;
+    hash_table = NULL;
+    server_table = NULL;
+    itemcount = itemsize = hashsize = servercount = serversize = 0;
+    firstqueued = 0;
+    if (journal != NULL)
+        fclose(journal);
+    journal = NULL;
+    bufpool_free(chunk);
+    chunk = NULL;
+}
+
+int mirror_run(const struct url *start, const char *dir, const struct mirrorlimits *limits, struct gopherusconfig *cfg)
+{
+    char path[MIRROR_MAXPATH];
+    struct timeval lastupdate;
+    struct net_tcpsocket *sk[MAXJOBS];
+    void (*oldhandler)(int);
+    int jobs = (limits->jobs < 1) ? 1 : (limits->jobs > MAXJOBS) ? MAXJOBS : limits->jobs;
+
+    if (((start->itemtype != GOPHER_ITEM_DIR) && (start->itemtype != GOPHER_ITEM_FILE)) ||
+        (mirror_path(path, sizeof path, dir, start) != 0)) {
+        fprintf(stderr, "Only the menus and text files of gopher servers can be mirrored.\n");
+        return -1;
+    }
+    if (strlen(dir) + sizeof JOURNAL + 1 > sizeof path) {
+        fprintf(stderr, "The path of the mirror is too long.\n");
+        return -1;
+    }
+    mirrordir = dir;
+    origin = start;
+    queuedcount = donecount = failedcount = bytecount = 0;
+    makedir(dir);
+    sprintf(path, "%s/" JOURNAL, dir);
+    chunk = bufpool_alloc(CHUNKSIZE);
+    if (chunk == NULL) {
+        fprintf(stderr, "Out of memory!\n");
+        return -1;
+    }
+    interrupted = replay(path);
+    journal = fopen(path, "ab");
+    if (journal == NULL) {
+        fprintf(stderr, "Error: could not write the journal of the mirror!\n");
+        cleanup(limits);
+        return -1;
+    }
+    if (interrupted) /* the line the last run got interrupted in is ended, so that it is not taken along the next one */
+        fputc('\n', journal);
+    interrupted = 0;
+    additem(start->host, start->port, start->itemtype, start->selector, 0, 1);
+    fflush(journal);
+
+    oldhandler = signal(SIGINT, oninterrupt);
+    gettimeofday(&lastupdate, NULL);
+    showstatus();
+    for (;;) {
+        int i, j;
+
+        dnscache_collect(NULL, 0); /* the names resolved meanwhile */
+        while ((jobcount < jobs) && ((i = nextitem()) >= 0))
+            if (startjob(i, limits) != 0)
+                endjob(jobcount - 1, 0, limits);
+        if ((jobcount == 0) && (queuedcount == 0))
+            break;
+
+        if (jobcount == 0) { /* the servers of the queued resources are not to be asked yet */
+            usleep(WAIT_SLICE);
+        } else {
+            for (j = 0; j < jobcount; j++)
+                sk[j] = job_table[j].sk;
+            if (net_wait(sk, jobcount, WAIT_SLICE) >= 0) {
+                /* every connection that needs attention gets it, not only the first one */
+                for (j = jobcount - 1; j >= 0; j--)
+                    if (net_wait(&job_table[j].sk, 1, 0) == 0)
+                        runjob(j, limits, cfg);
+            }
+            /* a server past its deadline is given up on, for now */
+            for (j = jobcount - 1; j >= 0; j--) {
+                struct job *job = &job_table[j];
+                const struct item *it = &item_table[job->item];
+                if (usec_since((job->connect < 0) ? &job->start : &job->last) <= job->deadline)
+                    continue;
+                hoststat_timeout(it->host, it->port, (job->connect < 0) ? HOSTSTAT_CONNECT : (job->len == 0) ? HOSTSTAT_ANSWER : HOSTSTAT_STALL);
+                endjob(j, 0, limits);
+            }
+        }
+
+        if (interrupted)
+            break;
+        if (usec_since(&lastupdate) >= STATUS_INTERVAL) {
+            showstatus();
+            gettimeofday(&lastupdate, NULL);
+        }
+    }
+    signal(SIGINT, oldhandler);
+
+    if (interrupted) {
+        printf("Mirroring interrupted with %ld resources left: run it again to go on.\n", queuedcount + jobcount);
+    } else if (donecount == 0 && failedcount == 0) {
+        printf("The mirror is complete already (delete its journal to mirror it again).\n");
+    } else if (failedcount > 0) {
+        printf("Mirrored %ld resource%s (%ld KiB), %ld failed: run it again to retry them.\n", donecount, (donecount == 1) ? "" : "s", bytecount / 1024, failedcount);
+    } else {
+        printf("Mirrored %ld resource%s (%ld KiB).\n", donecount, (donecount == 1) ? "" : "s", bytecount / 1024);
+    }
+    cleanup(limits);
+    return (interrupted || (failedcount > 0)) ? -1 : 0;
+}
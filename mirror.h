@@ -0,0 +1,39 @@
+/*
+ * This file is part of the Gopherus project.
+ *
+ * A mirror is a copy of the menus and text files of a gopher hole on disk,
+ * that can be browsed offline. Each resource is kept in a file of its own,
+ * at a path made of its server and selector (see mirror_path()), and a
+ * journal tells which ones have been fetched already, so that a mirroring
+ * that got interrupted goes on where it stopped once run again.
+ */
+
+#ifndef MIRROR_H
+#define MIRROR_H
+
+#include <stddef.h>
+#include "common.h"
+#include "parseurl.h"
+
+#define MIRROR_MAXPATH 1024
+
+/* how far mirror_run() goes, and how fast */
+struct mirrorlimits {
+    int depth;   /* links followed from the start, at most */
+    int jobs;    /* resources fetched at once, at most */
+    long delay;  /* msec between the starts of two requests to a server */
+    int span;    /* non-zero to follow links to other servers as well */
+};
+
+/* writes in path, of size bytes, the path of the file that keeps url in the
+ * mirror in dir. Returns 0 on success, or non-zero if url is not something
+ * a mirror keeps, or if its path does not fit. */
+int mirror_path(char *path, size_t size, const char *dir, const struct url *url);
+
+/* mirrors into dir the menus and text files that start leads to, within
+ * limits, resuming from the journal of an earlier run if there is one. It
+ * needs no screen: how it goes is printed on stdout, and SIGINT interrupts
+ * it. Returns 0 if everything got mirrored. */
+int mirror_run(const struct url *start, const char *dir, const struct mirrorlimits *limits, struct gopherusconfig *cfg);
+
+#endif
@@ -6,9 +6,14 @@
  */
 
 #include <stdlib.h>  /* NULL */
+#include <string.h>  /* strlen(), strcpy() */
+#include <pthread.h>
+#include <time.h>    /* clock_gettime() */
 #include <sys/socket.h> /* socket() */
+#include <sys/select.h>
 #include <fcntl.h>
 #include <arpa/inet.h>
+#include <netinet/tcp.h> /* TCP_NODELAY, TCP_FASTOPEN_CONNECT */
 #include <netdb.h>
 #include <stdio.h> /* sprintf() */
 #include <unistd.h> /* close() */
@@ -18,8 +23,21 @@
 #include "net.h"
 
 #define POLLING_TIMEOUT_USEC 125000
+#define DNS_MAXJOBS 64    /* names being resolved in the background, or resolved and not returned yet */
+#define DNS_MAXTHREADS 8  /* names resolved at once */
 
-static int g_sk;
+#define DNSJOB_FREE 0
+#define DNSJOB_QUEUED 1
+#define DNSJOB_RUNNING 2
+#define DNSJOB_DONE 3
+
+struct net_tcpsocket {
+    int fd;
+    int connected; /* as returned by net_isconnected() */
+    int deferred;  /* non-zero for a Fast Open connection that the first net_send() starts */
+};
+
+static int net_rcvbuf; /* SO_RCVBUF of new sockets, 0 for the system's default */
 
 unsigned long net_dnsresolve(const char *name)
 {
@@ -27,73 +45,289 @@ unsigned long net_dnsresolve(const char *name)
     return (hent) ? htonl(*((uint32_t *)(hent->h_addr))) : 0;
 }
 
+/* background resolutions are done by up to DNS_MAXTHREADS threads, which
+ * leave as soon as there is nothing queued. getaddrinfo() is used there, as
+ * gethostbyname() is not thread-safe. */
+static struct dnsjob {
+    const char *name;  /* as given to net_dnsstart() */
+    char copy[256];    /* what the thread resolves, name being the caller's */
+    unsigned long ipaddr;
+    int state;
+} dns_jobs[DNS_MAXJOBS];
+static int dns_threads;
+static pthread_mutex_t dns_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t dns_cond = PTHREAD_COND_INITIALIZER;
+
+static unsigned long dns_getaddr(const char *name)
+{
+    struct addrinfo hints, *res;
+    unsigned long ipaddr = 0;
+
+    memset(&hints, 0, sizeof hints);
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(name, NULL, &hints, &res) == 0) {
+        ipaddr = ntohl(((struct sockaddr_in *)res->ai_addr)->sin_addr.s_addr);
+        freeaddrinfo(res);
+    }
+    return ipaddr;
+}
+
+static void *dns_worker(void *arg)
+{
+    (void)arg;
+    pthread_mutex_lock(&dns_lock);
+    for (;;) {
+        struct dnsjob *job = NULL;
+        unsigned long ipaddr;
+        int i;
+
+        for (i = 0; (i < DNS_MAXJOBS) && (job == NULL); i++)
+            if (dns_jobs[i].state == DNSJOB_QUEUED)
+                job = &dns_jobs[i];
+        if (job == NULL)
+            break;
+
+        job->state = DNSJOB_RUNNING;
+        pthread_mutex_unlock(&dns_lock);
+        ipaddr = dns_getaddr(job->copy);
+        pthread_mutex_lock(&dns_lock);
+        job->ipaddr = ipaddr;
+        job->state = DNSJOB_DONE;
+        pthread_cond_signal(&dns_cond);
+    }
+    dns_threads -= 1;
+    pthread_mutex_unlock(&dns_lock);
+    return NULL;
+}
+
+int net_dnsstart(const char *name)
+{
+    struct dnsjob *job = NULL;
+    int res = 1, i;
+
+    if (strlen(name) >= sizeof dns_jobs[0].copy)
+        return -1;
+
+    pthread_mutex_lock(&dns_lock);
+    for (i = 0; (i < DNS_MAXJOBS) && (job == NULL); i++)
+        if (dns_jobs[i].state == DNSJOB_FREE)
+            job = &dns_jobs[i];
+    if (job != NULL) {
+        res = 0;
+        job->name = name;
+        strcpy(job->copy, name);
+        job->state = DNSJOB_QUEUED;
+        if (dns_threads < DNS_MAXTHREADS) {
+            pthread_t thread;
+            pthread_attr_t attr;
+            pthread_attr_init(&attr);
+            pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+            if (pthread_create(&thread, &attr, dns_worker, NULL) == 0) {
+                dns_threads += 1;
+            } else if (dns_threads == 0) { /* no one to resolve it */
+                job->state = DNSJOB_FREE;
+                res = -1;
+            }
+            pthread_attr_destroy(&attr);
+        }
+    }
+    pthread_mutex_unlock(&dns_lock);
+
+    return res;
+}
+
+const char *net_dnsdone(unsigned long *ipaddr, long usec)
+{
+    const char *name = NULL;
+    struct timespec deadline;
+    int i;
+
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += usec / 1000000l;
+    deadline.tv_nsec += (usec % 1000000l) * 1000;
+    if (deadline.tv_nsec >= 1000000000l) {
+        deadline.tv_sec += 1;
+        deadline.tv_nsec -= 1000000000l;
+    }
+
+    pthread_mutex_lock(&dns_lock);
+    for (;;) {
+        for (i = 0; (i < DNS_MAXJOBS) && (name == NULL); i++) {
+            if (dns_jobs[i].state == DNSJOB_DONE) {
+                name = dns_jobs[i].name;
+                *ipaddr = dns_jobs[i].ipaddr;
+                dns_jobs[i].state = DNSJOB_FREE;
+            }
+        }
+        if ((name != NULL) || (usec <= 0))
+            break;
+        if (pthread_cond_timedwait(&dns_cond, &dns_lock, &deadline) != 0)
+            usec = 0; /* timed out, but have a last look */
+    }
+    pthread_mutex_unlock(&dns_lock);
+
+    return name;
+}
+
 int net_init(void)
 {
     return 0;
 }
 
-int net_connect(unsigned long ipaddr, unsigned short port)
+void net_setrcvbuf(long size)
+{
+    net_rcvbuf = (int)size;
+}
+
+/* opens a connection for net_connect() or net_connectprobe() */
+static struct net_tcpsocket *opensocket(unsigned long ipaddr, unsigned short port, int fastopen)
 {
     struct sockaddr_in remote;
+    int on = 1;
+    struct net_tcpsocket *sk = malloc(sizeof *sk);
 
-    g_sk = socket(AF_INET, SOCK_STREAM | O_NONBLOCK, IPPROTO_TCP);
-    if (g_sk < 0)
-        return -1;
+    if (sk == NULL)
+        return NULL;
+    sk->fd = socket(AF_INET, SOCK_STREAM | O_NONBLOCK, IPPROTO_TCP);
+    if (sk->fd < 0) {
+        free(sk);
+        return NULL;
+    }
+
+    /* a request is a single write, that has nothing to wait for */
+    setsockopt(sk->fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof on);
+    /* the buffer must be set before connecting, for the window scale to fit it */
+    if (net_rcvbuf > 0)
+        setsockopt(sk->fd, SOL_SOCKET, SO_RCVBUF, &net_rcvbuf, sizeof net_rcvbuf);
+#ifdef TCP_FASTOPEN_CONNECT
+    /* if the kernel has a Fast Open cookie from an earlier connection to the server, connect() returns at once, and
+       the request goes in the SYN, sparing a round trip. Otherwise a cookie is asked for along a normal connection. A
+       kernel without Fast Open refuses the option, and a server without it ignores the data of the SYN, which the
+       kernel sends again once connected: either way, this is a normal connection then. */
+    if (fastopen)
+        setsockopt(sk->fd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, &on, sizeof on);
+#endif
 
     remote.sin_family = AF_INET;
     remote.sin_addr.s_addr = htonl(ipaddr);
     remote.sin_port = htons(port);
 
-    if (connect(g_sk, (struct sockaddr *)&remote, sizeof remote) < 0) {
-        if (errno == EINPROGRESS) {
-            while (!is_int_pending()) {
-                int ret;
-                fd_set wfd;
-                struct timeval tv;
+    sk->connected = 1;
+    sk->deferred = fastopen; /* connect() returns at once only if the SYN waits for the data of net_send() */
+    if (connect(sk->fd, (struct sockaddr *)&remote, sizeof remote) < 0) {
+        if (errno != EINPROGRESS) {
+            close(sk->fd);
+            free(sk);
+            return NULL;
+        }
+        sk->connected = 0;
+        sk->deferred = 0;
+    }
 
-                tv.tv_sec = 0;
-                tv.tv_usec = POLLING_TIMEOUT_USEC;
-                FD_ZERO(&wfd);
-                FD_SET(g_sk, &wfd);
+    return sk;
+}
+
+struct net_tcpsocket *net_connect(unsigned long ipaddr, unsigned short port)
+{
+    return opensocket(ipaddr, port, 1);
+}
+
+struct net_tcpsocket *net_connectprobe(unsigned long ipaddr, unsigned short port)
+{
+    return opensocket(ipaddr, port, 0);
+}
 
-                ret = select(g_sk + 1, NULL, &wfd, NULL, &tv);
+int net_isconnected(struct net_tcpsocket *sk)
+{
+    if (sk->connected == 0) {
+        fd_set wfd;
+        struct timeval tv;
+
+        tv.tv_sec = 0;
+        tv.tv_usec = 0;
+        FD_ZERO(&wfd);
+        FD_SET(sk->fd, &wfd);
 
-                if (ret == 1) {
-                    return 0;
-                } else if (ret < 0 && errno != EINTR) {
-                    break;
-                }
+        if (select(sk->fd + 1, NULL, &wfd, NULL, &tv) == 1) {
+            int err = 0;
+            socklen_t errlen = sizeof err;
+            if ((getsockopt(sk->fd, SOL_SOCKET, SO_ERROR, &err, &errlen) < 0) || (err != 0)) {
+                sk->connected = -1;
+            } else {
+                sk->connected = 1;
             }
         }
-        close(g_sk);
-        return -1;
     }
+    return sk->connected;
+}
 
-    return 0;
+int net_wait(struct net_tcpsocket **sk, int count, long usec)
+{
+    fd_set rfd, wfd;
+    struct timeval tv;
+    int i, maxfd = -1;
+
+    FD_ZERO(&rfd);
+    FD_ZERO(&wfd);
+    for (i = 0; i < count; i++) {
+        if (sk[i]->connected < 0)
+            return i;
+        FD_SET(sk[i]->fd, (sk[i]->connected == 0) ? &wfd : &rfd);
+        if (sk[i]->fd > maxfd)
+            maxfd = sk[i]->fd;
+    }
+    tv.tv_sec = usec / 1000000l;
+    tv.tv_usec = usec % 1000000l;
+
+    if (select(maxfd + 1, &rfd, &wfd, NULL, &tv) <= 0)
+        return -1;
+    for (i = 0; i < count; i++)
+        if (FD_ISSET(sk[i]->fd, &rfd) || FD_ISSET(sk[i]->fd, &wfd))
+            return i;
+    return -1;
 }
 
-int net_send(const char *buf, int len)
+int net_send(struct net_tcpsocket *sk, const char *buf, int len)
 {
     int ret;
 
     do {
-        ret = send(g_sk, buf, len, 0);
+        ret = send(sk->fd, buf, len, 0);
 
+        /* EINPROGRESS: a Fast Open connection could not take the data in its SYN, and goes on as a normal one */
         if (ret < 0) {
             if (errno == EINTR ||
                 errno == EAGAIN ||
-                errno == EWOULDBLOCK) {
-                usleep(POLLING_TIMEOUT_USEC);
+                errno == EWOULDBLOCK ||
+                errno == EINPROGRESS) {
+                fd_set wfd;
+                struct timeval tv;
+                FD_ZERO(&wfd);
+                FD_SET(sk->fd, &wfd);
+                tv.tv_sec = 0;
+                tv.tv_usec = POLLING_TIMEOUT_USEC;
+                select(sk->fd + 1, NULL, &wfd, NULL, &tv);
             } else {
                 return ret;
             }
         }
     } while (!is_int_pending() && ret < 0);
 
+#ifdef TCP_FASTOPEN_CONNECT
+    /* the data went along with the SYN of a Fast Open connection: it is in progress until the server answers that */
+    if ((ret >= 0) && sk->deferred) {
+        struct tcp_info info;
+        socklen_t infolen = sizeof info;
+        if ((getsockopt(sk->fd, IPPROTO_TCP, TCP_INFO, &info, &infolen) == 0) && (info.tcpi_state == TCP_SYN_SENT))
+            sk->connected = 0;
+    }
+#endif
+    sk->deferred = 0;
     return ret;
 }
 
-int net_recv(char *buf, int maxlen)
+int net_recv(struct net_tcpsocket *sk, char *buf, int maxlen)
 {
     int res;
     fd_set rfds;
@@ -101,21 +335,22 @@ int net_recv(char *buf, int maxlen)
 
     /* Use select() to wait up to 100ms if nothing awaits on the socket (spares some CPU time) */
     FD_ZERO(&rfds);
-    FD_SET(g_sk, &rfds);
+    FD_SET(sk->fd, &rfds);
     tv.tv_sec = 0;
     tv.tv_usec = 100000;
 
-    res = select(g_sk + 1, &rfds, NULL, NULL, &tv);
+    res = select(sk->fd + 1, &rfds, NULL, NULL, &tv);
     if (res < 0)
         return -1;
     if (res == 0)
         return 0;
 
     /* read the stuff now (if any) */
-    res = recv(g_sk, buf, maxlen, MSG_DONTWAIT);
+    res = recv(sk->fd, buf, maxlen, MSG_DONTWAIT);
     if (res < 0) {
         if (errno == EAGAIN) return 0;
         if (errno == EWOULDBLOCK) return 0;
+        return -2; /* the connection failed (a Fast Open one is only known to then), or got reset */
     }
 
     if (res == 0)
@@ -124,12 +359,13 @@ int net_recv(char *buf, int maxlen)
     return res;
 }
 
-void net_close(void)
+void net_close(struct net_tcpsocket *sk)
 {
-    close(g_sk);
+    close(sk->fd);
+    free(sk);
 }
 
-void net_abort(void)
+void net_abort(struct net_tcpsocket *sk)
 {
-    net_close();
+    net_close(sk);
 }
@@ -8,35 +8,70 @@
 #include <stdlib.h>
 #include "net.h"
 
+struct net_tcpsocket {
+    int dummy;
+};
+
+static struct net_tcpsocket stub_sk;
+
 unsigned long net_dnsresolve(const char *name)
 {
     return 0;
 }
 
+int net_dnsstart(const char *name)
+{
+    return -1;
+}
+
+const char *net_dnsdone(unsigned long *ipaddr, long usec)
+{
+    return NULL;
+}
+
 int net_init(void)
 {
     return 0;
 }
 
-int net_connect(unsigned long ipaddr, unsigned short port)
+void net_setrcvbuf(long size)
 {
-    return 0;
 }
 
-int net_send(const char *buf, int len)
+struct net_tcpsocket *net_connect(unsigned long ipaddr, unsigned short port)
+{
+    return &stub_sk;
+}
+
+struct net_tcpsocket *net_connectprobe(unsigned long ipaddr, unsigned short port)
+{
+    return &stub_sk;
+}
+
+int net_isconnected(struct net_tcpsocket *sk)
+{
+    return 1;
+}
+
+int net_wait(struct net_tcpsocket **sk, int count, long usec)
+{
+    return (count > 0) ? 0 : -1;
+}
+
+int net_send(struct net_tcpsocket *sk, const char *buf, int len)
 {
     return -1;
 }
 
-int net_recv(char *buf, int maxlen)
+int net_recv(struct net_tcpsocket *sk, char *buf, int maxlen)
 {
     return -1;
 }
 
-void net_close(void)
+void net_close(struct net_tcpsocket *sk)
 {
 }
 
-void net_abort(void)
+void net_abort(struct net_tcpsocket *sk)
 {
 }
@@ -13,7 +13,12 @@
 
 #include "net.h"
 
-static int g_sk;
+struct net_tcpsocket {
+    SOCKET fd;
+    int connected; /* as returned by net_isconnected() */
+};
+
+static int net_rcvbuf; /* SO_RCVBUF of new sockets, 0 for the system's default */
 
 unsigned long net_dnsresolve(const char *name)
 {
@@ -21,41 +26,127 @@ unsigned long net_dnsresolve(const char *name)
     return (hent) ? htonl(*((uint32_t *)(hent->h_addr))) : 0;
 }
 
+int net_dnsstart(const char *name)
+{
+    return -1; /* names are only resolved as needed */
+}
+
+const char *net_dnsdone(unsigned long *ipaddr, long usec)
+{
+    return NULL;
+}
+
 int net_init(void)
 {
     WSADATA wsaData;
     return WSAStartup(MAKEWORD(2,2), &wsaData);
 }
 
-int net_connect(unsigned long ipaddr, unsigned short port)
+void net_setrcvbuf(long size)
+{
+    net_rcvbuf = (int)size;
+}
+
+struct net_tcpsocket *net_connect(unsigned long ipaddr, unsigned short port)
 {
     struct sockaddr_in remote;
     char ipstr[64];
+    u_long nonblocking = 1;
+    BOOL on = TRUE;
+    struct net_tcpsocket *sk = malloc(sizeof *sk);
+
+    if (sk == NULL)
+        return NULL;
 
     sprintf(ipstr, "%lu.%lu.%lu.%lu", (ipaddr >> 24) & 0xFF, (ipaddr >> 16) & 0xFF, (ipaddr >> 8) & 0xFF, ipaddr & 0xFF);
 
-    g_sk = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-    if (g_sk < 0)
-        return -1;
+    sk->fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (sk->fd == INVALID_SOCKET) {
+        free(sk);
+        return NULL;
+    }
+    ioctlsocket(sk->fd, FIONBIO, &nonblocking);
+    setsockopt(sk->fd, IPPROTO_TCP, TCP_NODELAY, (const char *)&on, sizeof on); /* a request is a single write */
+    if (net_rcvbuf > 0)
+        setsockopt(sk->fd, SOL_SOCKET, SO_RCVBUF, (const char *)&net_rcvbuf, sizeof net_rcvbuf);
 
     remote.sin_family = AF_INET;  /* Proto family (IPv4) */
     remote.sin_addr.s_addr = inet_addr(ipstr); /* set dst IP address */
     remote.sin_port = htons(port); /* set the dst port */
 
-    if (connect(g_sk, (struct sockaddr *)&remote, sizeof remote) < 0) {
-        close(g_sk);
-        return -1;
+    sk->connected = 1;
+    if (connect(sk->fd, (struct sockaddr *)&remote, sizeof remote) == SOCKET_ERROR) {
+        if (WSAGetLastError() != WSAEWOULDBLOCK) {
+            closesocket(sk->fd);
+            free(sk);
+            return NULL;
+        }
+        sk->connected = 0;
     }
 
-    return 0;
+    return sk;
+}
+
+struct net_tcpsocket *net_connectprobe(unsigned long ipaddr, unsigned short port)
+{
+    return net_connect(ipaddr, port); /* there is no Fast Open here */
+}
+
+int net_isconnected(struct net_tcpsocket *sk)
+{
+    if (sk->connected == 0) {
+        fd_set wfd, efd;
+        struct timeval tv;
+
+        tv.tv_sec = 0;
+        tv.tv_usec = 0;
+        FD_ZERO(&wfd);
+        FD_ZERO(&efd);
+        FD_SET(sk->fd, &wfd);
+        FD_SET(sk->fd, &efd);
+
+        if (select(0, NULL, &wfd, &efd, &tv) > 0) /* a failed connection is an exception */
+            sk->connected = FD_ISSET(sk->fd, &efd) ? -1 : 1;
+    }
+    return sk->connected;
+}
+
+int net_wait(struct net_tcpsocket **sk, int count, long usec)
+{
+    fd_set rfd, wfd, efd;
+    struct timeval tv;
+    int i;
+
+    FD_ZERO(&rfd);
+    FD_ZERO(&wfd);
+    FD_ZERO(&efd);
+    for (i = 0; i < count; i++) {
+        if (sk[i]->connected < 0)
+            return i;
+        if (sk[i]->connected == 0) {
+            FD_SET(sk[i]->fd, &wfd);
+            FD_SET(sk[i]->fd, &efd);
+        } else {
+            FD_SET(sk[i]->fd, &rfd);
+        }
+    }
+    tv.tv_sec = usec / 1000000l;
+    tv.tv_usec = usec % 1000000l;
+
+    if (select(0, &rfd, &wfd, &efd, &tv) <= 0)
+        return -1;
+    for (i = 0; i < count; i++)
+        if (FD_ISSET(sk[i]->fd, &rfd) || FD_ISSET(sk[i]->fd, &wfd) || FD_ISSET(sk[i]->fd, &efd))
+            return i;
+    return -1;
 }
 
-int net_send(const char *buf, int len)
+int net_send(struct net_tcpsocket *sk, const char *buf, int len)
 {
-    return send(g_sk, buf, len, 0);
+    return send(sk->fd, buf, len, 0);
 }
 
-int net_recv(char *buf, int maxlen)
+int net_recv(struct net_tcpsocket *sk, char *buf, int maxlen)
 {
     int res;
     fd_set rfds;
@@ -63,30 +154,33 @@ int net_recv(char *buf, int maxlen)
 
     /* Use select() to wait up to 100ms if nothing awaits on the socket (spares some CPU time) */
     FD_ZERO(&rfds);
-    FD_SET(g_sk, &rfds);
+    FD_SET(sk->fd, &rfds);
     tv.tv_sec = 0;
     tv.tv_usec = 100000;
 
-    res = select(g_sk + 1, &rfds, NULL, NULL, &tv);
+    res = select(0, &rfds, NULL, NULL, &tv);
     if (res < 0)
         return -1;
     if (res == 0)
         return 0;
 
     /* read the stuff now (if any) */
-    res = recv(g_sk, buf, maxlen, 0);
+    res = recv(sk->fd, buf, maxlen, 0);
+    if (res == SOCKET_ERROR)
+        return (WSAGetLastError() == WSAEWOULDBLOCK) ? 0 : -2;
     if (res == 0)
         return -1; /* the peer performed an orderly shutdown */
 
     return res;
 }
 
-void net_close(void)
+void net_close(struct net_tcpsocket *sk)
 {
-    close(g_sk);
+    closesocket(sk->fd);
+    free(sk);
 }
 
-void net_abort(void)
+void net_abort(struct net_tcpsocket *sk)
 {
-    net_close();
+    net_close(sk);
 }
@@ -17,9 +17,15 @@
 #include "net.h"
 
 #define SKBUF_SIZE 2048
+#define SKBUF_MAX 65535u /* the most a WatTCP socket can be given */
 
-static tcp_Socket g_sk;
-static char *g_skbuf;
+/* the receive buffer of a socket follows it in memory */
+struct net_tcpsocket {
+    tcp_Socket sk;
+    int connected; /* as returned by net_isconnected() */
+};
+
+static unsigned int net_rcvbuf = SKBUF_SIZE;
 
 static int is_int_pending_adapter(void *sock)
 {
@@ -37,57 +43,112 @@ static int dummy_printf(const char * format, ...)
     return 0;
 }
 
+int net_dnsstart(const char *name)
+{
+    return -1; /* names are only resolved as needed */
+}
+
+const char *net_dnsdone(unsigned long *ipaddr, long usec)
+{
+    return NULL;
+}
+
 int net_init(void)
 {
     tzset();
     _printf = dummy_printf;  /* this is to avoid watt32 printing its stuff to console */
-    g_skbuf = malloc(SKBUF_SIZE);
     return sock_init();
 }
 
-int net_connect(unsigned long ipaddr, unsigned short port)
+void net_setrcvbuf(long size)
 {
-    int status = 0;
+    if (size <= 0) {
+        net_rcvbuf = SKBUF_SIZE;
+    } else {
+        net_rcvbuf = (size > (long)SKBUF_MAX) ? SKBUF_MAX : (unsigned int)size;
+    }
+}
 
-    if (!tcp_open(&g_sk, 0, ipaddr, port, NULL))
-        return -1;
+struct net_tcpsocket *net_connect(unsigned long ipaddr, unsigned short port)
+{
+    struct net_tcpsocket *sk = malloc(sizeof *sk + net_rcvbuf);
+
+    if (sk == NULL)
+        return NULL;
+    if (!tcp_open(&sk->sk, 0, ipaddr, port, NULL)) {
+        free(sk);
+        return NULL;
+    }
+    sock_setbuf(&sk->sk, (char *)(sk + 1), net_rcvbuf);
+    sk->connected = 0;
+    return sk;
+}
+
+struct net_tcpsocket *net_connectprobe(unsigned long ipaddr, unsigned short port)
+{
+    return net_connect(ipaddr, port); /* there is no Fast Open here */
+}
+
+int net_isconnected(struct net_tcpsocket *sk)
+{
+    if (sk->connected == 0) {
+        if (!tcp_tick(&sk->sk)) { /* closed, or reset by the peer */
+            sk->connected = -1;
+        } else if (tcp_established(&sk->sk)) {
+            sk->connected = 1;
+        }
+    }
+    return sk->connected;
+}
+
+int net_wait(struct net_tcpsocket **sk, int count, long usec)
+{
+    unsigned long timer = set_timeout(usec / 1000);
+
+    do {
+        int i;
+        for (i = 0; i < count; i++) {
+            if (sk[i]->connected == 0) {
+                if (net_isconnected(sk[i]) != 0)
+                    return i;
+            } else if ((sk[i]->connected < 0) || !tcp_tick(&sk[i]->sk) || sock_dataready(&sk[i]->sk)) {
+                return i;
+            }
+        }
+    } while (!chk_timeout(timer) && !is_int_pending());
 
-    sock_setbuf(&g_sk, g_skbuf, SKBUF_SIZE);
-    sock_wait_established(&g_sk, sock_delay, &is_int_pending_adapter, NULL);
-    sock_tick(&g_sk, &status); /* in case they sent reset */
-    return 0;
-sock_err:
     return -1;
 }
 
-int net_send(const char *buf, int len)
+int net_send(struct net_tcpsocket *sk, const char *buf, int len)
 {
     int status = 0;
-    int res = sock_write(&g_sk, buf, len);
-    sock_tick(&g_sk, &status); /* call this to let WatTCP handle its internal stuff */
+    int res = sock_write(&sk->sk, buf, len);
+    sock_tick(&sk->sk, &status); /* call this to let WatTCP handle its internal stuff */
     return res;
 sock_err:
     return -1;
 }
 
-int net_recv(char *buf, int maxlen)
+int net_recv(struct net_tcpsocket *sk, char *buf, int maxlen)
 {
     int status = 0;
-    sock_tick(&g_sk, &status); /* call this to let WatTCP handle its internal stuff */
-    return sock_fastread(&g_sk, buf, maxlen);
+    sock_tick(&sk->sk, &status); /* call this to let WatTCP handle its internal stuff */
+    return sock_fastread(&sk->sk, buf, maxlen);
 sock_err:
     return -1;
 }
 
-void net_close(void)
+void net_close(struct net_tcpsocket *sk)
 {
-    sock_close(&g_sk);
-    sock_wait_closed(&g_sk, sock_delay, &is_int_pending_adapter, NULL);
+    sock_close(&sk->sk);
+    sock_wait_closed(&sk->sk, sock_delay, &is_int_pending_adapter, NULL);
 sock_err:
-    return;
+    free(sk);
 }
 
-void net_abort(void)
+void net_abort(struct net_tcpsocket *sk)
 {
-    sock_abort(&g_sk);
+    sock_abort(&sk->sk);
+    free(sk);
 }
@@ -6,29 +6,60 @@
 #ifndef NET_H
 #define NET_H
 
+/* a TCP connection, as opened by net_connect() */
+struct net_tcpsocket;
+
 extern int is_int_pending(void);
 
 /* this is a wrapper around the wattcp lookup_host(), but with a small integrated cache */
 unsigned long net_dnsresolve(const char *name);
 
+/* starts resolving name in the background. name must stay valid until net_dnsdone() returns it. Returns 0 on success,
+   1 if too many names are being resolved already, or -1 if it cannot be resolved in the background (this is not
+   supported, or name is too long). */
+int net_dnsstart(const char *name);
+
+/* waits up to usec microseconds for a name to be resolved in the background, and returns it with *ipaddr set to its
+   address (0 if it could not be resolved), or returns NULL if none was. */
+const char *net_dnsdone(unsigned long *ipaddr, long usec);
+
 /* must be called before using libtcp. returns 0 on success, or non-zero if network subsystem is not available. */
 int net_init(void);
 
-/* connects to a IPv4 host and returns 0 on success, or non-zero otherwise */
-int net_connect(unsigned long ipaddr, unsigned short port);
+/* sets the size of the receive buffer of the connections opened from now on, in bytes. 0 leaves it to the system, that
+   may tune it on its own. A larger buffer lets more data be in flight on a fast link with a long round trip. */
+void net_setrcvbuf(long size);
+
+/* starts connecting to a IPv4 host and returns the socket, or NULL on error. The connection goes on in the background,
+   see net_isconnected(). Where TCP Fast Open is available, the connection may not even be started before the first
+   net_send(), whose data go along with it then: net_isconnected() tells it established until then, so that the data
+   get sent, and in progress again after, until the server answered. */
+struct net_tcpsocket *net_connect(unsigned long ipaddr, unsigned short port);
+
+/* starts connecting like net_connect(), but never with TCP Fast Open: net_isconnected() then tells when the server
+   answered, so that the connection times a round trip to it. */
+struct net_tcpsocket *net_connectprobe(unsigned long ipaddr, unsigned short port);
+
+/* Returns 1 once the connection of the socket is established, 0 while it is still in progress, or -1 if it failed. */
+int net_isconnected(struct net_tcpsocket *sk);
+
+/* Waits up to usec microseconds for one of count sockets to need attention: a connection getting established (or
+   failing), or data coming on an established one. Returns the index of such a socket, or -1 if none. */
+int net_wait(struct net_tcpsocket **sk, int count, long usec);
 
 /* Sends data on the socket.
 Returns the number of bytes sent on success, and <0 otherwise. */
-int net_send(const char *buf, int len);
+int net_send(struct net_tcpsocket *sk, const char *buf, int len);
 
 /* Reads data from the socket and write it into buffer 'buf', until end of connection. Will fall into error if the amount of data is bigger than 'maxlen' bytes.
-Returns the amount of data read (in bytes) on success, or a negative value otherwise. */
-int net_recv(char *buf, int maxlen);
+Returns the amount of data read (in bytes) on success, or a negative value otherwise: -1 once the peer closed the
+connection, less on error (where this can be told apart). */
+int net_recv(struct net_tcpsocket *sk, char *buf, int maxlen);
 
-/* Close the socket. */
-void net_close(void);
+/* Close the socket, and free it. */
+void net_close(struct net_tcpsocket *sk);
 
 /* Close the socket immediately (to be used when the peer is behaving wrongly) - this is much faster than net_close(). */
-void net_abort(void);
+void net_abort(struct net_tcpsocket *sk);
 
 #endif
@@ -2,6 +2,7 @@
  * This file is part of the gopherus project.
  */
 
+#include <ctype.h>    /* tolower() */
 #include <stdio.h>
 #include <string.h>   /* strstr() */
 #include <stdlib.h>   /* atoi() */
@@ -11,10 +12,107 @@
 
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 
-int parse_url(char *url_str, struct url *url)
+/* interned host names, in an open addressing hash table that is never
+ * shrunk. The table is at most half full. */
+static char **hosttable;
+static size_t hostcount;
+static size_t hostsize; /* a power of 2 */
+
+/* hashes host names regardless of case: setting bit 5 makes letters
+ * lowercase, and otherwise only brings a few chars together */
+#define HOSTHASH_INIT 5381ul
+#define HOSTHASH_ADD(hash, c) (((hash) * 33) ^ ((unsigned char)(c) | 0x20))
+
+static unsigned long hosthash(const char *host, size_t len)
+{
+    unsigned long hash = HOSTHASH_INIT;
+    while (len-- > 0)
+        hash = HOSTHASH_ADD(hash, *(host++));
+    return hash;
+}
+
+/* tells whether the interned host name is the len first chars of host */
+static int samehost(const char *interned, const char *host, size_t len)
+{
+    size_t i;
+    for (i = 0; i < len; i++)
+        if ((interned[i] != host[i]) &&
+            ((interned[i] == 0) || (tolower((unsigned char)interned[i]) != tolower((unsigned char)host[i]))))
+            return 0;
+    return (interned[len] == 0);
+}
+
+/* doubles the size of the host table. Returns 0 on success. */
+static int growhosts(void)
+{
+    size_t newsize = (hostsize > 0) ? hostsize * 2 : 64;
+    char **newtable = calloc(newsize, sizeof *newtable);
+    size_t i;
+
+    if (newtable == NULL)
+        return -1;
+    for (i = 0; i < hostsize; i++) {
+        if (hosttable[i] != NULL) {
+            size_t slot = hosthash(hosttable[i], strlen(hosttable[i])) & (newsize - 1);
+            while (newtable[slot] != NULL)
+                slot = (slot + 1) & (newsize - 1);
+            newtable[slot] = hosttable[i];
+        }
+    }
+    free(hosttable);
+    hosttable = newtable;
+    hostsize = newsize;
+    return 0;
+}
+
+/* url_internhost(), for a host name already hashed */
+static const char *internhost(const char *host, size_t len, unsigned long hash)
+{
+    size_t slot;
+
+    if (((hostcount + 1) * 2 > hostsize) && (growhosts() != 0))
+        return NULL;
+
+    for (slot = hash & (hostsize - 1); hosttable[slot] != NULL; slot = (slot + 1) & (hostsize - 1))
+        if (samehost(hosttable[slot], host, len))
+            return hosttable[slot];
+
+    hosttable[slot] = malloc(len + 1);
+    if (hosttable[slot] == NULL)
+        return NULL;
+    memcpy(hosttable[slot], host, len);
+    hosttable[slot][len] = 0;
+    hostcount++;
+    return hosttable[slot];
+}
+
+const char *url_internhost(const char *host, size_t len)
+{
+    return internhost(host, len, hosthash(host, len));
+}
+
+void url_freehosts(void)
+{
+    size_t i;
+
+    for (i = 0; i < hostsize; i++)
+        free(hosttable[i]);
+    free(hosttable);
+    hosttable = NULL;
+    hostcount = 0;
+    hostsize = 0;
+}
+
+/* tells whether the len chars of protocol name the protocol name */
+static int isproto(const char *protocol, size_t len, const char *name)
+{
+    return (strlen(name) == len) && samehost(name, protocol, len);
+}
+
+int parse_url(const char *url_str, struct url *url)
 {
-    int parserstate = 0;
-    char *port_str;
+    const char *ptr;
+    unsigned long hash = HOSTHASH_INIT;
     size_t i;
 
     memset(url, '\0', sizeof *url);
@@ -22,83 +120,46 @@ int parse_url(char *url_str, struct url *url)
     url->protocol = PARSEURL_PROTO_GOPHER;
     url->port = 70;
     url->itemtype = GOPHER_ITEM_DIR;
-    url->selector = url_str + strlen(url_str);
 
     /* skip the protocol part, if present */
     for (i = 0; url_str[i] != 0; i++) {
-        if (url_str[i] == '/') { /* no protocol */
-            url->protocol = PARSEURL_PROTO_GOPHER;
+        if (url_str[i] == '/') /* no protocol */
             break;
-        }
         if (url_str[i] == ':') { /* found a colon. check if it's for proto declaration */
-            if (url_str[i + 1] == '/') {
-                if (url_str[i + 2] == '/') {
-                    char *protostr = url_str;
-                    url_str[i] = 0;
-                    url_str += i + 3;
-                    if (strcasecmp(protostr, "gopher") == 0) {
-                        url->protocol = PARSEURL_PROTO_GOPHER;
-                    } else if (strcasecmp(protostr, "http") == 0) {
-                        url->protocol = PARSEURL_PROTO_HTTP;
-                        url->port = 80; /* default port is 80 for HTTP */
-                        url->itemtype = GOPHER_ITEM_HTML;
-                    } else {
-                        url->protocol = PARSEURL_PROTO_UNKNOWN;
-                    }
-                    break;
+            if ((url_str[i + 1] == '/') && (url_str[i + 2] == '/')) {
+                if (isproto(url_str, i, "gopher")) {
+                    url->protocol = PARSEURL_PROTO_GOPHER;
+                } else if (isproto(url_str, i, "http")) {
+                    url->protocol = PARSEURL_PROTO_HTTP;
+                    url->port = 80; /* default port is 80 for HTTP */
+                    url->itemtype = GOPHER_ITEM_HTML;
+                } else {
+                    url->protocol = PARSEURL_PROTO_UNKNOWN;
                 }
+                url_str += i + 3;
             }
-            url->protocol = PARSEURL_PROTO_GOPHER;
             break;
         }
     }
 
-    /* start reading the url_str */
-    url->host = url_str;
-
-    for (; parserstate < 4; url_str++) {
-        switch (parserstate) {
-            case 0:  /* reading host */
-                if (*url_str == ':') { /* a port will follow */
-                    *url_str = '\0';
-                    port_str = url_str + 1;
-                    parserstate = 1;
-                } else if (*url_str == '/') { /* gopher type will follow */
-                    *url_str = 0;
-                    parserstate = 2;
-                } else if (*url_str == '\0') { /* end of url_str */
-                    parserstate = 4;
-                }
-                break;
-            case 1:  /* reading port */
-                if (*url_str == '\0') { /* end of url_str */
-                    url->port = atoi(port_str);
-                    parserstate = 4;
-                } else if (*url_str == '/') {
-                    *url_str = 0;
-                    url->port = atoi(port_str);
-                    parserstate = 2; /* gopher type follows */
-                }
-                break;
-            case 2:  /* reading itemtype */
-                if (url->protocol == PARSEURL_PROTO_GOPHER) { /* if non-Gopher, skip the itemtype */
-                    if (*url_str != '\0') {
-                        url->itemtype = *url_str;
-                        parserstate = 3;
-                    } else {
-                        parserstate = 4;
-                    }
-                } else {
-                    parserstate = 3; /* go right to the url_str part now */
-                    url_str--;
-                }
-                break;
-            case 3:
-                url->selector = url_str;
-                parserstate = 4;
-                break;
-        }
+    /* the host goes up to a port or a path, if any */
+    for (ptr = url_str; (*ptr != 0) && (*ptr != ':') && (*ptr != '/'); ptr++)
+        hash = HOSTHASH_ADD(hash, *ptr);
+    url->host = internhost(url_str, ptr - url_str, hash);
+    if (url->host == NULL)
+        return -1;
+
+    if (*ptr == ':') { /* a port follows */
+        url->port = atoi(ptr + 1);
+        for (ptr++; (*ptr != 0) && (*ptr != '/'); ptr++);
+    }
+
+    if (*ptr == '/') { /* then the gopher type, and the selector */
+        ptr++;
+        if ((url->protocol == PARSEURL_PROTO_GOPHER) && (*ptr != 0)) /* if non-Gopher, there is no itemtype */
+            url->itemtype = *(ptr++);
     }
+    url->selector = ptr;
 
     return (url->protocol == PARSEURL_PROTO_UNKNOWN);
 }
@@ -12,17 +12,28 @@
 #define PARSEURL_PROTO_HTTP 2
 #define PARSEURL_PROTO_UNKNOWN -1
 
+/* the parts of a URL refer to strings it does not own: host is always an
+ * interned host name (see url_internhost()), so that two hosts are the same
+ * if their pointers are, and selector lies in some other storage */
 struct url {
-    char *host;
-    char *selector;
+    const char *host;
+    const char *selector;
     unsigned short port;
     char protocol;
     char itemtype;
 };
 
-/* Explodes a URL into parts, and return 0 on success, or a negative value on
- * error. Modifies original string and uses it as a storage. */
-int parse_url(char *url_str, struct url *url);
+/* Explodes a URL into parts, and return 0 on success, or a non-zero value
+ * on error. url_str is left as it is, and the selector points into it. */
+int parse_url(const char *url_str, struct url *url);
+
+/* returns the interned copy of the len first chars of host, made on first
+ * use. Host names are compared without regard to case, and the spelling
+ * seen first is kept. Returns NULL if out of memory. */
+const char *url_internhost(const char *host, size_t len);
+
+/* frees all interned host names */
+void url_freehosts(void);
 
 /* builds a URL from exploded parts */
 size_t build_url(char *str, size_t size, const struct url *url);
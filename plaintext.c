@@ -0,0 +1,138 @@
+/*
+ * This file is part of the Gopherus project.
+ *
+ * Makes plain text ready for display: control chars are dropped, except
+ * line feeds which are kept and tabs which are expanded to the next tab
+ * stop. Where SSE2 is available, 16 bytes are checked at once and blocks
+ * without any control char are copied as they are. Bytes of UTF-8
+ * sequences are kept, and only their first byte counts as a column.
+ */
+
+#include <string.h>    /* memcpy() */
+#include "plaintext.h"
+
+#if defined(__SSE2__) && defined(__GNUC__)
+#define PLAINTEXT_SSE2
+#include <emmintrin.h>
+#endif
+
+#define TABSIZE 8
+
+/* filters src into dst, or only measures the result if dst is NULL.
+ * Returns the length of the result. dst is dstsize bytes long: where it has
+ * room for it, more than needed is written at once, unless that would
+ * overwrite what is still to be read, dst being src. */
+static long filter(char *dst, long dstsize, const char *src, long slen)
+{
+    long dlen = 0, col = 0, x = 0;
+
+    for (;;) {
+        unsigned char c;
+
+#ifdef PLAINTEXT_SSE2
+        {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i space = _mm_set1_epi8(' ');
+            const __m128i del = _mm_set1_epi8(127);
+            const __m128i contmax = _mm_set1_epi8((char)0xC0); /* 0x80..0xBF are below, as signed */
+
+            while (x + 16 <= slen) {
+                __m128i b = _mm_loadu_si128((const __m128i *)(src + x));
+                /* chars 0..31 are positive and below a space, bytes >= 0x80 are negative */
+                __m128i ctrl = _mm_andnot_si128(_mm_cmplt_epi8(b, zero), _mm_cmplt_epi8(b, space));
+                int special = _mm_movemask_epi8(_mm_or_si128(ctrl, _mm_cmpeq_epi8(b, del)));
+                int cont = _mm_movemask_epi8(_mm_cmplt_epi8(b, contmax));
+                int n = (special != 0) ? __builtin_ctz(special) : 16;
+
+                if (dst != NULL) {
+                    if ((dlen + 16 <= dstsize) && ((dst != src) || (dlen == x) || (dlen + 16 <= x))) {
+                        _mm_storeu_si128((__m128i *)(dst + dlen), b);
+                    } else {
+                        int i;
+                        for (i = 0; i < n; i++)
+                            dst[dlen + i] = src[x + i];
+                    }
+                }
+                col += n - __builtin_popcount(cont & ((1 << n) - 1));
+                dlen += n;
+                x += n;
+                if (n < 16)
+                    break; /* the control char is processed below */
+            }
+        }
+#endif
+
+        if (x >= slen)
+            break;
+
+        c = src[x++];
+        switch (c) {
+            case '\t':  /* expand tabs up to the next tab stop */
+            {
+                int n = TABSIZE - (col % TABSIZE);
+                if ((dst != NULL) && (dlen + TABSIZE <= dstsize)) {
+                    memcpy(dst + dlen, "        ", TABSIZE); /* only n chars will count */
+                } else if (dst != NULL) {
+                    int i;
+                    for (i = 0; i < n; i++)
+                        dst[dlen + i] = ' ';
+                }
+                dlen += n;
+                col += n;
+                break;
+            }
+            case '\n':  /* preserve line feeds */
+                if (dst != NULL)
+                    dst[dlen] = '\n';
+                dlen++;
+                col = 0;
+                break;
+            default:
+                if ((c < 32) || (c == 127))
+                    break; /* ignore control chars, CR and DEL included */
+                if (dst != NULL)
+                    dst[dlen] = c; /* copy everything else */
+                dlen++;
+                if ((c & 0xC0) != 0x80)
+                    col++;
+                break;
+        }
+    }
+
+    return dlen;
+}
+
+long plain_text_end(const char *src, long slen)
+{
+    long pos[3];
+    char last[3];
+    int n = 0;
+    long x = slen;
+
+    /* look at the last 3 chars that make it through the filter */
+    while ((x > 0) && (n < 3)) {
+        unsigned char c = src[--x];
+        if ((c == '\t') || (c == '\n') || ((c >= 32) && (c != 127))) {
+            pos[n] = x;
+            last[n++] = c;
+        }
+    }
+
+    if ((n >= 2) && (last[0] == '\n') && (last[1] == '.') && ((n == 2) || (last[2] == '\n')))
+        return pos[1];
+    return slen;
+}
+
+long plain_text_size(const char *src, long slen)
+{
+    return filter(NULL, 0, src, plain_text_end(src, slen));
+}
+
+long process_plain_text(char *dst, long dstsize, const char *src, long slen)
+{
+    long dlen = filter(dst, dstsize, src, plain_text_end(src, slen));
+
+    /* terminate with a NUL-terminator */
+    dst[dlen] = '\0';
+    return dlen;
+}
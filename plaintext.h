@@ -0,0 +1,21 @@
+/*
+ * This file is part of the Gopherus project.
+ */
+
+#ifndef PLAINTEXT_H
+#define PLAINTEXT_H
+
+/* returns the length of src without its gopher end of file marker (a '.'
+ * alone on the last line), if any */
+long plain_text_end(const char *src, long slen);
+
+/* returns the exact length of what process_plain_text() makes of src */
+long plain_text_size(const char *src, long slen);
+
+/* filters out control chars and expands tabs to the next multiple of 8
+ * columns, and returns the length of the result. dst is dstsize bytes long,
+ * and dstsize must be at least plain_text_size(src, slen) + 1. dst may be
+ * src if src holds no tab, as the text then never gets longer. */
+long process_plain_text(char *dst, long dstsize, const char *src, long slen);
+
+#endif
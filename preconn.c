@@ -0,0 +1,108 @@
+/*
+ * This file is part of the Gopherus project.
+ *
+ * Holds the connections opened in advance to the server of the link the
+ * selection of a menu rests on, so that loading it does not have to wait
+ * for the connection to be established.
+ */
+
+#include <stdlib.h>    /* NULL */
+#include <time.h>      /* time() */
+#include "dnscache.h"
+#include "preconn.h"
+
+#define PRECONN_MAX 4      /* connections held at once */
+#define PRECONN_PERHOST 1  /* connections held to a same host, whatever the port */
+#define PRECONN_HOLD 10    /* seconds a connection is held before being closed unused */
+
+static struct preconn {
+    struct net_tcpsocket *sk;  /* NULL if the entry is free */
+    const char *host;          /* interned */
+    unsigned short port;
+    time_t since;
+} preconn_table[PRECONN_MAX];
+
+static void drop(struct preconn *p)
+{
+    net_abort(p->sk);
+    p->sk = NULL;
+}
+
+/* closes the connections held for too long */
+static void expire(void)
+{
+    time_t now = time(NULL);
+    int i;
+
+    for (i = 0; i < PRECONN_MAX; i++)
+        if ((preconn_table[i].sk != NULL) && (now - preconn_table[i].since >= PRECONN_HOLD))
+            drop(&preconn_table[i]);
+}
+
+void preconn_start(const struct url *url)
+{
+    struct preconn *p = NULL;
+    unsigned long ipaddr;
+    int i, samehost = 0;
+
+    expire();
+    for (i = 0; i < PRECONN_MAX; i++) {
+        if (preconn_table[i].sk == NULL) {
+            if (p == NULL)
+                p = &preconn_table[i];
+        } else if (preconn_table[i].host == url->host) {
+            samehost += 1;
+        }
+    }
+    if ((p == NULL) || (samehost >= PRECONN_PERHOST))
+        return;
+
+    /* a name still being resolved is not waited for: the user may be gone by then */
+    dnscache_collect(url->host, 0);
+    ipaddr = dnscache_ask(url->host);
+    if (ipaddr == 0)
+        return;
+
+    p->sk = net_connect(ipaddr, url->port);
+    p->host = url->host;
+    p->port = url->port;
+    p->since = time(NULL);
+}
+
+void preconn_keep(const struct url *url)
+{
+    int i;
+
+    for (i = 0; i < PRECONN_MAX; i++) {
+        if (preconn_table[i].sk == NULL)
+            continue;
+        if ((url == NULL) || (preconn_table[i].host != url->host) || (preconn_table[i].port != url->port))
+            drop(&preconn_table[i]);
+    }
+    expire();
+}
+
+struct net_tcpsocket *preconn_take(const char *host, unsigned short port)
+{
+    int i;
+
+    expire();
+    for (i = 0; i < PRECONN_MAX; i++) {
+        struct net_tcpsocket *sk = preconn_table[i].sk;
+        int res;
+
+        if ((sk == NULL) || (preconn_table[i].host != host) || (preconn_table[i].port != port))
+            continue;
+        preconn_table[i].sk = NULL;
+
+        /* nothing is expected from a server before it is asked for something:
+         * if an established connection is readable, it has been closed */
+        res = net_isconnected(sk);
+        if ((res < 0) || ((res > 0) && (net_wait(&sk, 1, 0) == 0))) {
+            net_abort(sk);
+            continue;
+        }
+        return sk;
+    }
+    return NULL;
+}
@@ -0,0 +1,24 @@
+/*
+ * This file is part of the Gopherus project.
+ */
+
+#ifndef PRECONN_H
+#define PRECONN_H
+
+#include "net.h"
+#include "parseurl.h"
+
+/* starts connecting in advance to the server of url, so that the connection
+ * is there already if url gets loaded. Nothing is done if the address of the
+ * server is not known yet, or if enough connections are held to its host. */
+void preconn_start(const struct url *url);
+
+/* closes the connections held to other servers than the one of url, or all
+ * of them if url is NULL */
+void preconn_keep(const struct url *url);
+
+/* returns a connection held to host:port that is still usable, which the
+ * caller owns then, or NULL if there is none. host is interned. */
+struct net_tcpsocket *preconn_take(const char *host, unsigned short port);
+
+#endif
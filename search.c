@@ -0,0 +1,129 @@
+/*
+ * This file is part of the Gopherus project.
+ *
+ * Case-insensitive substring search. Where SSE2 is available, 16 candidate
+ * positions are tested at once by comparing the first and the last char of
+ * the pattern (in both cases), and only the positions where both match get
+ * compared in full. On text this rejects nearly every position without
+ * looking at it twice.
+ */
+
+#include <string.h>    /* strlen() */
+#include "search.h"
+
+#if defined(__SSE2__) && defined(__GNUC__)
+#define SEARCH_SSE2
+#include <emmintrin.h>
+#endif
+
+static int lower(int c)
+{
+    return ((c >= 'A') && (c <= 'Z')) ? c + ('a' - 'A') : c;
+}
+
+static int upper(int c)
+{
+    return ((c >= 'a') && (c <= 'z')) ? c - ('a' - 'A') : c;
+}
+
+/* returns non-zero if the plen chars of pattern are found at text */
+static int matchat(const char *text, const char *pattern, long plen)
+{
+    long i;
+
+    for (i = 0; i < plen; i++)
+        if (lower((unsigned char)text[i]) != lower((unsigned char)pattern[i]))
+            return 0;
+    return 1;
+}
+
+#ifdef SEARCH_SSE2
+/* returns a bitmask of the positions among text[0..15] where the first and
+ * the last char of a plen chars long pattern both match */
+static int candidates(const char *text, long plen, __m128i flo, __m128i fup, __m128i llo, __m128i lup)
+{
+    __m128i a = _mm_loadu_si128((const __m128i *)text);
+    __m128i b = _mm_loadu_si128((const __m128i *)(text + plen - 1));
+    __m128i fa = _mm_or_si128(_mm_cmpeq_epi8(a, flo), _mm_cmpeq_epi8(a, fup));
+    __m128i lb = _mm_or_si128(_mm_cmpeq_epi8(b, llo), _mm_cmpeq_epi8(b, lup));
+    return _mm_movemask_epi8(_mm_and_si128(fa, lb));
+}
+#endif
+
+long search_next(const char *text, long len, const char *pattern, long from)
+{
+    long plen = strlen(pattern);
+    long last = len - plen; /* last position a match may start at */
+    long i = (from > 0) ? from : 0;
+    int first;
+
+    if (plen == 0)
+        return -1;
+    first = lower((unsigned char)pattern[0]);
+
+#ifdef SEARCH_SSE2
+    {
+        int lastc = lower((unsigned char)pattern[plen - 1]);
+        __m128i flo = _mm_set1_epi8((char)first);
+        __m128i fup = _mm_set1_epi8((char)upper(first));
+        __m128i llo = _mm_set1_epi8((char)lastc);
+        __m128i lup = _mm_set1_epi8((char)upper(lastc));
+
+        for (; i + 15 <= last; i += 16) {
+            int mask = candidates(text + i, plen, flo, fup, llo, lup);
+            while (mask != 0) {
+                int bit = __builtin_ctz(mask);
+                if (matchat(text + i + bit, pattern, plen))
+                    return i + bit;
+                mask &= mask - 1;
+            }
+        }
+    }
+#endif
+
+    for (; i <= last; i++)
+        if ((lower((unsigned char)text[i]) == first) && matchat(text + i, pattern, plen))
+            return i;
+
+    return -1;
+}
+
+long search_prev(const char *text, long len, const char *pattern, long before)
+{
+    long plen = strlen(pattern);
+    long i = len - plen; /* last position a match may start at */
+    int first;
+
+    if (plen == 0)
+        return -1;
+    if (i > before - 1)
+        i = before - 1;
+    first = lower((unsigned char)pattern[0]);
+
+#ifdef SEARCH_SSE2
+    {
+        int lastc = lower((unsigned char)pattern[plen - 1]);
+        __m128i flo = _mm_set1_epi8((char)first);
+        __m128i fup = _mm_set1_epi8((char)upper(first));
+        __m128i llo = _mm_set1_epi8((char)lastc);
+        __m128i lup = _mm_set1_epi8((char)upper(lastc));
+
+        /* blocks of 16 positions ending at i, walked backwards */
+        for (; i >= 15; i -= 16) {
+            int mask = candidates(text + i - 15, plen, flo, fup, llo, lup);
+            while (mask != 0) {
+                int bit = 31 - __builtin_clz(mask);
+                if (matchat(text + i - 15 + bit, pattern, plen))
+                    return i - 15 + bit;
+                mask &= ~(1 << bit);
+            }
+        }
+    }
+#endif
+
+    for (; i >= 0; i--)
+        if ((lower((unsigned char)text[i]) == first) && matchat(text + i, pattern, plen))
+            return i;
+
+    return -1;
+}
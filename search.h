@@ -0,0 +1,17 @@
+/*
+ * This file is part of the Gopherus project.
+ */
+
+#ifndef SEARCH_H
+#define SEARCH_H
+
+/* looks for pattern within the len bytes of text, ignoring the case of ASCII
+ * letters. Returns the offset of the first occurrence starting at or after
+ * from, or -1 if there is none. */
+long search_next(const char *text, long len, const char *pattern, long from);
+
+/* same as search_next(), but returns the offset of the last occurrence
+ * starting before offset before. */
+long search_prev(const char *text, long len, const char *pattern, long before);
+
+#endif
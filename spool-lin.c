@@ -0,0 +1,76 @@
+/*
+ * This file is part of the Gopherus project.
+ *
+ * Spool files for POSIX systems: temporary files mapped with mmap().
+ */
+
+#include <stdlib.h>    /* getenv(), NULL */
+#include <stdio.h>     /* fdopen(), snprintf() */
+#include <unistd.h>    /* unlink(), close(), ftruncate(), sysconf() */
+#include <sys/mman.h>  /* mmap() */
+#include "spool.h"
+
+FILE *spool_open(void)
+{
+    char path[256];
+    const char *dir = getenv("TMPDIR");
+    FILE *fd;
+    int fdnum;
+
+    if ((dir == NULL) || (dir[0] == 0))
+        dir = "/tmp";
+    if (snprintf(path, sizeof path, "%s/gopherus-XXXXXX", dir) >= (int)sizeof path)
+        return NULL;
+
+    fdnum = mkstemp(path);
+    if (fdnum < 0)
+        return NULL;
+    unlink(path); /* the file lives on as long as it is open or mapped */
+
+    fd = fdopen(fdnum, "w+b");
+    if (fd == NULL)
+        close(fdnum);
+    return fd;
+}
+
+char *spool_view(FILE *fd, long len, char *map, long *maplen)
+{
+    long size;
+    void *ptr;
+
+    /* the NUL terminator is part of the file, since what is mapped past its
+     * end cannot be read. What is written next goes over it. */
+    if ((fflush(fd) != 0) || (ftruncate(fileno(fd), len + 1) != 0))
+        return NULL;
+    if ((map != NULL) && (len <= *maplen))
+        return map;
+
+    /* a growing file is given room, so that it is mapped again only so often */
+    size = (map != NULL) ? *maplen * 2 : len;
+    if (size < len)
+        size = len;
+    ptr = mmap(NULL, size + 1, PROT_READ, MAP_SHARED, fileno(fd), 0);
+    if (ptr == MAP_FAILED)
+        return NULL;
+    madvise(ptr, size + 1, MADV_SEQUENTIAL);
+    if (map != NULL)
+        munmap(map, *maplen + 1);
+    *maplen = size;
+    return ptr;
+}
+
+void spool_release(char *ptr, long len)
+{
+    long pagesize = sysconf(_SC_PAGESIZE);
+    unsigned long start = ((unsigned long)ptr + pagesize - 1) & ~(unsigned long)(pagesize - 1);
+    unsigned long end = ((unsigned long)ptr + len) & ~(unsigned long)(pagesize - 1);
+
+    /* only whole pages can be released */
+    if (end > start)
+        madvise((void *)start, end - start, MADV_DONTNEED);
+}
+
+void spool_unmap(char *ptr, long maplen)
+{
+    munmap(ptr, maplen + 1);
+}
@@ -0,0 +1,26 @@
+/*
+ * This file is part of the Gopherus project.
+ * It provides stubs for systems without spool files: resources have to fit
+ * in memory there.
+ */
+
+#include <stdlib.h>  /* NULL */
+#include "spool.h"
+
+FILE *spool_open(void)
+{
+    return NULL;
+}
+
+char *spool_view(FILE *fd, long len, char *map, long *maplen)
+{
+    return NULL;
+}
+
+void spool_release(char *ptr, long len)
+{
+}
+
+void spool_unmap(char *ptr, long maplen)
+{
+}
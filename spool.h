@@ -0,0 +1,33 @@
+/*
+ * This file is part of the Gopherus project.
+ *
+ * Spool files keep the resources that are too large for memory. They are
+ * mapped in memory as they are written, so that only the parts being looked
+ * at need to be read.
+ */
+
+#ifndef SPOOL_H
+#define SPOOL_H
+
+#include <stdio.h>   /* FILE */
+
+/* creates a temporary file that is deleted once closed. Returns NULL if
+ * spool files are not supported, or on error. */
+FILE *spool_open(void);
+
+/* maps the len bytes written to the spool file fd so far in memory,
+ * read-only and followed by a NUL terminator, fd staying open for more to
+ * be written. map is what an earlier call returned for fd, or NULL, and
+ * *maplen the bytes mapped there: a mapping that has no room for len bytes
+ * is replaced by a larger one. The mapping outlives fd. Returns NULL on
+ * error, map being left as it is then. */
+char *spool_view(FILE *fd, long len, char *map, long *maplen);
+
+/* lets the system take back the memory used by the pages of [ptr, ptr+len)
+ * within a mapping. They are read again from the file when needed. */
+void spool_release(char *ptr, long len);
+
+/* unmaps what spool_view() mapped, maplen being the bytes mapped there */
+void spool_unmap(char *ptr, long maplen);
+
+#endif
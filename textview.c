@@ -4,68 +4,434 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "alloca.h"
+#include "bookmark.h"
+#include "bufpool.h"
 #include "common.h"
 #include "gopher.h"
 #include "history.h"
+#include "html.h"
+#include "lineidx.h"
+#include "loadfile.h"
 #include "parseurl.h"
+#include "plaintext.h"
+#include "search.h"
+#include "snprintf.h"
+#include "spool.h"
 #include "textview.h"
 #include "ui.h"
+#include "utf8.h"
 #include "wordwrap.h"
 
-static int display_text_loop(struct gopherus *g)
+/* bytes indexed at once while no key is pressed */
+#define INDEX_CHUNK (1024l * 1024l)
+
+/* usec spent at once receiving a text that is still coming, while no key is pressed */
+#define RECEIVE_USEC 100000l
+
+/* a document ready for display, kept in the history for as long as its
+ * location is, so that going back to it costs a single screen draw */
+struct textdoc {
+    char *text;                 /* display-ready text */
+    long len;                   /* length of text */
+    struct loadfile_spool *spool; /* the spool file text is the raw content of, or NULL */
+    int inplace;                /* text lies in the cache of the location, rather than in memory of its own */
+    struct lineidx idx;         /* where the wrapped lines of text start */
+    struct htmllinks links;     /* links of an html document, their href being within hrefs */
+    char *hrefs;                /* targets of the links, decoded and NUL-terminated */
+    long firstline;             /* line at the top of the screen */
+    long selected;              /* selected link, or -1 */
+    long *screen;               /* offsets of the lines on screen, then where the last one ends */
+    long screensize;            /* number of offsets screen has room for */
+    long screenlines;           /* number of lines on screen */
+};
+
+static char searchpattern[64]; /* kept from one document to the next */
+
+/* indexes about INDEX_CHUNK more bytes of the text. The pages of a spool
+ * file are let go once indexed, so that memory use does not grow with it. */
+static void index_chunk(struct textdoc *doc)
+{
+    long from = doc->idx.next;
+
+    lineidx_extend(&(doc->idx), from + INDEX_CHUNK);
+    if (doc->spool != NULL)
+        spool_release(doc->text + from, ((doc->idx.next < 0) ? doc->len : doc->idx.next) - from);
+}
+
+/* tells whether the text is still coming */
+static int coming(const struct textdoc *doc)
+{
+    return (doc->spool != NULL) && (doc->spool->done == 0);
+}
+
+/* makes doc follow the spool file its text comes from, that may have grown
+ * (and moved). Only whole lines are shown while the rest is coming, since
+ * the way the last one is wrapped depends on what follows. */
+static void follow_spool(struct textdoc *doc)
+{
+    const struct loadfile_spool *spool = doc->spool;
+    long len = spool->len;
+
+    if (coming(doc))
+        while ((len > doc->len) && (spool->text[len - 1] != '\n'))
+            len--;
+    len = plain_text_end(spool->text, len);
+    if (len < doc->len) /* a line made of a dot was taken for the end, until more came */
+        len = doc->len;
+
+    if ((len > doc->len) || (spool->text != doc->text)) {
+        lineidx_grow(&(doc->idx), spool->text, len);
+        doc->text = spool->text;
+        doc->len = len;
+    }
+}
+
+/* receives more of a text that is still coming. Returns 0 if all of it
+ * came already, non-zero otherwise. */
+static int receive_text(struct gopherus *g, struct textdoc *doc)
+{
+    struct historytype *node = g->history;
+
+    if (!coming(doc))
+        return 0;
+
+    loadfile_more(doc->spool, RECEIVE_USEC, g->statusbar);
+    node->cache = doc->spool->text;
+    node->cachesize = doc->spool->len;
+    follow_spool(doc);
+    return 1;
+}
+
+/* waits for the rest of a text that is still coming, telling how it goes.
+ * Returns 0 once there is nothing more to come, non-zero if the user would
+ * rather not wait. */
+static int receive_all(struct gopherus *g, struct textdoc *doc)
 {
+    char msg[80];
+
+    while (receive_text(g, doc) != 0) {
+        if (is_int_pending())
+            return -1;
+        if (coming(doc)) {
+            sprintf(msg, "Downloading the rest... [%ld bytes] (ESC to stop waiting)", doc->spool->len);
+            draw_statusbar(msg, &(g->cfg));
+        }
+    }
+
+    return 0;
+}
+
+/* indexes the text up to line lineno, if it goes that far, waiting for it
+ * if it is still coming */
+static void index_lines(struct gopherus *g, struct textdoc *doc, long lineno)
+{
+    while ((doc->idx.count <= lineno) && ((doc->idx.next >= 0) || (receive_text(g, doc) != 0))) {
+        if (doc->idx.next >= 0)
+            lineidx_extend(&(doc->idx), doc->idx.next);
+    }
+}
+
+/* returns the number of the line containing offset, indexing the text that
+ * far if needed */
+static long line_at(struct textdoc *doc, long offset)
+{
+    while ((doc->idx.next >= 0) && (doc->idx.next <= offset))
+        index_chunk(doc);
+    return lineidx_find(&(doc->idx), offset);
+}
+
+/* finds where the lines of the screen start, from line firstline on */
+static void locate_screen(struct gopherus *g, struct textdoc *doc, long firstline)
+{
+    long pagelines = ui_rows - 2;
+
+    index_lines(g, doc, firstline + pagelines);
+    doc->screenlines = lineidx_lines(&(doc->idx), firstline, pagelines, doc->screen);
+}
+
+/* returns c as it is drawn: the raw text of a spool file may hold control chars */
+static unsigned long screenchar(const struct textdoc *doc, unsigned long c)
+{
+    if ((doc->spool != NULL) && ((c < 32) || (c == 127)))
+        return ' ';
+    return c;
+}
+
+/* draws the lines of the screen */
+static void draw_text(struct gopherus *g, const struct textdoc *doc)
+{
+    char *linebuff = (doc->spool != NULL) ? alloca(WORDWRAP_BUFSIZE(ui_cols)) : NULL;
     unsigned int x;
-    long firstline = 1;
-    int scroll = -1; /* initial movement to force screen update */
-    long lastrow = ui_rows - 2;
-    char *txtptr;
-    int eof_flag = 0;
-    char *linebuff = alloca(ui_cols + 1);
+    long y;
+
+    for (y = 0; y < (long)ui_rows - 2; y++) {
+        if (y < doc->screenlines) {
+            const char *line = doc->text + doc->screen[y];
+            int i, linelen;
+            wordwrap_span(line, doc->len - doc->screen[y], ui_cols, &linelen);
+            if (linebuff != NULL) { /* control chars have to be blanked out first */
+                for (i = 0; i < linelen; i++)
+                    linebuff[i] = screenchar(doc, (unsigned char)line[i]);
+                line = linebuff;
+            }
+            draw_field(line, g->cfg.attr_textnorm, 0, y + 1, ui_cols, linelen);
+        } else { /* fill the rest of the screen (if any left) with blanks */
+            for (x = 0; x < ui_cols; x++)
+                ui_putchar(' ', g->cfg.attr_textnorm, x, y + 1);
+        }
+    }
+}
+
+/* computes the offsets of the text visible on screen */
+static void screenrange(const struct textdoc *doc, long *start, long *end)
+{
+    *start = doc->screen[0];
+    *end = doc->screen[doc->screenlines];
+}
+
+/* paints the chars of the text from offset start to end with attr, wherever
+ * they are visible on screen. The span may be wrapped over several lines. */
+static void paint_span(const struct textdoc *doc, long start, long end, int attr)
+{
+    long y, o;
+
+    for (y = 0; y < doc->screenlines; y++) {
+        long linestart = doc->screen[y];
+        long lineend = (doc->screen[y + 1] < end) ? doc->screen[y + 1] : end;
+        const char *ptr = doc->text + linestart;
+        long col = 0;
+
+        if (lineend <= start)
+            continue;
+
+        if (utf8_isascii(ptr, lineend - linestart)) { /* a byte is a column */
+            for (o = (start > linestart) ? start : linestart; o < lineend; o++) {
+                if ((o - linestart < (long)ui_cols) && (doc->text[o] != '\n'))
+                    ui_putchar(screenchar(doc, doc->text[o]), attr, o - linestart, y + 1);
+            }
+            continue;
+        }
+
+        /* walk the line to know the column of every char */
+        while (ptr < doc->text + lineend) {
+            const char *chr = ptr;
+            unsigned long cp = utf8_decode(&ptr);
+            int w = utf8_width(cp);
+            if ((cp == '\n') || (col + w > (long)ui_cols))
+                break;
+            if ((chr - doc->text >= start) && (w > 0))
+                ui_putglyph(screenchar(doc, cp), attr, col, y + 1);
+            col += w;
+        }
+    }
+}
+
+/* highlights all the occurrences of the search pattern visible on screen */
+static void draw_hits(struct gopherus *g, const struct textdoc *doc)
+{
+    long plen = strlen(searchpattern);
+    long start, end, hit;
+
+    if (plen == 0)
+        return;
+
+    screenrange(doc, &start, &end);
+    for (hit = search_next(doc->text, doc->len, searchpattern, start); (hit >= 0) && (hit < end);
+         hit = search_next(doc->text, doc->len, searchpattern, hit + plen))
+        paint_span(doc, hit, hit + plen, g->cfg.attr_menucurrent);
+}
+
+/* formats the position indicator of the status bar */
+static void describe_position(const struct textdoc *doc, long firstline, char *msg)
+{
+    const struct lineidx *idx = &(doc->idx);
+    long lastline = firstline + doc->screenlines;
+
+    if (coming(doc)) {
+        sprintf(msg, "Lines %ld-%ld of %ld+ (downloading, %ld KiB)", firstline + 1, lastline, idx->count,
+                doc->spool->len / 1024);
+    } else if (idx->next >= 0) { /* the number of lines is not known yet */
+        sprintf(msg, "Lines %ld-%ld of %ld+ (indexing, %ld%%)", firstline + 1, lastline, idx->count,
+                idx->next / (doc->len / 100 + 1));
+    } else {
+        sprintf(msg, "Lines %ld-%ld of %ld (%ld%%)", firstline + 1, lastline, idx->count,
+                (idx->count > 0) ? (lastline * 100) / idx->count : 100);
+    }
+}
+
+/* returns the index of the first link ending after offset */
+static long findlink(const struct htmllinks *links, long offset)
+{
+    long lo = 0, hi = links->count;
+
+    while (lo < hi) {
+        long mid = lo + (hi - lo) / 2;
+        if (links->link[mid].end <= offset) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+/* draws the links visible on screen, the selected one being highlighted */
+static void draw_links(struct gopherus *g, const struct textdoc *doc, long selected)
+{
+    const struct htmllinks *links = &(doc->links);
+    long start, end, i;
+
+    screenrange(doc, &start, &end);
+    for (i = findlink(links, start); (i < links->count) && (links->link[i].start < end); i++)
+        paint_span(doc, links->link[i].start, links->link[i].end,
+                   (i == selected) ? g->cfg.attr_menucurrent : g->cfg.attr_menuselectable);
+}
+
+/* copies the target of link into dst, a buffer of size bytes */
+static void linkhref(char *dst, size_t size, const struct textdoc *doc, const struct htmllink *link)
+{
+    size_t len = link->hreflen;
+    if (len >= size)
+        len = size - 1;
+    memcpy(dst, doc->hrefs + link->href, len);
+    dst[len] = 0;
+}
+
+/* builds the url a link points to, relative links being resolved against the
+ * current location. str is used as storage for the url. Returns 0 on
+ * success, non-zero if the link cannot be followed. */
+static int resolve_link(struct gopherus *g, const struct textdoc *doc, const struct htmllink *link, char *str, size_t size, struct url *url)
+{
+    const struct url *base = &(g->history->url);
+    char href[256];
+    char *ptr;
+
+    linkhref(href, sizeof href, doc, link);
+    ptr = strchr(href, '#'); /* the position within the page is of no use */
+    if (ptr != NULL)
+        *ptr = 0;
+    if (href[0] == 0)
+        return -1;
+
+    ptr = href + strcspn(href, ":/?");
+    if (strstr(href, "://") == ptr) { /* absolute url */
+        snprintf(str, size, "%s", href);
+    } else if (*ptr == ':') { /* mailto: and alike */
+        return -1;
+    } else if ((href[0] == '/') && (href[1] == '/')) { /* same protocol, other host */
+        snprintf(str, size, "%s:%s", (base->protocol == PARSEURL_PROTO_HTTP) ? "http" : "gopher", href);
+    } else {
+        const char *lastslash = strrchr(base->selector, '/');
+        int dirlen = ((href[0] == '/') || (lastslash == NULL)) ? 0 : lastslash - base->selector + 1;
+        if (base->protocol == PARSEURL_PROTO_HTTP) {
+            snprintf(str, size, "http://%s:%u/%.*s%s", base->host, base->port, dirlen, base->selector,
+                     href + (href[0] == '/'));
+        } else { /* guess the gopher itemtype from the name */
+            size_t len = strlen(href);
+            char itemtype = GOPHER_ITEM_FILE;
+            if (href[len - 1] == '/') {
+                itemtype = GOPHER_ITEM_DIR;
+            } else if (((len > 4) && (strcasecmp(href + len - 4, ".htm") == 0)) ||
+                       ((len > 5) && (strcasecmp(href + len - 5, ".html") == 0))) {
+                itemtype = GOPHER_ITEM_HTML;
+            }
+            snprintf(str, size, "gopher://%s:%u/%c%.*s%s", base->host, base->port, itemtype, dirlen,
+                     base->selector, href);
+        }
+    }
+
+    return parse_url(str, url);
+}
+
+/* asks for a new search pattern. returns 0 if aborted, non-zero otherwise. */
+static int ask_search_pattern(struct gopherus *g)
+{
+    static const char prompt[] = "Find: ";
+    char emptymsg[2] = {0};
+
+    draw_statusbar(emptymsg, &(g->cfg)); /* make sure to clear out the status bar */
+    ui_cputs(prompt, 0x70, 0, ui_rows - 1);
+    return editstring(searchpattern, sizeof searchpattern, ui_cols - (sizeof prompt - 1),
+                      sizeof prompt - 1, ui_rows - 1, 0x70, NULL);
+}
+
+/* looks for the next (or previous) occurrence of the search pattern. The
+ * search starts from the last hit if it is still on screen, and from the top
+ * of the screen otherwise. Returns the offset of the hit, or -1. */
+static long find_hit(const struct textdoc *doc, long lasthit, int backward)
+{
+    long start, end;
+
+    screenrange(doc, &start, &end);
+
+    if ((lasthit < start) || (lasthit >= end))
+        return backward ? search_prev(doc->text, doc->len, searchpattern, start)
+                        : search_next(doc->text, doc->len, searchpattern, start);
+
+    return backward ? search_prev(doc->text, doc->len, searchpattern, lasthit)
+                    : search_next(doc->text, doc->len, searchpattern, lasthit + 1);
+}
+
+static int display_text_loop(struct gopherus *g, struct textdoc *doc)
+{
+    const struct lineidx *idx = &(doc->idx);
+    const struct htmllinks *links = &(doc->links);
+    long firstline = doc->firstline;
+    long pagelines = ui_rows - 2;
+    long lastfirstline;
+    long lasthit = -1;
+    long selected = doc->selected;
+    int redraw = 1;
+    int showpos = 0; /* the status bar shows the position indicator */
+    unsigned int rows = ui_rows, cols = ui_cols; /* the screen the text is laid out for */
+    char msg[128];
     int key;
 
     for (;;) {
-        if (scroll != 0)
-        {
-            if (scroll < 0 && firstline == 0) {
-                set_statusbar(g->statusbar, "Reached top of file");
-            } else if (scroll > 0 && eof_flag) {
-                set_statusbar(g->statusbar, "Reached end of file");
-            } else {
-                long y = 1;
-                long lineno = 0;
-
-                firstline += scroll;
-                if (firstline < 0)
-                    firstline = 0;
-
-                for (txtptr = g->buf; txtptr != NULL && y <= lastrow; lineno++) {
-                    txtptr = wordwrap(linebuff, txtptr, ui_cols);
-                    if (lineno >= firstline) {
-                        draw_field(linebuff, g->cfg.attr_textnorm, 0, y, ui_cols, -1);
-                        y++;
-                    }
-                }
+        long newline;
 
-                if (y <= lastrow) {
-                    eof_flag = 1;
+        if ((ui_rows != rows) || (ui_cols != cols)) /* the screen got resized */
+            return DISPLAY_ORDER_NONE;
 
-                    /* fill the rest of the screen (if any left) with blanks */
-                    for (; y <= lastrow; y++) {
-                        for (x = 0; x < ui_cols; x++)
-                            ui_putchar(' ', g->cfg.attr_textnorm, x, y);
-                    }
-                } else {
-                    eof_flag = 0;
-                }
-            }
+        if (redraw) {
+            locate_screen(g, doc, firstline);
+            draw_text(g, doc);
+            draw_links(g, doc, selected);
+            draw_hits(g, doc);
+            describe_position(doc, firstline, msg);
+            showpos = (g->statusbar[0] == 0);
+            set_statusbar(g->statusbar, msg);
+        } else if (g->statusbar[0] != 0) {
+            showpos = 0;
+        }
 
+        if (redraw || (g->statusbar[0] != 0))
             draw_statusbar(g->statusbar, &(g->cfg));
-            scroll = 0;
+        redraw = 0;
+
+        /* go on indexing the text until a key is pressed, and receiving it if
+         * it is still coming */
+        while (ui_kbhit() == 0) {
+            if (idx->next >= 0) {
+                index_chunk(doc);
+            } else if (receive_text(g, doc) == 0) {
+                break;
+            }
+            if (g->statusbar[0] != 0) { /* the transfer failed */
+                draw_statusbar(g->statusbar, &(g->cfg));
+                showpos = 0;
+            } else if (showpos) {
+                describe_position(doc, firstline, msg);
+                draw_statusbar(msg, &(g->cfg));
+            }
         }
 
         key = ui_getkey();
+        newline = firstline;
 
         switch (key) {
             case KEY_BACKSPACE:
@@ -77,177 +443,316 @@ static int display_text_loop(struct gopherus *g)
             case KEY_ESCAPE:
                 if (ask_quit_confirmation(&(g->cfg)) != 0)
                     return DISPLAY_ORDER_QUIT;
+                redraw = 1; /* restore the position indicator */
                 break;
             case KEY_F1: /* help */
                 go_to_help(g);
                 return DISPLAY_ORDER_NONE;
+            case KEY_F2: /* bookmarks */
+                go_to_bookmarks(g);
+                return DISPLAY_ORDER_NONE;
             case KEY_F5: /* refresh */
                 return DISPLAY_ORDER_REFR;
             case KEY_F9: /* download */
             {
                 struct url download_url = g->history->url;
                 download_url.itemtype = GOPHER_ITEM_BINARY;
-                history_add(&(g->history), &download_url);
+                history_add_replicas(&(g->history), &download_url, g->history->replica, g->history->replicacount);
                 return DISPLAY_ORDER_NONE;
             }
             case KEY_UP:
-                scroll = -1;
+                newline -= 1;
                 break;
             case KEY_DOWN:
-                scroll = 1;
+                newline += 1;
                 break;
             case KEY_HOME:
-                scroll = -firstline;
+                newline = 0;
                 break;
             case KEY_PAGEUP:
-                scroll = -(ui_rows - 3);
+                newline -= ui_rows - 3;
                 break;
-            case KEY_END:
+            case KEY_END: /* the whole text has to be there, and indexed, first */
+                if (receive_all(g, doc) != 0) {
+                    redraw = 1;
+                    break;
+                }
+                while (idx->next >= 0) {
+                    sprintf(msg, "Indexing... %ld%%", idx->next / (doc->len / 100 + 1));
+                    draw_statusbar(msg, &(g->cfg));
+                    index_chunk(doc);
+                }
+                newline = idx->count;
                 break;
             case KEY_PAGEDOWN:
-                scroll = ui_rows - 3;
+                newline += ui_rows - 3;
                 break;
             case KEY_QUIT: /* QUIT IMMEDIATELY */
                 return 1;
-            default:  /* unhandled key */
-                /* sprintf(linebuff, "Got invalid key: 0x%02lX", key);
-                   set_statusbar(g->statusbar, linebuff); */
-                break;
-        }
-    }
-}
-
-static void process_html(char *dst, const char *src, long slen)
-{
-    int lastcharwasaspace = 0;
-    int insidetoken = -1;
-    int insidescript = 0;
-    char token[8];
-    char specialchar[8];
-    int insidespecialchar = -1;
-    long dlen = 0;
-    long x;
-
-    for (x = 0; x < slen; x++) {
-        if ((insidescript != 0) && (insidetoken < 0) && (src[x] != '<'))
-            continue;
-
-        switch (src[x]) {
-            case '\t':  /* replace whitespaces by single spaces */
-            case '\n':
-            case '\r':
-            case ' ':
-                if (insidetoken >= 0) {
-                    if (insidetoken < 7) token[insidetoken++] = 0;
-                    continue;
+            case KEY_LEFT: /* previous link */
+            case KEY_RIGHT: /* next link */
+            {
+                long start, end, next, linkline;
+                char urlstr[512];
+                struct url url;
+                screenrange(doc, &start, &end);
+                if ((selected >= 0) && (links->link[selected].end > start) && (links->link[selected].start < end)) {
+                    next = selected + ((key == KEY_RIGHT) ? 1 : -1);
+                } else { /* start from the screen, not from a link that has been scrolled away */
+                    next = (key == KEY_RIGHT) ? findlink(links, start) : findlink(links, end) - 1;
                 }
-                if (lastcharwasaspace == 0) {
-                    dst[dlen++] = ' ';
-                    lastcharwasaspace = 1;
+                if ((next < 0) || (next >= links->count)) {
+                    set_statusbar(g->statusbar, "No more links");
+                    break;
                 }
+                selected = next;
+                doc->selected = selected;
+                redraw = 1;
+                linkline = line_at(doc, links->link[selected].start);
+                if ((linkline < firstline) || (linkline >= firstline + pagelines))
+                    newline = linkline;
+                /* show where the link leads to */
+                if (resolve_link(g, doc, &(links->link[selected]), urlstr, sizeof urlstr, &url) == 0) {
+                    build_url(msg, sizeof msg, &url);
+                } else {
+                    linkhref(msg, sizeof msg, doc, &(links->link[selected]));
+                }
+                set_statusbar(g->statusbar, msg);
                 break;
-            case '<':
-                lastcharwasaspace = 0;
-                insidetoken = 0;
-                break;
-            case '>':
-                lastcharwasaspace = 0;
-                if (insidetoken < 0) continue;
-                token[insidetoken] = 0;
-                insidetoken = -1;
-                if ((strcasecmp(token, "/p") == 0) || (strcasecmp(token, "br") == 0) || (strcasecmp(token, "/tr") == 0) || (strcasecmp(token, "/title") == 0)) {
-                    dst[dlen++] = '\n';
-                } else if (strcasecmp(token, "script") == 0) {
-                    insidescript = 1;
-                } else if (strcasecmp(token, "/script") == 0) {
-                    insidescript = 0;
+            }
+            case KEY_ENTER: /* follow the selected link */
+            {
+                char urlstr[512];
+                struct url url;
+                if (selected < 0)
+                    break;
+                if (resolve_link(g, doc, &(links->link[selected]), urlstr, sizeof urlstr, &url) != 0) {
+                    set_statusbar(g->statusbar, "!This link cannot be followed");
+                    break;
                 }
+                history_add(&(g->history), &url);
+                return DISPLAY_ORDER_NONE;
+            }
+            case 'b': /* bookmark the document, described by its URL */
+                build_url(msg, sizeof msg, &(g->history->url));
+                bookmark_add(&(g->history->url), msg, strlen(msg), g->statusbar);
+                redraw = 1;
                 break;
-            default:
-                lastcharwasaspace = 0;
-
-                if (insidetoken >= 0) {
-                    if (insidetoken < 7) token[insidetoken++] = src[x];
-                    continue;
+            case '/': /* find */
+                if (ask_search_pattern(g) == 0) {
+                    redraw = 1;
+                    break;
                 }
-
-                if ((insidespecialchar < 0) && (src[x] == '&')) {
-                    insidespecialchar = 0;
-                    continue;
+                lasthit = -1;
+                /* FALLTHRU */
+            case 'n': /* find next */
+            case 'N': /* find previous */
+            {
+                long hit, hitline;
+                if (searchpattern[0] == 0) {
+                    set_statusbar(g->statusbar, "Press / to enter a text to look for");
+                    break;
                 }
-
-                if ((insidespecialchar >= 0) && (insidespecialchar < 7)) {
-                    if (src[x] != ';') {
-                        specialchar[insidespecialchar++] = src[x];
-                        continue;
+                hit = find_hit(doc, lasthit, key == 'N');
+                if ((hit < 0) && (key != 'N') && coming(doc) && (receive_all(g, doc) == 0))
+                    hit = find_hit(doc, lasthit, 0); /* it may be in what was still to come */
+                redraw = 1; /* highlight the hits, or restore the status bar */
+                if (hit < 0) {
+                    sprintf(msg, "!Not found: %.60s", searchpattern);
+                    set_statusbar(g->statusbar, msg);
+                    break;
+                }
+                lasthit = hit;
+                hitline = line_at(doc, hit);
+                if ((hitline < firstline) || (hitline >= firstline + pagelines))
+                    newline = hitline;
+                break;
+            }
+            default:
+                if ((key >= '0') && (key <= '9')) { /* jump to 0%, 10%, ... 90% of the file */
+                    if (receive_all(g, doc) != 0) {
+                        redraw = 1;
+                        break;
                     }
-                    specialchar[insidespecialchar] = 0;
-                    if (strcasecmp(specialchar, "nbsp") == 0) {
-                        dst[dlen++] = ' ';
-                    } else {
-                        dst[dlen++] = '_';
+                    if (idx->next < 0) {
+                        newline = (idx->count * (key - '0')) / 10;
+                    } else { /* the number of lines is not known yet */
+                        newline = line_at(doc, (doc->len / 10) * (key - '0'));
                     }
-                    insidespecialchar = -1;
-                    continue;
                 }
-
-                if (src[x] < 32)
-                    break; /* ignore ascii control chars */
-                dst[dlen++] = src[x]; /* copy everything else */
+                /* sprintf(msg, "Got invalid key: 0x%02lX", key);
+                   set_statusbar(g->statusbar, msg); */
                 break;
         }
+
+        /* the last screen is only known once the whole text is indexed */
+        index_lines(g, doc, newline + pagelines);
+        if ((idx->next >= 0) || coming(doc)) {
+            lastfirstline = idx->count;
+        } else {
+            lastfirstline = (idx->count > pagelines) ? idx->count - pagelines : 0;
+        }
+
+        if (newline < 0) {
+            if (firstline == 0)
+                set_statusbar(g->statusbar, "Reached top of file");
+            newline = 0;
+        } else if (newline > lastfirstline) {
+            if (firstline == lastfirstline)
+                set_statusbar(g->statusbar, "Reached end of file");
+            newline = lastfirstline;
+        }
+
+        if (newline != firstline) {
+            firstline = newline;
+            doc->firstline = firstline;
+            redraw = 1;
+        }
+    }
+}
+
+/* copies the targets of the links into a pool of their own, so that the
+ * html source is not needed anymore. Returns 0 on success. */
+static int pool_hrefs(struct textdoc *doc, const char *src)
+{
+    struct htmllinks *links = &(doc->links);
+    long i, size = 1, pos = 0;
+
+    /* html_linkhref() wants room for a whole UTF-8 sequence past the end */
+    for (i = 0; i < links->count; i++)
+        size += links->link[i].hreflen + 4;
+    doc->hrefs = malloc(size);
+    if (doc->hrefs == NULL)
+        return -1;
+
+    /* decoding entities never makes a target longer */
+    for (i = 0; i < links->count; i++) {
+        struct htmllink *link = &(links->link[i]);
+        html_linkhref(doc->hrefs + pos, link->hreflen + 4, src, link);
+        link->href = pos;
+        link->hreflen = strlen(doc->hrefs + pos);
+        pos += link->hreflen + 1;
     }
 
-    /* terminate with a NUL-terminator */
-    dst[dlen] = '\0';
+    return 0;
 }
 
-static void process_plain_text(char *dst, const char *src, long slen)
+static void free_textdoc(void *ptr)
 {
-    long dlen = 0;
-    int i;
+    struct textdoc *doc = ptr;
 
-    for (; slen > 0; slen--, src++) {
-        switch (*src) {
-            case '\t':  /* replace tabs by 8 spaces */
-                for (i = 0; i < 8; i++)
-                    dst[dlen++] = ' ';
-                break;
-            case '\n':  /* preserve line feeds */
-                dst[dlen++] = '\n';
-                break;
-            case '\r':  /* ignore CR chars */
-            case 127:   /* as well as DEL chars */
-                break;
-            default:
-                if (*src < 32)
-                    break; /* ignore ascii control chars */
-                dst[dlen++] = *src; /* copy everything else */
-                break;
+    lineidx_free(&(doc->idx));
+    html_freelinks(&(doc->links));
+    free(doc->hrefs);
+    free(doc->screen);
+    if (!doc->inplace)
+        free(doc->text);
+    free(doc);
+}
+
+/* makes the raw resource of the current location ready for display.
+ * Returns NULL if out of memory. */
+static struct textdoc *make_textdoc(struct gopherus *g, int txtformat)
+{
+    char *src = g->history->cache;
+    long srclen = g->history->cachesize;
+    struct textdoc *doc = malloc(sizeof *doc);
+
+    if (doc == NULL)
+        return NULL;
+    memset(doc, 0, sizeof *doc);
+    doc->selected = -1;
+
+    if ((txtformat == TXT_FORMAT_RAW) && (g->history->spool != NULL)) {
+        /* a spooled text is too large to be copied: it is shown as it is,
+         * and only the parts looked at are ever read */
+        doc->text = src;
+        doc->spool = g->history->spool;
+        doc->inplace = 1;
+    } else if ((txtformat == TXT_FORMAT_RAW) && (memchr(src, '\t', srclen) == NULL)) {
+        /* without tabs, the text gets no longer: it is made ready for display
+         * right where it has been received */
+        doc->len = process_plain_text(src, srclen + 1, src, srclen);
+        doc->text = src;
+        doc->inplace = 1;
+    } else if (txtformat == TXT_FORMAT_HTM) {
+        doc->text = malloc(srclen + 1);
+        if (doc->text != NULL) {
+            char *shrunk;
+            doc->len = process_html(doc->text, src, srclen, &(doc->links));
+            shrunk = realloc(doc->text, doc->len + 1); /* markup takes room */
+            if (shrunk != NULL)
+                doc->text = shrunk;
         }
+    } else {
+        long size = plain_text_size(src, srclen) + 1; /* tabs are expanded, so text may grow */
+        doc->text = malloc(size);
+        if (doc->text != NULL)
+            doc->len = process_plain_text(doc->text, size, src, srclen);
     }
 
-    /* check if there is a single . on the last line */
-    if (dlen >= 2 && (dst[dlen-1] == '\n') && (dst[dlen-2] == '.'))
-        dlen -= 2;
+    if ((doc->text == NULL) || ((txtformat == TXT_FORMAT_HTM) && (pool_hrefs(doc, src) != 0))) {
+        free_textdoc(doc);
+        return NULL;
+    }
 
-    /* terminate with a NUL-terminator */
-    dst[dlen] = '\0';
+    lineidx_init(&(doc->idx), doc->text, doc->len, ui_cols);
+    if (doc->spool != NULL)
+        follow_spool(doc);
+    return doc;
 }
 
 int display_text(struct gopherus *g, int txtformat)
 {
-    char buf[80];
-    sprintf(buf, "File loaded (%ld bytes)", g->history->cachesize);
-    set_statusbar(g->statusbar, buf);
+    struct historytype *node = g->history;
+    struct textdoc *doc = node->display;
+
+    if (doc == NULL) { /* the first time the location is displayed */
+        char buf[80];
+        if ((node->spool == NULL) || (node->spool->done != 0)) { /* the position tells how the rest comes */
+            sprintf(buf, "File loaded (%ld bytes)", node->cachesize);
+            set_statusbar(g->statusbar, buf);
+        }
 
-    /* copy the content of the file into g->buf, and take care to modify
-     * dangerous chars and apply formating (if any) */
+        doc = make_textdoc(g, txtformat);
+        if (doc == NULL) {
+            set_statusbar(g->statusbar, "!Out of memory");
+            return DISPLAY_ORDER_BACK;
+        }
+        node->display = doc;
+        node->display_free = free_textdoc;
+        node->displaysize = sizeof *doc + (doc->inplace ? 0 : doc->len + 1) +
+                            doc->links.size * sizeof(struct htmllink);
 
-    if (txtformat == TXT_FORMAT_HTM)
-        process_html(g->buf, g->history->cache, g->history->cachesize);
-    else
-        process_plain_text(g->buf, g->history->cache, g->history->cachesize);
+        /* the raw form is of no use anymore (saving downloads it again) */
+        if (!doc->inplace) {
+            bufpool_free(node->cache);
+            node->cache = NULL;
+            node->cachesize = 0;
+        }
+
+        /* the text is wrapped as it is looked at, and in the background. The
+         * first chunk right away, so that short texts are done at once. */
+        index_chunk(doc);
+    } else if (doc->idx.width != (int)ui_cols) { /* the screen changed since */
+        long top[2]; /* the text at the top of the screen stays there */
+        lineidx_lines(&(doc->idx), doc->firstline, 1, top);
+        lineidx_free(&(doc->idx));
+        lineidx_init(&(doc->idx), doc->text, doc->len, ui_cols);
+        index_chunk(doc);
+        doc->firstline = line_at(doc, top[0]);
+    }
+
+    if (doc->screensize < (long)ui_rows) { /* the screen got taller */
+        long *screen = realloc(doc->screen, ui_rows * sizeof *screen);
+        if (screen == NULL) {
+            set_statusbar(g->statusbar, "!Out of memory");
+            return DISPLAY_ORDER_BACK;
+        }
+        node->displaysize += (ui_rows - doc->screensize) * sizeof *screen;
+        doc->screen = screen;
+        doc->screensize = ui_rows;
+    }
 
-    return display_text_loop(g);
+    return display_text_loop(g, doc);
 }
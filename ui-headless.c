@@ -0,0 +1,314 @@
+/*
+ * This file is part of the gopherus project.
+ * It provides abstract functions to draw on screen.
+ *
+ * Provides all UI functions used by Gopherus without any display at all:
+ * the screen is an in-memory grid of cells, and key presses are replayed
+ * from a script read on stdin. Every action of the script is reported on
+ * stdout with the time Gopherus needed to process it and a checksum of the
+ * resulting screen, which makes it suitable for repeatable benchmarks.
+ *
+ * The script contains one action per line. Empty lines and lines starting
+ * with '#' are ignored.
+ *
+ *   open URL       types URL into the URL bar and validates it (switching
+ *                  to the URL bar and clearing it is not timed)
+ *   type TEXT      types TEXT as a sequence of key presses
+ *   KEY [xN]       presses KEY (N times), KEY being one of: up, down, left,
+ *                  right, pgup, pgdn, home, end, enter, back, tab, esc, del
+ *                  or f1..f10
+ *   dump           prints the current screen content
+ *   quit           quits Gopherus (this is implied at the end of the script)
+ *
+ * Each action is reported as a single line:
+ *
+ *   line=3 action=pgdn repeat=50 usec=1520 usec_per_key=30 screen=1a2b3c4d
+ */
+
+#include <ctype.h>       /* tolower() */
+#include <stdio.h>
+#include <stdlib.h>      /* atoi() */
+#include <string.h>
+#include <sys/time.h>    /* gettimeofday() */
+#include "common.h"
+#include "ui.h"
+#include "utf8.h"
+
+#define SCREEN_ROWS 30
+#define SCREEN_COLS 80
+
+#define MAXKEYS 1024
+
+unsigned int ui_rows;
+unsigned int ui_cols;
+
+struct cell {
+    unsigned char c;
+    unsigned char attr;
+};
+
+static struct cell cells[SCREEN_ROWS][SCREEN_COLS];
+
+static int keyq[MAXKEYS];       /* key presses of the current action */
+static int keyqlen, keyqpos;
+static int keyqtimed;           /* the first key press that is timed */
+
+static char action[64];         /* name of the action being replayed */
+static long actionline;         /* script line of the action being replayed */
+static long scriptline;
+static int actionrepeat;
+static int actionpending;
+static int scriptdone;
+static struct timeval actionstart;
+
+static const struct {
+    const char *name;
+    int key;
+} keynames[] = {
+    {"up", KEY_UP},
+    {"down", KEY_DOWN},
+    {"left", KEY_LEFT},
+    {"right", KEY_RIGHT},
+    {"pgup", KEY_PAGEUP},
+    {"pgdn", KEY_PAGEDOWN},
+    {"home", KEY_HOME},
+    {"end", KEY_END},
+    {"enter", KEY_ENTER},
+    {"back", KEY_BACKSPACE},
+    {"tab", KEY_TAB},
+    {"esc", KEY_ESCAPE},
+    {"del", KEY_DELETE},
+    {NULL, 0}
+};
+
+void ui_init(void)
+{
+    ui_update_screen_size();
+}
+
+void ui_update_screen_size(void)
+{
+    ui_rows = ui_getrowcount();
+    ui_cols = ui_getcolcount();
+}
+
+int ui_getrowcount(void)
+{
+    return SCREEN_ROWS;
+}
+
+int ui_getcolcount(void)
+{
+    return SCREEN_COLS;
+}
+
+void ui_cls(void)
+{
+    memset(cells, 0, sizeof cells);
+}
+
+void ui_puts(char *str)
+{
+    puts(str);
+}
+
+void ui_cputs(const char *str, int attr, int x, int y)
+{
+    for (; *str; str++, x++)
+        ui_putchar(*str, attr, x, y);
+}
+
+void ui_locate(int x, int y)
+{
+    (void)x;
+    (void)y;
+}
+
+void ui_putchar(char c, int attr, int x, int y)
+{
+    if ((x < 0) || (y < 0) || (x >= SCREEN_COLS) || (y >= SCREEN_ROWS))
+        return;
+    cells[y][x].c = c;
+    cells[y][x].attr = attr;
+}
+
+void ui_putglyph(unsigned long cp, int attr, int x, int y)
+{
+    int c = utf8_latin1(cp); /* like the SDL frontend */
+
+    ui_putchar((c >= 0) ? c : '?', attr, x, y);
+    if (utf8_width(cp) == 2)
+        ui_putchar(' ', attr, x + 1, y);
+}
+
+void ui_refresh(void)
+{
+}
+
+/* FNV-1a hash of the whole screen, characters and attributes */
+static unsigned long screen_checksum(void)
+{
+    unsigned long hash = 2166136261ul;
+    const unsigned char *p = (const unsigned char *)cells;
+    size_t i;
+
+    for (i = 0; i < sizeof cells; i++) {
+        hash ^= p[i];
+        hash = (hash * 16777619ul) & 0xFFFFFFFFul;
+    }
+    return hash;
+}
+
+static void screen_dump(void)
+{
+    int x, y;
+
+    for (y = 0; y < SCREEN_ROWS; y++) {
+        for (x = 0; x < SCREEN_COLS; x++) {
+            unsigned char c = cells[y][x].c;
+            putchar(((c >= 32) && (c < 127)) ? c : ' ');
+        }
+        putchar('\n');
+    }
+}
+
+static void pushkey(int key)
+{
+    if (keyqlen < MAXKEYS)
+        keyq[keyqlen++] = key;
+}
+
+static int lookupkey(const char *name)
+{
+    int i;
+
+    if ((name[0] == 'f') && (atoi(name + 1) >= 1) && (atoi(name + 1) <= 10))
+        return KEY_F1 + atoi(name + 1) - 1;
+
+    for (i = 0; keynames[i].name != NULL; i++)
+        if (strcmp(name, keynames[i].name) == 0)
+            return keynames[i].key;
+
+    return -1;
+}
+
+/* reads the next action from the script and fills the key queue with its
+ * key presses. returns 0 once the script is over. */
+static int loadaction(void)
+{
+    char line[512];
+
+    while (fgets(line, sizeof line, stdin) != NULL) {
+        char *cmd, *arg;
+        size_t len = strlen(line);
+        int i;
+
+        scriptline++;
+        while ((len > 0) && isspace((unsigned char)line[len - 1]))
+            line[--len] = 0;
+        for (cmd = line; isspace((unsigned char)*cmd); cmd++);
+        if ((*cmd == 0) || (*cmd == '#'))
+            continue;
+
+        for (arg = cmd; (*arg != 0) && !isspace((unsigned char)*arg); arg++)
+            *arg = tolower((unsigned char)*arg);
+        if (*arg != 0)
+            *(arg++) = 0;
+        while (isspace((unsigned char)*arg))
+            arg++;
+
+        keyqlen = keyqpos = keyqtimed = 0;
+        actionrepeat = 1;
+        actionline = scriptline;
+        strncpy(action, cmd, sizeof action - 1);
+        action[sizeof action - 1] = 0;
+
+        if (strcmp(cmd, "open") == 0) {
+            pushkey(KEY_TAB);
+            pushkey(KEY_CTRL_U); /* wipe out whatever is in the URL bar */
+            keyqtimed = keyqlen;
+            for (; *arg != 0; arg++)
+                pushkey((unsigned char)*arg);
+            pushkey(KEY_ENTER);
+        } else if (strcmp(cmd, "type") == 0) {
+            for (; *arg != 0; arg++)
+                pushkey((unsigned char)*arg);
+        } else if (strcmp(cmd, "dump") == 0) {
+            screen_dump();
+            continue;
+        } else if (strcmp(cmd, "quit") == 0) {
+            return 0;
+        } else {
+            int key = lookupkey(cmd);
+            if (key < 0) {
+                fprintf(stderr, "line %ld: unknown action '%s'\n", scriptline, cmd);
+                continue;
+            }
+            if ((*arg == 'x') && (atoi(arg + 1) > 0))
+                actionrepeat = atoi(arg + 1);
+            if (actionrepeat > MAXKEYS)
+                actionrepeat = MAXKEYS;
+            for (i = 0; i < actionrepeat; i++)
+                pushkey(key);
+        }
+
+        if (keyqlen > 0)
+            return 1;
+    }
+
+    return 0;
+}
+
+static void reportaction(void)
+{
+    struct timeval now;
+    long usec;
+
+    gettimeofday(&now, NULL);
+    usec = (now.tv_sec - actionstart.tv_sec) * 1000000l + (now.tv_usec - actionstart.tv_usec);
+    printf("line=%ld action=%s repeat=%d usec=%ld usec_per_key=%ld screen=%08lx\n",
+           actionline, action, actionrepeat, usec, usec / (keyqlen - keyqtimed), screen_checksum());
+    fflush(stdout);
+}
+
+int ui_getkey(void)
+{
+    if (keyqpos >= keyqlen) {
+        /* all keys of the action have been processed by now */
+        if (actionpending) {
+            reportaction();
+            actionpending = 0;
+        }
+
+        if (scriptdone || (loadaction() == 0)) {
+            scriptdone = 1;
+            return KEY_QUIT;
+        }
+        actionpending = 1;
+    }
+
+    if (keyqpos == keyqtimed)
+        gettimeofday(&actionstart, NULL);
+    return keyq[keyqpos++];
+}
+
+int ui_kbhit(void)
+{
+    /* the next action of the script is read only when Gopherus waits for
+     * a key, but the rest of the current one is pressed already */
+    return keyqpos < keyqlen;
+}
+
+int ui_waitkey(long usec)
+{
+    (void)usec; /* the script does not wait between its actions: that time passes at once */
+    return keyqpos < keyqlen;
+}
+
+void ui_cursor_show(void)
+{
+}
+
+void ui_cursor_hide(void)
+{
+}
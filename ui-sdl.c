@@ -7,14 +7,34 @@
  * Provides all UI functions used by Gopherus, wrapped around a virtual terminal emulated via SDL calls.
  */
 
+#include <string.h>  /* memset() */
 #include <SDL/SDL.h>
 #include "common.h"
 #include "ui.h"
+#include "utf8.h"
 #include "ascii.h" /* ascii fonts */
 
+#define SCREEN_ROWS 30
+#define SCREEN_COLS 80
+
 unsigned int ui_rows;
 unsigned int ui_cols;
 
+/* text-cell back buffer - ui_putchar() only records cells here and marks
+ * them dirty, the actual rasterization happens in ui_refresh() */
+struct cell {
+    unsigned char c;
+    unsigned char attr;
+};
+
+static struct cell cells[SCREEN_ROWS][SCREEN_COLS];
+static unsigned char dirty[SCREEN_ROWS][SCREEN_COLS];
+static int dirtyrows[SCREEN_ROWS]; /* number of dirty cells on every row */
+
+/* pre-rendered glyphs, one atlas per attribute (created on first use) */
+static SDL_Surface *atlases[256];
+static Uint32 pal[16]; /* the CGA palette, mapped to the screen's pixel format */
+
 static int cursorx, cursory;
 static SDL_Surface *screen;
 static int cursorstate = 1;
@@ -52,8 +72,17 @@ static void putpixel(SDL_Surface *surface, int x, int y, Uint32 pixel)
 
 void ui_init(void)
 {
+    static const Uint8 cgapal[16][3] = {
+        {0x00, 0x00, 0x00}, {0x00, 0x00, 0xAA}, {0x00, 0xAA, 0x00}, {0x00, 0xAA, 0xAA},
+        {0xAA, 0x00, 0x00}, {0xAA, 0x00, 0xAA}, {0xAA, 0x55, 0x00}, {0xAA, 0xAA, 0xAA},
+        {0x55, 0x55, 0x55}, {0x55, 0x55, 0xFF}, {0x55, 0xFF, 0x55}, {0x55, 0xFF, 0xFF},
+        {0xFF, 0x55, 0x55}, {0xFF, 0x55, 0xFF}, {0xFF, 0xFF, 0x55}, {0xFF, 0xFF, 0xFF}};
+    int i;
+
     SDL_Init(SDL_INIT_VIDEO);
     screen = SDL_SetVideoMode(640, 480, 32, 0);
+    for (i = 0; i < 16; i++)
+        pal[i] = SDL_MapRGB(screen->format, cgapal[i][0], cgapal[i][1], cgapal[i][2]);
     SDL_WM_SetCaption("Gopherus", NULL);
     SDL_EnableKeyRepeat(800, 80); /* enable repeating keys */
     SDL_EnableUNICODE(1);  /* using the SDL unicode support actually for getting ASCII */
@@ -70,16 +99,30 @@ void ui_update_screen_size(void)
 
 int ui_getrowcount(void)
 {
-    return 30;
+    return SCREEN_ROWS;
 }
 
 int ui_getcolcount(void)
 {
-    return 80;
+    return SCREEN_COLS;
+}
+
+static void markdirty(int x, int y)
+{
+    if ((x < 0) || (y < 0) || (x >= SCREEN_COLS) || (y >= SCREEN_ROWS))
+        return;
+    if (dirty[y][x] == 0) {
+        dirty[y][x] = 1;
+        dirtyrows[y]++;
+    }
 }
 
 void ui_cls(void)
 {
+    memset(cells, 0, sizeof cells);
+    memset(dirty, 0, sizeof dirty);
+    memset(dirtyrows, 0, sizeof dirtyrows);
+    markdirty(cursorx, cursory);
     SDL_FillRect(screen, NULL, 0);
     SDL_Flip(screen);
 }
@@ -97,40 +140,164 @@ void ui_cputs(const char *str, int attr, int x, int y)
 
 void ui_locate(int x, int y)
 {
+    if (cursorstate != 0) {
+        markdirty(cursorx, cursory);
+        markdirty(x, y);
+    }
     cursorx = x;
     cursory = y;
 }
 
 void ui_putchar(char c, int attr, int x, int y)
 {
+    struct cell *cell;
+
+    if ((x < 0) || (y < 0) || (x >= SCREEN_COLS) || (y >= SCREEN_ROWS))
+        return;
+
+    cell = &cells[y][x];
+    if ((cell->c == (unsigned char)c) && (cell->attr == (unsigned char)attr))
+        return; /* nothing changed, no need to redraw anything */
+
+    cell->c = c;
+    cell->attr = attr;
+    markdirty(x, y);
+}
+
+void ui_putglyph(unsigned long cp, int attr, int x, int y)
+{
+    int c = utf8_latin1(cp); /* the font holds the ISO 8859-1 chars */
+
+    ui_putchar((c >= 0) ? c : '?', attr, x, y);
+    if (utf8_width(cp) == 2)
+        ui_putchar(' ', attr, x + 1, y);
+}
+
+/* returns the glyph atlas for attribute attr, rendering it on first use. The
+ * atlas is a single row of all 256 glyphs in the native pixel format of the
+ * screen, so drawing a cell boils down to one blit. */
+static SDL_Surface *getatlas(int attr)
+{
+    SDL_PixelFormat *fmt = screen->format;
+    SDL_Surface *atlas = atlases[attr];
+    int c, xx, yy;
+
+    if (atlas != NULL)
+        return atlas;
+
+    atlas = SDL_CreateRGBSurface(SDL_SWSURFACE, 256 << 3, 16, fmt->BitsPerPixel,
+                                 fmt->Rmask, fmt->Gmask, fmt->Bmask, fmt->Amask);
+    if (atlas == NULL)
+        return NULL;
+
+    if (SDL_MUSTLOCK(atlas))
+        SDL_LockSurface(atlas);
+
+    for (c = 0; c < 256; c++)
+        for (yy = 0; yy < 16; yy++)
+            for (xx = 0; xx < 8; xx++)
+                putpixel(atlas, (c << 3) + 7 - xx, yy,
+                         (ascii_font[(c << 4) + yy] & (1 << xx)) ? pal[attr & 0x0F] : pal[attr >> 4]);
+
+    if (SDL_MUSTLOCK(atlas))
+        SDL_UnlockSurface(atlas);
+
+    atlases[attr] = atlas;
+    return atlas;
+}
+
+/* draws a single cell of the back buffer onto the screen surface */
+static void drawcell(int x, int y)
+{
+    SDL_Surface *atlas = getatlas(cells[y][x].attr);
+    SDL_Rect src, dst;
+
+    if (atlas == NULL)
+        return;
+
+    src.x = cells[y][x].c << 3;
+    src.y = 0;
+    src.w = 8;
+    src.h = 16;
+    dst.x = x << 3;
+    dst.y = y << 4;
+    SDL_BlitSurface(atlas, &src, screen, &dst);
+}
+
+/* draws the cursor over the cell it is on. this is really clumsy, but it works for now... */
+static void drawcursor(void)
+{
+    Uint32 fg = pal[cells[cursory][cursorx].attr & 0x0F];
     int xx, yy;
-    const long attrpal[16] = {0x000000l, 0x0000AAl, 0x00AA00l, 0x00AAAAl, 0xAA0000l, 0xAA00AAl, 0xAA5500l, 0xAAAAAAl, 0x555555l, 0x5555FFl, 0x55FF55l, 0x55FFFFl, 0xFF5555l, 0xFF55FFl, 0xFFFF55l, 0xFFFFFFl};
 
-    for (yy = 0; yy < 16; yy++) {
-        for (xx = 0; xx < 8; xx++) {
-            if ((ascii_font[((unsigned)c << 4) + yy] & (1 << xx)) != 0) {
-                putpixel(screen, (x << 3) + 7 - xx, (y << 4) + yy, attrpal[attr & 0x0F]);
-            } else {
-                putpixel(screen, (x << 3) + 7 - xx, (y << 4) + yy, attrpal[attr >> 4]);
-            }
+    if (SDL_MUSTLOCK(screen))
+        SDL_LockSurface(screen);
+
+    for (yy = 0; yy < 16; yy++)
+        for (xx = 0; xx < 8; xx++)
+            if ((ascii_font[('_' << 4) + yy] & (1 << xx)) != 0)
+                putpixel(screen, (cursorx << 3) + 7 - xx, (cursory << 4) + yy, fg);
+
+    if (SDL_MUSTLOCK(screen))
+        SDL_UnlockSurface(screen);
+}
+
+void ui_refresh(void)
+{
+    SDL_Rect rects[SCREEN_ROWS];
+    int nrects = 0;
+    int redrawcursor = 0;
+    int x, y;
+
+    for (y = 0; y < SCREEN_ROWS; y++) {
+        int first = -1, last = -1;
+
+        if (dirtyrows[y] == 0)
+            continue;
+
+        for (x = 0; x < SCREEN_COLS; x++) {
+            if (dirty[y][x] == 0)
+                continue;
+            drawcell(x, y);
+            dirty[y][x] = 0;
+            if ((x == cursorx) && (y == cursory))
+                redrawcursor = 1;
+            if (first < 0)
+                first = x;
+            last = x;
+        }
+        dirtyrows[y] = 0;
+
+        /* extend the previous rectangle if it covers the same columns on
+         * the row just above, otherwise start a new one */
+        if ((nrects > 0) &&
+            (rects[nrects - 1].x == (first << 3)) &&
+            (rects[nrects - 1].w == ((last - first + 1) << 3)) &&
+            (rects[nrects - 1].y + rects[nrects - 1].h == (y << 4))) {
+            rects[nrects - 1].h += 16;
+        } else {
+            rects[nrects].x = first << 3;
+            rects[nrects].y = y << 4;
+            rects[nrects].w = (last - first + 1) << 3;
+            rects[nrects].h = 16;
+            nrects++;
         }
     }
 
-    /* draw a cursor over if cursor is enabled and position is right.. this is really clumsy, but it works for now... */
-    if ((cursorstate != 0) && (cursorx == x) && (cursory == y))
-        for (yy = 0; yy < 16; yy++)
-            for (xx = 0; xx < 8; xx++)
-                if ((ascii_font[('_' << 4) + yy] & (1 << xx)) != 0)
-                    putpixel(screen, (x << 3) + 7 - xx, (y << 4) + yy, attrpal[attr & 0x0F]);
+    if (redrawcursor && (cursorstate != 0))
+        drawcursor();
 
-    /* tell SDL to update the character's area on screen */
-    SDL_UpdateRect(screen, (x << 3), (y << 4), 8, 16);
+    /* push all the changed areas to the screen at once */
+    if (nrects > 0)
+        SDL_UpdateRects(screen, nrects, rects);
 }
 
 int ui_getkey(void)
 {
     SDL_Event event;
 
+    ui_refresh(); /* flush pending screen changes before waiting for input */
+
     for (;;) {
         if (SDL_WaitEvent(&event) == 0)
             return 0; /* block until an event is received */
@@ -148,7 +315,7 @@ int ui_getkey(void)
                 case SDLK_F1:
                     return KEY_F1;
                 case SDLK_F2:
-                    return 0x13C;
+                    return KEY_F2;
                 case SDLK_F3:
                     return 0x13D;
                 case SDLK_F4:
@@ -222,18 +389,32 @@ int ui_kbhit(void)
 {
     int res;
 
+    ui_refresh();
     flushKeyUpEvents();  /* silently flush all possible 'KEY UP' events */
     res = SDL_PollEvent(NULL);
 
     return (res < 0) ? 0 : res;
 }
 
+int ui_waitkey(long usec)
+{
+    while (!ui_kbhit() && (usec > 0)) {
+        SDL_Delay(10);
+        usec -= 10000;
+    }
+    return ui_kbhit();
+}
+
 void ui_cursor_show(void)
 {
+    if (cursorstate == 0)
+        markdirty(cursorx, cursory);
     cursorstate = 1;
 }
 
 void ui_cursor_hide(void)
 {
+    if (cursorstate != 0)
+        markdirty(cursorx, cursory);
     cursorstate = 0;
 }
@@ -0,0 +1,632 @@
+/*
+ * This file is part of the gopherus project.
+ * It provides abstract functions to draw on screen.
+ *
+ * Provides all UI functions used by Gopherus, drawn on an ANSI (VT100
+ * compatible) terminal. A shadow copy of what the terminal currently shows
+ * is kept, so that ui_refresh() only sends what differs between the
+ * previous and the next frame, and uses scrolling regions whenever a block
+ * of lines merely moved up or down. Cells hold unicode chars, which are
+ * sent in UTF-8 if the locale says the terminal expects it. When the
+ * terminal gets resized, the next key read applies the new size and comes
+ * back as an unknown key, so that the views draw themselves again.
+ */
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>      /* atexit() */
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/ioctl.h>   /* TIOCGWINSZ */
+#include <sys/select.h>
+#include "common.h"
+#include "ui.h"
+#include "utf8.h"
+
+#define MAXROWS 128
+#define MAXCOLS 127 /* status bar and menu line buffers are 128 bytes long */
+
+#define ESCDELAY_USEC 50000 /* how long to wait for the rest of an escape sequence */
+
+#define WIDECELL 0x110000u /* the right half of a double-width char, past any unicode char */
+
+unsigned int ui_rows;
+unsigned int ui_cols;
+
+struct cell {
+    unsigned int c;     /* 0 in the shadow screen means 'unknown' */
+    unsigned int attr;
+};
+
+static struct cell back[MAXROWS][MAXCOLS];   /* what the next frame should be */
+static struct cell front[MAXROWS][MAXCOLS];  /* what the terminal shows now */
+
+static int cursorx, cursory;
+static int cursorstate = 1;
+static int termcursorstate = -1; /* cursor visibility set on the terminal */
+static int termx = -1, termy = -1;  /* position of the terminal's cursor */
+static int termattr = -1;           /* attribute set on the terminal */
+static int termutf8;                /* the terminal expects UTF-8 */
+
+static struct termios origtio;
+static int termactive;
+
+static unsigned char inbuf[64];
+static int inlen, inpos, ineof;
+
+/* SIGWINCH is blocked, but while waiting for input, so that a resize never
+ * goes unnoticed between checking for it and starting to wait */
+static volatile sig_atomic_t resized;
+static sigset_t waitmask;
+
+static char outbuf[8192];
+static size_t outlen;
+
+static void outflush(void)
+{
+    size_t done = 0;
+
+    while (done < outlen) {
+        ssize_t res = write(STDOUT_FILENO, outbuf + done, outlen - done);
+        if (res <= 0)
+            break;
+        done += res;
+    }
+    outlen = 0;
+}
+
+static void outstr(const char *str)
+{
+    size_t len = strlen(str);
+
+    if (outlen + len > sizeof outbuf)
+        outflush();
+    memcpy(outbuf + outlen, str, len);
+    outlen += len;
+}
+
+static void outchar(char c)
+{
+    if (outlen == sizeof outbuf)
+        outflush();
+    outbuf[outlen++] = c;
+}
+
+static void term_restore(void)
+{
+    if (termactive == 0)
+        return;
+    outstr("\033[0m\033[?25h\033[?7h\033[?1049l");
+    outflush();
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, &origtio);
+    termactive = 0;
+}
+
+/* returns non-zero if the locale (the first of LC_ALL, LC_CTYPE and LANG
+ * that is set) uses UTF-8 */
+static int locale_is_utf8(void)
+{
+    static const char *vars[] = {"LC_ALL", "LC_CTYPE", "LANG", NULL};
+    int i;
+
+    for (i = 0; vars[i] != NULL; i++) {
+        const char *val = getenv(vars[i]);
+        if ((val != NULL) && (val[0] != 0))
+            return (strstr(val, "UTF-8") != NULL) || (strstr(val, "utf-8") != NULL) ||
+                   (strstr(val, "UTF8") != NULL) || (strstr(val, "utf8") != NULL);
+    }
+    return 0;
+}
+
+static void onresize(int sig)
+{
+    (void)sig;
+    resized = 1;
+}
+
+void ui_init(void)
+{
+    struct termios tio;
+    struct sigaction sa;
+    sigset_t winch;
+
+    if (tcgetattr(STDIN_FILENO, &origtio) == 0) {
+        tio = origtio;
+        tio.c_iflag &= ~(IXON | ICRNL | INLCR | ISTRIP);
+        tio.c_lflag &= ~(ICANON | ECHO | ISIG | IEXTEN);
+        tio.c_cc[VMIN] = 1;
+        tio.c_cc[VTIME] = 0;
+        tcsetattr(STDIN_FILENO, TCSAFLUSH, &tio);
+    }
+    termactive = 1;
+    termutf8 = locale_is_utf8();
+    atexit(term_restore); /* clean up at exit time */
+
+    sa.sa_handler = onresize;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0; /* waiting for input gets interrupted */
+    sigaction(SIGWINCH, &sa, NULL);
+    sigemptyset(&winch);
+    sigaddset(&winch, SIGWINCH);
+    sigprocmask(SIG_BLOCK, &winch, &waitmask);
+    sigdelset(&waitmask, SIGWINCH);
+
+    /* switch to the alternate screen and disable autowrap, so that writing
+     * the bottom right cell doesn't scroll the whole screen */
+    outstr("\033[?1049h\033[?7l");
+
+    ui_update_screen_size();
+}
+
+void ui_update_screen_size(void)
+{
+    ui_rows = ui_getrowcount();
+    ui_cols = ui_getcolcount();
+    memset(front, 0, sizeof front); /* the terminal content is unknown */
+}
+
+int ui_getrowcount(void)
+{
+    struct winsize ws;
+
+    if ((ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) != 0) || (ws.ws_row < 3))
+        return 25;
+    return (ws.ws_row > MAXROWS) ? MAXROWS : ws.ws_row;
+}
+
+int ui_getcolcount(void)
+{
+    struct winsize ws;
+
+    if ((ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) != 0) || (ws.ws_col < 20))
+        return 80;
+    return (ws.ws_col > MAXCOLS) ? MAXCOLS : ws.ws_col;
+}
+
+void ui_cls(void)
+{
+    unsigned int x, y;
+
+    for (y = 0; y < ui_rows; y++) {
+        for (x = 0; x < ui_cols; x++) {
+            back[y][x].c = ' ';
+            back[y][x].attr = 0x07;
+        }
+    }
+    memset(front, 0, sizeof front);
+    outstr("\033[0m\033[2J");
+    termattr = -1;
+    termx = termy = -1;
+}
+
+void ui_puts(char *str)
+{
+    term_restore(); /* messages are meant to stay on the regular screen */
+    puts(str);
+}
+
+void ui_cputs(const char *str, int attr, int x, int y)
+{
+    for (; *str; str++, x++)
+        ui_putchar(*str, attr, x, y);
+}
+
+void ui_locate(int x, int y)
+{
+    cursorx = x;
+    cursory = y;
+}
+
+/* sets a cell of the next frame. A double-width char that has one of its
+ * halves overwritten is replaced by a space. */
+static void setcell(int x, int y, unsigned int c, int attr)
+{
+    if ((back[y][x].c == WIDECELL) && (x > 0))
+        back[y][x - 1].c = ' ';
+    if ((x + 1 < (int)ui_cols) && (back[y][x + 1].c == WIDECELL))
+        back[y][x + 1].c = ' ';
+    back[y][x].c = c;
+    back[y][x].attr = attr;
+}
+
+void ui_putchar(char c, int attr, int x, int y)
+{
+    unsigned char b = c;
+
+    if ((x < 0) || (y < 0) || (x >= (int)ui_cols) || (y >= (int)ui_rows))
+        return;
+    if (b == 0)
+        b = ' '; /* NUL is reserved for unknown cells of the shadow screen */
+    setcell(x, y, (b < 0x80) ? b : UTF8_RAWBYTE(b), attr);
+}
+
+void ui_putglyph(unsigned long cp, int attr, int x, int y)
+{
+    int w = utf8_width(cp);
+
+    if ((x < 0) || (y < 0) || (x >= (int)ui_cols) || (y >= (int)ui_rows))
+        return;
+    if (cp == 0)
+        cp = ' ';
+
+    if ((w == 0) || ((w == 2) && ((termutf8 == 0) || (x + 1 >= (int)ui_cols)))) {
+        setcell(x, y, '?', attr); /* no way to show it in the cells it should take */
+        if ((w == 2) && (x + 1 < (int)ui_cols))
+            setcell(x + 1, y, ' ', attr);
+        return;
+    }
+
+    setcell(x, y, cp, attr);
+    if (w == 2) {
+        if ((x + 2 < (int)ui_cols) && (back[y][x + 2].c == WIDECELL))
+            back[y][x + 2].c = ' ';
+        back[y][x + 1].c = WIDECELL;
+        back[y][x + 1].attr = attr;
+    }
+}
+
+static void setattr(int attr)
+{
+    /* CGA and ANSI order colors differently */
+    static const int cga2ansi[8] = {0, 4, 2, 6, 1, 5, 3, 7};
+    char seq[32];
+    int fg = attr & 0x0F;
+    int bg = (attr >> 4) & 0x0F;
+
+    if (attr == termattr)
+        return;
+    sprintf(seq, "\033[0;%d;%dm",
+            (fg & 8) ? 90 + cga2ansi[fg & 7] : 30 + cga2ansi[fg],
+            (bg & 8) ? 100 + cga2ansi[bg & 7] : 40 + cga2ansi[bg]);
+    outstr(seq);
+    termattr = attr;
+}
+
+static void moveto(int x, int y)
+{
+    char seq[32];
+
+    if ((x == termx) && (y == termy))
+        return;
+    sprintf(seq, "\033[%d;%dH", y + 1, x + 1);
+    outstr(seq);
+    termx = x;
+    termy = y;
+}
+
+/* sends the char of a cell */
+static void outglyph(unsigned int c)
+{
+    if ((c >= 32) && (c < 127)) {
+        outchar(c);
+    } else if (termutf8 && (c >= 0xA0) && (c < WIDECELL) && !UTF8_ISRAWBYTE(c)) {
+        char seq[4];
+        int i, n = utf8_encode(seq, c);
+        for (i = 0; i < n; i++)
+            outchar(seq[i]);
+    } else {
+        outchar('?');
+    }
+}
+
+static int rowequal(const struct cell *a, const struct cell *b)
+{
+    return memcmp(a, b, ui_cols * sizeof(struct cell)) == 0;
+}
+
+/* checks whether the lines that changed since the last frame are in fact
+ * lines of the previous frame moved up or down, and if so, scrolls them on
+ * the terminal so that only the lines that appeared have to be sent */
+static void scrollregion(void)
+{
+    int top, bottom, shift, y;
+    int bestshift = 0, bestcost;
+
+    for (top = 0; top < (int)ui_rows; top++)
+        if (!rowequal(back[top], front[top]))
+            break;
+    for (bottom = (int)ui_rows - 1; bottom > top; bottom--)
+        if (!rowequal(back[bottom], front[bottom]))
+            break;
+    if (bottom - top < 2)
+        return;
+
+    bestcost = 0; /* number of lines to send if not scrolling at all */
+    for (y = top; y <= bottom; y++)
+        if (!rowequal(back[y], front[y]))
+            bestcost++;
+    bestcost -= 1; /* scrolling costs a few bytes, it must save at least a line */
+
+    /* positive shift = content moves up, negative = content moves down */
+    for (shift = -(bottom - top - 1); shift <= bottom - top - 1; shift++) {
+        int cost = (shift < 0) ? -shift : shift; /* lines that appear */
+        if ((shift == 0) || (cost >= bestcost))
+            continue;
+        for (y = top; (y <= bottom) && (cost < bestcost); y++) {
+            int from = y + shift;
+            if ((from < top) || (from > bottom))
+                continue;
+            if (!rowequal(back[y], front[from]))
+                cost++;
+        }
+        if (cost < bestcost) {
+            bestcost = cost;
+            bestshift = shift;
+        }
+    }
+
+    if (bestshift == 0)
+        return;
+
+    {
+        char seq[32];
+        int i;
+        sprintf(seq, "\033[%d;%dr", top + 1, bottom + 1);
+        outstr(seq);
+        if (bestshift > 0) { /* LF at the bottom margin scrolls the region up */
+            sprintf(seq, "\033[%d;1H", bottom + 1);
+            outstr(seq);
+            for (i = 0; i < bestshift; i++)
+                outchar('\n');
+            memmove(front[top], front[top + bestshift], (bottom - top + 1 - bestshift) * sizeof front[0]);
+            memset(front[bottom + 1 - bestshift], 0, bestshift * sizeof front[0]);
+        } else { /* reverse index at the top margin scrolls the region down */
+            sprintf(seq, "\033[%d;1H", top + 1);
+            outstr(seq);
+            for (i = 0; i < -bestshift; i++)
+                outstr("\033M");
+            memmove(front[top - bestshift], front[top], (bottom - top + 1 + bestshift) * sizeof front[0]);
+            memset(front[top], 0, -bestshift * sizeof front[0]);
+        }
+        outstr("\033[r"); /* reset the scrolling region, this homes the cursor */
+        termx = termy = 0;
+    }
+}
+
+void ui_refresh(void)
+{
+    int x, y;
+
+    if (termactive == 0)
+        return;
+
+    scrollregion();
+
+    for (y = 0; y < (int)ui_rows; y++) {
+        for (x = 0; x < (int)ui_cols; x++) {
+            /* the right half of a double-width char goes with its left half */
+            int wide = (x + 1 < (int)ui_cols) && (back[y][x + 1].c == WIDECELL);
+
+            if (back[y][x].c == WIDECELL)
+                continue;
+            if ((back[y][x].c == front[y][x].c) && (back[y][x].attr == front[y][x].attr) &&
+                (!wide || ((back[y][x + 1].c == front[y][x + 1].c) && (back[y][x + 1].attr == front[y][x + 1].attr))))
+                continue;
+
+            /* a short run of unchanged cells is cheaper to rewrite than to jump over */
+            if ((termy == y) && (termx < x) && (x - termx <= 4)) {
+                int i;
+                for (i = termx; i < x; i++)
+                    if ((front[y][i].attr != (unsigned int)termattr) || (front[y][i].c < 32) || (front[y][i].c >= 127))
+                        break;
+                if (i == x) {
+                    for (i = termx; i < x; i++)
+                        outchar(front[y][i].c);
+                    termx = x;
+                }
+            }
+
+            moveto(x, y);
+            setattr(back[y][x].attr);
+            outglyph(back[y][x].c);
+            front[y][x] = back[y][x];
+            termx++;
+            if (wide) {
+                front[y][x + 1] = back[y][x + 1];
+                termx++;
+            }
+            if (termx >= (int)ui_cols)
+                termx = -1; /* autowrap is disabled, the cursor stays on the last column */
+        }
+    }
+
+    if (cursorstate != 0)
+        moveto(cursorx, cursory);
+    if (cursorstate != termcursorstate) {
+        outstr((cursorstate != 0) ? "\033[?25h" : "\033[?25l");
+        termcursorstate = cursorstate;
+    }
+
+    outflush();
+}
+
+/* waits up to usec microseconds (forever if negative) for the terminal to
+ * send something. Returns non-zero if it did, 0 if the time is over or if the
+ * terminal got resized. */
+static int waitinput(long usec)
+{
+    fd_set rfds;
+    struct timespec ts;
+
+    FD_ZERO(&rfds);
+    FD_SET(STDIN_FILENO, &rfds);
+    ts.tv_sec = usec / 1000000l;
+    ts.tv_nsec = (usec % 1000000l) * 1000l;
+    return pselect(STDIN_FILENO + 1, &rfds, NULL, NULL, (usec < 0) ? NULL : &ts, &waitmask) > 0;
+}
+
+/* returns the next byte from the terminal, or -1 if nothing came within
+ * usec microseconds (a negative usec waits forever), or if the terminal got
+ * resized meanwhile */
+static int readbyte(long usec)
+{
+    if (inpos >= inlen) {
+        ssize_t res;
+
+        if (ineof)
+            return -1;
+
+        if (waitinput(usec) == 0)
+            return -1;
+
+        res = read(STDIN_FILENO, inbuf, sizeof inbuf);
+        if ((res < 0) && (errno == EINTR))
+            return -1;
+        if (res <= 0) {
+            ineof = 1;
+            return -1;
+        }
+        inlen = res;
+        inpos = 0;
+    }
+
+    return inbuf[inpos++];
+}
+
+/* decodes the rest of an escape sequence, once ESC has been read */
+static int readescape(void)
+{
+    int c = readbyte(ESCDELAY_USEC);
+    int param = 0;
+
+    if (c < 0)
+        return KEY_ESCAPE; /* a lone ESC */
+
+    if ((c != '[') && (c != 'O')) /* ESC followed by a key means ALT+key */
+        return ((c > 0x1F) && (c < 127)) ? (0x100 | c) : 0;
+
+    for (;;) {
+        int next = readbyte(ESCDELAY_USEC);
+        if (next < 0)
+            return 0;
+        if ((next >= '0') && (next <= '9')) {
+            param = param * 10 + (next - '0');
+        } else if (next == ';') {
+            param = 0; /* modifiers are ignored, only the key code matters */
+        } else if ((next == '[') && (c == '[')) { /* linux console F1..F5 are ESC [ [ A..E */
+            next = readbyte(ESCDELAY_USEC);
+            return ((next >= 'A') && (next <= 'E')) ? KEY_F1 + (next - 'A') : 0;
+        } else {
+            c = next;
+            break;
+        }
+    }
+
+    switch (c) {
+        case 'A':
+            return KEY_UP;
+        case 'B':
+            return KEY_DOWN;
+        case 'C':
+            return KEY_RIGHT;
+        case 'D':
+            return KEY_LEFT;
+        case 'H':
+            return KEY_HOME;
+        case 'F':
+            return KEY_END;
+        case 'P':
+        case 'Q':
+        case 'R':
+        case 'S':
+            return KEY_F1 + (c - 'P');
+        case '~':
+            switch (param) {
+                case 1:
+                case 7:
+                    return KEY_HOME;
+                case 3:
+                    return KEY_DELETE;
+                case 4:
+                case 8:
+                    return KEY_END;
+                case 5:
+                    return KEY_PAGEUP;
+                case 6:
+                    return KEY_PAGEDOWN;
+                case 11:
+                case 12:
+                case 13:
+                case 14:
+                case 15:
+                    return KEY_F1 + (param - 11);
+                case 17:
+                case 18:
+                case 19:
+                case 20:
+                case 21:
+                    return KEY_F5 + 1 + (param - 17);
+            }
+    }
+
+    return 0x00; /* unknown key */
+}
+
+int ui_getkey(void)
+{
+    int c;
+
+    ui_refresh(); /* flush pending screen changes before waiting for input */
+
+    for (;;) {
+        if (resized) { /* the views find out from ui_rows and ui_cols */
+            resized = 0;
+            ui_update_screen_size();
+            ui_cls();
+            return 0x00;
+        }
+        c = readbyte(-1);
+        if ((c >= 0) || ineof)
+            break;
+    }
+
+    switch (c) {
+        case -1:   /* the terminal is gone */
+        case 0x03: /* CTRL+C */
+            return KEY_QUIT;
+        case 0x1B:
+            return readescape();
+        case 0x7F:
+        case 0x08:
+            return KEY_BACKSPACE;
+        case '\r':
+        case '\n':
+            return KEY_ENTER;
+        default:
+            return (c < 127) ? c : 0x00;
+    }
+}
+
+int ui_kbhit(void)
+{
+    ui_refresh();
+
+    if (resized || (inpos < inlen))
+        return 1;
+    if (ineof)
+        return 0;
+
+    return waitinput(0);
+}
+
+int ui_waitkey(long usec)
+{
+    if (ui_kbhit())
+        return 1;
+    if (ineof)
+        return 0;
+
+    return waitinput(usec) || resized;
+}
+
+void ui_cursor_show(void)
+{
+    cursorstate = 1;
+}
+
+void ui_cursor_hide(void)
+{
+    cursorstate = 0;
+}
@@ -8,8 +8,10 @@
  */
 
 #include <conio.h>
+#include <dos.h>   /* delay() */
 #include <pc.h>    /* ScreenRows() */
 #include "ui.h"
+#include "utf8.h"
 
 unsigned int ui_rows;
 unsigned int ui_cols;
@@ -60,6 +62,20 @@ void ui_putchar(char c, int attr, int x, int y)
     ScreenPutChar(c, attr, x, y);
 }
 
+void ui_putglyph(unsigned long cp, int attr, int x, int y)
+{
+    int c = utf8_cp437(cp); /* the glyphs of the VGA text mode */
+
+    ScreenPutChar((c >= 0) ? c : '?', attr, x, y);
+    if (utf8_width(cp) == 2)
+        ScreenPutChar(' ', attr, x + 1, y);
+}
+
+void ui_refresh(void)
+{
+    /* conio writes straight into the video memory, nothing to flush */
+}
+
 int ui_getkey(void)
 {
     return getkey();
@@ -70,6 +86,15 @@ int ui_kbhit(void)
     return kbhit();
 }
 
+int ui_waitkey(long usec)
+{
+    while (!kbhit() && (usec > 0)) {
+        delay(10);
+        usec -= 10000;
+    }
+    return kbhit();
+}
+
 void ui_cursor_show(void)
 {
     _setcursortype(_NORMALCURSOR);
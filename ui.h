@@ -35,12 +35,24 @@ void ui_locate(int x, int y);
 /* Put a char directly on screen, without playing with the cursor. Coordinates are zero-based. */
 void ui_putchar(char c, int attr, int x, int y);
 
+/* puts the unicode char cp on screen, like ui_putchar(). A double-width
+ * char covers the cell at x + 1 as well. Chars the display has no glyph for
+ * are shown as a question mark. */
+void ui_putglyph(unsigned long cp, int attr, int x, int y);
+
+/* pushes all pending screen changes to the display. ui_getkey() and ui_kbhit() do it implicitly. */
+void ui_refresh(void);
+
 /* waits for a key to be pressed and returns it. ALT+keys have 0x100 added to them. */
 int ui_getkey(void);
 
 /* returns 0 if no key is awaiting in the keyboard buffer, non-zero otherwise */
 int ui_kbhit(void);
 
+/* waits up to usec microseconds for a key to be pressed. Returns non-zero if one is awaiting in the keyboard buffer,
+   0 otherwise. The key is not read. */
+int ui_waitkey(long usec);
+
 /* makes the cursor visible */
 void ui_cursor_show(void);
 
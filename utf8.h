@@ -0,0 +1,35 @@
+/*
+ * This file is part of the Gopherus project.
+ */
+
+#ifndef UTF8_H
+#define UTF8_H
+
+/* bytes that are no part of a valid UTF-8 sequence are decoded one by one
+ * to U+DC80..U+DCFF (lone surrogates, never valid chars), so that displays
+ * can still show them the way they showed raw bytes before */
+#define UTF8_RAWBYTE(b) (0xDC00ul + (unsigned char)(b))
+#define UTF8_ISRAWBYTE(cp) (((cp) >= 0xDC80ul) && ((cp) <= 0xDCFFul))
+
+/* returns non-zero if the len bytes at str are all ASCII */
+int utf8_isascii(const char *str, long len);
+
+/* decodes the char at *str and moves *str past it. str must be
+ * NUL-terminated, or at least not end in the middle of a sequence. */
+unsigned long utf8_decode(const char **str);
+
+/* writes the UTF-8 form of cp into dst (4 bytes at most), and returns its
+ * length */
+int utf8_encode(char *dst, unsigned long cp);
+
+/* returns the number of screen columns cp takes: 0 for combining chars, 2
+ * for wide (East Asian) chars and 1 for all others */
+int utf8_width(unsigned long cp);
+
+/* returns the ISO 8859-1 code of cp, or -1 if it has none */
+int utf8_latin1(unsigned long cp);
+
+/* returns the code page 437 code of cp, or -1 if it has none */
+int utf8_cp437(unsigned long cp);
+
+#endif
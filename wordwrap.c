@@ -1,39 +1,100 @@
 /*
  * This file is part of the Gopherus project.
  * Copyright (C) Mateusz Viste 2013
+ *
+ * Where SSE2 is available, 16 bytes are checked at once for anything else
+ * than printable ASCII and tabs, and blocks made only of them are taken
+ * whole, the last space or tab they hold being the place to wrap at.
  */
 
-#include <stdlib.h>    /* NULL */
+#include "utf8.h"
 #include "wordwrap.h"
 
-char *wordwrap(char *dst, const char *src, int width)
+#if defined(__SSE2__) && defined(__GNUC__)
+#define WORDWRAP_SSE2
+#include <emmintrin.h>
+#endif
+
+long wordwrap_span(const char *src, long avail, int width, int *linelen)
 {
-    int i, lastspace = 0;
-
-    for (i = 0; i < width; i++) {
-        dst[i] = src[i];
-        if (src[i] == '\0')
-            return NULL;
-        if (dst[i] == '\t')
-            dst[i] = ' '; /* replace all TABs with spaces */
-        if (dst[i] == ' ')
+    int i = 0, col = 0, lastspace = 0;
+
+#ifndef WORDWRAP_SSE2
+    (void)avail; /* only the vectorized scan reads ahead */
+#endif
+
+    while (col < width) {
+        unsigned char c;
+
+#ifdef WORDWRAP_SSE2
+        {
+            const __m128i space = _mm_set1_epi8(' ');
+            const __m128i tab = _mm_set1_epi8('\t');
+
+            while ((col + 16 <= width) && (i + 16 <= avail)) {
+                __m128i b = _mm_loadu_si128((const __m128i *)(src + i));
+                __m128i blank = _mm_or_si128(_mm_cmpeq_epi8(b, space), _mm_cmpeq_epi8(b, tab));
+                /* control chars are below a space, and bytes >= 0x80 are negative */
+                int special = _mm_movemask_epi8(_mm_andnot_si128(blank, _mm_cmplt_epi8(b, space)));
+                int spaces = _mm_movemask_epi8(blank);
+                int n = (special != 0) ? __builtin_ctz(special) : 16;
+
+                spaces &= (1 << n) - 1;
+                if (spaces != 0)
+                    lastspace = i + 31 - __builtin_clz(spaces);
+                i += n;
+                col += n;
+                if (n < 16)
+                    break; /* the special char is processed below */
+            }
+            if (col >= width)
+                break;
+        }
+#endif
+
+        c = src[i];
+
+        if ((c >= ' ') && (c < 0x80)) { /* the bulk of any text */
+            if (c == ' ')
+                lastspace = i;
+            i++;
+            col++;
+            continue;
+        }
+
+        if (c >= 0x80) { /* a multibyte char is taken whole, if it fits */
+            const char *next = src + i;
+            int w = utf8_width(utf8_decode(&next));
+            int n = next - (src + i);
+            /* leave a byte for each column left, and always take the first char */
+            if ((i > 0) && ((col + w > width) || (i + n + (width - col - w) > width * 4)))
+                break;
+            i += n;
+            col += w;
+            continue;
+        }
+
+        if (c == '\0') {
+            *linelen = i;
+            return -1;
+        }
+        if (c == '\t') /* TABs are shown as spaces */
             lastspace = i;
-        if (src[i] == '\n') {
-            /* if it's part of a CR/LF couple, delete them both */
-            if ((i > 0) && (src[i - 1] == '\r'))
-                dst[i - 1] = '\0';
-            dst[i] = '\0';
-            return (char *)src + i + 1;
+        if (c == '\n') {
+            /* if it's part of a CR/LF couple, leave them both out */
+            *linelen = ((i > 0) && (src[i - 1] == '\r')) ? i - 1 : i;
+            return i + 1;
         }
+        i++;
+        col++;
     }
 
-    if (lastspace == 0 || src[width] == ' ')
-        lastspace = width;
+    if (lastspace == 0 || src[i] == ' ')
+        lastspace = i;
 
-    dst[lastspace] = '\0';
-    src += lastspace;
-    while (*src == ' ')
-        src++;
+    *linelen = lastspace;
+    while (src[lastspace] == ' ')
+        lastspace++;
 
-    return (*src == '\0') ? NULL : (char *)src;
+    return (src[lastspace] == '\0') ? -1 : lastspace;
 }
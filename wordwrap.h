@@ -6,9 +6,18 @@
 #ifndef WORDWRAP_H
 #define WORDWRAP_H
 
-/* Fills *dst with part or totality of original *src and return a pointer
- * where to start next iteration. dst shall point to a buffer of size of
- * at least width + 1 chars. */
-char *wordwrap(char *dst, const char *src, int width);
+/* most bytes a line of width columns is made of, plus a NUL terminator: a
+ * column takes up to 4 bytes of UTF-8, and a line starting with a char
+ * wider than width gets it anyway */
+#define WORDWRAP_BUFSIZE(width) ((width) * 4 + 4)
+
+/* finds the line starting at src once wrapped, that is at most width
+ * columns on screen. src is NUL-terminated UTF-8 text, of which the first
+ * avail bytes may be read at once to speed up the scan (0 if unknown).
+ * Sets *linelen to the length of the line in bytes, which excludes the
+ * line terminator and the spaces it was wrapped at, and returns the offset
+ * where the next line starts, or -1 if it is the last one. Nothing is
+ * copied: tabs are part of the line, and to be shown as spaces. */
+long wordwrap_span(const char *src, long avail, int width, int *linelen);
 
 #endif
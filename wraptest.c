@@ -9,14 +9,16 @@
 int main(int argc, char **argv)
 {
     char *strptr;
-    char res[128];
+    int len;
+    long next;
     if (argc != 2) {
         puts("Usage: wraptest teststring");
         return 0;
     }
-    for (strptr = wordwrap(res, argv[1], 16); ; strptr = wordwrap(res, strptr, 16)) {
-        printf("|%s|\r\n", res);
-        if (strptr == NULL) break;
+    for (strptr = argv[1]; ; strptr += next) {
+        next = wordwrap_span(strptr, 0, 16, &len);
+        printf("|%.*s|\r\n", len, strptr);
+        if (next < 0) break;
     }
     return 0;
 }